@@ -30,6 +30,17 @@
 
 #include "output.h"
 #include "utility.h"
+#include "thread_pool.h"
+#include "aggregate_supports_index.h"
+
+/* Argument of aggregate_candidate_body(). trieNum and indexNum count the
+ candidates aggregated by each engine. */
+struct AggregateJob {
+  struct Cluster **ppCandidates;
+  struct Parameters *pParam;
+  unsigned long trieNum;
+  unsigned long indexNum;
+};
 
 static struct TrieNode *build_prefix_trie(struct Parameters *pParam);
 static void insert_cluster_into_trie(struct TrieNode *pRoot, struct Cluster 
@@ -38,30 +49,55 @@ static int insert_cluster_into_trie_wildcard(struct TrieNode *pParent, int min,
                     int max, struct Parameters *pParam);
 static int insert_cluster_into_trie_word(struct TrieNode *pParent, 
         struct Elem *pWord, struct Parameters *pParam);
+static struct TrieNode *alloc_trie_node(struct Parameters *pParam);
+static void free_trie_node_pool(struct Parameters *pParam);
 static struct TrieNode *create_trie_node(struct Elem *pElem, 
         struct TrieNode *pParent, struct TrieNode *pPrev, 
         struct Parameters *pParam);
+static void freeze_prefix_trie(struct TrieNode *pRoot, 
+        struct Parameters *pParam);
 static void aggregate_candidates(struct Parameters *pParam);
+static void aggregate_candidate_body(unsigned long index, int worker, 
+        void *pArg);
+static void add_word_supports(struct Cluster *pCluster, 
+        support_t *pWordSupport, struct Cluster **ppLast);
+static int can_reach_support(struct Cluster *pCluster, support_t *pWordSupport,
+        struct Parameters *pParam);
 static int get_first_wildcard_location(struct Cluster *pCluster);
 static void aggregate_candidate(struct Cluster *pCluster, 
         struct Parameters *pParam);
-static struct TrieNode *get_common_parent(struct Cluster *pCluster);
+static trieindex_t get_common_parent(struct Cluster *pCluster,
+        struct Parameters *pParam);
 static int get_first_wildcard_reverse_depth(struct Cluster *pCluster);
-static int find_more_specific(struct TrieNode *pParent, 
-        struct Cluster *pCluster, int constant, int min, int max, 
-        wordnumber_t hash, struct Parameters *pParam);
-static int find_more_specific_tail(struct TrieNode *pParent, 
-        struct Cluster*pCluster, int min, int max);
+static void find_more_specific(trieindex_t parent, struct Cluster *pCluster,
+        int constant, int min, int max, unsigned long long *pSuffixBloom,
+        struct Parameters *pParam);
+static void find_more_specific_tail(trieindex_t parent, 
+        struct Cluster *pCluster, int min, int max, struct Parameters *pParam);
 
 void step_2_aggregate_supports(struct Parameters *pParam)
 {
   struct TrieNode *pRoot;
   
   log_msg("Aggregate cluster candidates...", LOG_NOTICE, pParam);
-  pParam->prefixSketchSize = pParam->freWordNum * 3;
-  pParam->wildcardHash = pParam->freWordNum * 3;
+  /* Word nodes are keyed by frequent word number (1...freWordNum). Wildcard
+   nodes and root have their own keys, which are bigger than any word 
+   number. */
+  pParam->wildcardKey = pParam->freWordNum + 1;
+  
+  if (pParam->aggrEngine != AGGR_ENGINE_INDEX)
+  {
+    pRoot = build_prefix_trie(pParam);
+    
+    /* The linked nodes are only used for building. The prefix tree is copied
+     into a contiguous array, and the linked nodes are released. */
+    freeze_prefix_trie(pRoot, pParam);
+  }
   
-  pRoot = build_prefix_trie(pParam);
+  if (pParam->aggrEngine != AGGR_ENGINE_TRIE)
+  {
+    build_candidate_index(pParam);
+  }
   
   aggregate_candidates(pParam);
   
@@ -71,22 +107,6 @@ void step_2_aggregate_supports(struct Parameters *pParam)
   //str_format_int_grouped(digit, clusterNum);
   //sprintf(logStr, "%s cluster were found.", digit);
   //log_msg(logStr, LOG_INFO, &param);
-  
-  //2016-04-12 commented out free_trie_nodes(pRoot, pParam);
-  //This function faces "segmentation 11" error when handling 
-  //large trie nodes. 
-  //(Or this is because the characteristic of specific event log
-  //files that generate some weird cluster candidates, therefore
-  //generating some weird trie nodes that are hard to free.)
-  //Commenting out this function is not a problem.
-  //System will take this issue and helps in freeing heap memory, 
-  //when the process is terminated.
-  //(Memory leaking is a affordable problem, as this program is not a long-time
-  //background program that keeps consuming memory. Nevertheless, other heap
-  //memory that won't cause errors when being released shall always be 
-  //released.)
-  
-  //free_trie_nodes(pRoot, pParam);
 }
 
 /* This function iterates all cluster candiates and build the prefix tree. */
@@ -95,16 +115,11 @@ static struct TrieNode *build_prefix_trie(struct Parameters *pParam)
   int i = 0;
   struct Cluster *ptr;
   
-  struct TrieNode *pRoot = (struct TrieNode *) malloc(sizeof(struct TrieNode));
-  if (!pRoot)
-  {
-    log_msg(MALLOC_ERR_6003, LOG_ERR, pParam);
-    exit(1);
-  }
+  struct TrieNode *pRoot = alloc_trie_node(pParam);
   
   pParam->trieNodeNum = 1;
   /* Root has unique id. */
-  pRoot->hashValue = pParam->wildcardHash + 1;
+  pRoot->key = pParam->wildcardKey + 1;
   
   pRoot->pParent = 0;
   pRoot->pChild = 0;
@@ -125,11 +140,6 @@ static struct TrieNode *build_prefix_trie(struct Parameters *pParam)
     }
   }
   
-  pParam->pPrefixRoot = pRoot;
-  
-  //Returning a local variable shall cause warning. Anyway, it has been stored 
-  //in pParam->pPrefixRoot. 
-  //PS: pRoot is not a local variable. It is in heap. 
   return pRoot;
 }
 
@@ -215,7 +225,6 @@ static void insert_cluster_into_trie(struct TrieNode *pRoot, struct Cluster
   }
   
   ptr->pIsEnd = pCluster;
-  pCluster->pLastNode = ptr;
 }
 
 /* Insert wildcard into trie. */
@@ -227,7 +236,7 @@ static int insert_cluster_into_trie_wildcard(struct TrieNode *pParent, int min,
   
   while (ptr)
   {
-    if (ptr->hashValue == pParam->wildcardHash)
+    if (ptr->key == pParam->wildcardKey)
     {
       if (ptr->wildcardMin == min && ptr->wildcardMax == max)
       {
@@ -251,55 +260,69 @@ static int insert_cluster_into_trie_wildcard(struct TrieNode *pParent, int min,
   return 0;
 }
 
-/* Insert constant into trie. */
+/* Insert constant into trie. Every frequent word has a unique number, thus
+ comparing the numbers is enough to identify the word. */
 static int insert_cluster_into_trie_word(struct TrieNode *pParent, 
         struct Elem *pWord, struct Parameters *pParam)
 {
-  wordnumber_t hash;
   struct TrieNode *ptr, *pPrev;
   
-  hash = str2hash(pWord->pKey, pParam->prefixSketchSize,
-          pParam->prefixSketchSeed);
-  
   ptr = pParent->pChild;
   pPrev = 0;
   
-  while (ptr)
+  while (ptr && ptr->key > pWord->number)
   {
-    if (ptr->hashValue > hash)
-    {
-      pPrev = ptr;
-      ptr = ptr->pNext;
-      continue;
-    }
-    
-    if (ptr->hashValue == hash)
-    {
-      if (!strcmp(ptr->pWord->pKey, pWord->pKey))
-      {
-        pParam->pPrefixRet = ptr;
-        return 1;
-      }
-      else
-      {
-        pPrev = ptr;
-        ptr = ptr->pNext;
-        continue;
-      }
-      
-    }
-    
-    if (ptr->hashValue < hash)
-    {
-      pParam->pPrefixRet = pPrev;
-      return 0;
-    }
+    pPrev = ptr;
+    ptr = ptr->pNext;
+  }
+  
+  if (ptr && ptr->key == pWord->number)
+  {
+    pParam->pPrefixRet = ptr;
+    return 1;
   }
   
   pParam->pPrefixRet = pPrev;
   return 0;
 }
 
+/* Take a node from the current block, start a new block if it is full. */
+static struct TrieNode *alloc_trie_node(struct Parameters *pParam)
+{
+  struct TrieNodeBlock *pBlock;
+  
+  pBlock = pParam->pTrieNodeBlocks;
+  if (!pBlock || pBlock->used == TRIE_POOL_BLOCK)
+  {
+    pBlock = (struct TrieNodeBlock *) malloc(sizeof(struct TrieNodeBlock));
+    if (!pBlock)
+    {
+      log_msg(MALLOC_ERR_6028, LOG_ERR, pParam);
+      exit(1);
+    }
+    pBlock->used = 0;
+    pBlock->pNext = pParam->pTrieNodeBlocks;
+    pParam->pTrieNodeBlocks = pBlock;
+    pParam->trieBuildBytes += sizeof(struct TrieNodeBlock);
+  }
+  
+  return &pBlock->nodes[pBlock->used++];
+}
+
+/* Release all linked nodes, one block at a time. */
+static void free_trie_node_pool(struct Parameters *pParam)
+{
+  struct TrieNodeBlock *pBlock, *pNext;
+  
+  for (pBlock = pParam->pTrieNodeBlocks; pBlock; pBlock = pNext)
+  {
+    pNext = pBlock->pNext;
+    free((void *) pBlock);
+  }
+  
+  pParam->pTrieNodeBlocks = 0;
+}
+
 /* The first parameter indicates whether the node is constant or wildcard. If
  node is constant, it will be the pointer of {struct Elem}. If node is
  wildcard, it will be null(0). */
@@ -307,25 +330,19 @@ static struct TrieNode *create_trie_node(struct Elem *pElem,
         struct TrieNode *pParent, struct TrieNode *pPrev, 
         struct Parameters *pParam)
 {
-  struct TrieNode *pNode = (struct TrieNode *) malloc(sizeof(struct TrieNode));
-  if (!pNode)
-  {
-    log_msg(MALLOC_ERR_6002, LOG_ERR, pParam);
-    exit(1);
-  }
+  struct TrieNode *pNode = alloc_trie_node(pParam);
   
   pParam->trieNodeNum++;
   
   if (pElem == 0)
   {
-    pNode->hashValue = pParam->wildcardHash;
+    pNode->key = pParam->wildcardKey;
     pNode->wildcardMin = pParam->prefixWildcardMin;
     pNode->wildcardMax = pParam->prefixWildcardMax;
   }
   else
   {
-    pNode->hashValue = str2hash(pElem->pKey, pParam->prefixSketchSize,
-                  pParam->prefixSketchSeed);
+    pNode->key = pElem->number;
     pNode->wildcardMin = 0;
     pNode->wildcardMax = 0;
   }
@@ -351,6 +368,109 @@ static struct TrieNode *create_trie_node(struct Elem *pElem,
   return pNode;
 }
 
+/* Copy the prefix tree into pParam->pTrie[] in breadth-first order, so that
+ children of every node occupy a contiguous range of the array, and the
+ aggregation walks through neighbouring memory instead of chasing pointers.
+ Root is pTrie[0]. Each cluster candidate gets the index of its last node.
+ 
+ The traversal uses an array of linked nodes as the breadth-first queue, so
+ that it needs no recursion. Afterwards all linked nodes are released with
+ their blocks. */
+static void freeze_prefix_trie(struct TrieNode *pRoot, 
+        struct Parameters *pParam)
+{
+  struct TrieNode **ppQueue;
+  struct TrieNode *pNode, *pChild;
+  struct TrieArrayNode *pFrozen;
+  trieindex_t head, tail;
+  
+  if (pParam->trieNodeNum > (trieindex_t) -1)
+  {
+    log_msg("Too many nodes in the prefix tree", LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  ppQueue = (struct TrieNode **) malloc(sizeof(struct TrieNode *) *
+                      pParam->trieNodeNum);
+  pParam->pTrie = (struct TrieArrayNode *) malloc(sizeof(struct TrieArrayNode)
+                          * pParam->trieNodeNum);
+  if (!ppQueue || !pParam->pTrie)
+  {
+    log_msg(MALLOC_ERR_6024, LOG_ERR, pParam);
+    exit(1);
+  }
+  pParam->trieBytes = sizeof(struct TrieArrayNode) * pParam->trieNodeNum;
+  
+  ppQueue[0] = pRoot;
+  pParam->pTrie[0].parent = 0;
+  tail = 1;
+  
+  for (head = 0; head < tail; head++)
+  {
+    pNode = ppQueue[head];
+    pFrozen = &pParam->pTrie[head];
+    
+    pFrozen->key = pNode->key;
+    pFrozen->wildcardMin = pNode->wildcardMin;
+    pFrozen->wildcardMax = pNode->wildcardMax;
+    pFrozen->pIsEnd = pNode->pIsEnd;
+    if (pNode->pIsEnd)
+    {
+      pNode->pIsEnd->lastNode = head;
+    }
+    
+    pFrozen->firstChild = tail;
+    for (pChild = pNode->pChild; pChild; pChild = pChild->pNext)
+    {
+      ppQueue[tail] = pChild;
+      pParam->pTrie[tail].parent = head;
+      tail++;
+    }
+    pFrozen->childNum = tail - pFrozen->firstChild;
+    
+    pFrozen->subtreeSize = 1;
+    pFrozen->subtreeSupport = pNode->pIsEnd ? pNode->pIsEnd->count : 0;
+    if (pFrozen->wildcardMax == 0 && head)
+    {
+      pFrozen->wordBloom = TRIE_BLOOM_BIT(pFrozen->key);
+      pFrozen->maxConstants = 1;
+    }
+    else
+    {
+      pFrozen->wordBloom = 0;
+      pFrozen->maxConstants = 0;
+    }
+  }
+  
+  /* Children always come after their parent in breadth-first order, thus one
+   backward sweep propagates the subtree summaries up to root. */
+  for (head = tail - 1; head > 0; head--)
+  {
+    pFrozen = &pParam->pTrie[head];
+    pParam->pTrie[pFrozen->parent].wordBloom |= pFrozen->wordBloom;
+    pParam->pTrie[pFrozen->parent].subtreeSize += pFrozen->subtreeSize;
+    pParam->pTrie[pFrozen->parent].subtreeSupport += pFrozen->subtreeSupport;
+    
+    if (pParam->pTrie[pFrozen->parent].wildcardMax == 0 && pFrozen->parent)
+    {
+      if (pParam->pTrie[pFrozen->parent].maxConstants < 
+          pFrozen->maxConstants + 1)
+      {
+        pParam->pTrie[pFrozen->parent].maxConstants = 
+            pFrozen->maxConstants + 1;
+      }
+    }
+    else if (pParam->pTrie[pFrozen->parent].maxConstants < 
+        pFrozen->maxConstants)
+    {
+      pParam->pTrie[pFrozen->parent].maxConstants = pFrozen->maxConstants;
+    }
+  }
+  
+  free((void *) ppQueue);
+  free_trie_node_pool(pParam);
+}
+
 /* There is a potential support value overlapping problem. Though rare, because
  the order I select cluster candidates to aggregate is from small constants to
  big constants, it could still happen.
@@ -360,25 +480,103 @@ static struct TrieNode *create_trie_node(struct Elem *pElem,
  aggregate process. After the aggregate process is done for every cluster
  candidates, transfer the count in {struct Elem} to {struct Cluster}. 
  
- This solution has been implemented. */
+ This solution has been implemented.
+ 
+ It also makes the candidates independent of each other: the prefix tree and
+ {struct Cluster} counts are only read, and each candidate only writes its own
+ pElem->count. Therefore the candidates are collected into an array and
+ aggregated by parallel_for() ('--threads' option), and the result does not
+ depend on the number of threads.
+ 
+ Candidates which can not reach the support threshold even after aggregation
+ are skipped (see can_reach_support()). They stay in the prefix tree and the
+ inverted index, since they can still be more specific candidates of others.
+ Their support is not used after Step3, except for deciding outliers, where
+ a value below the threshold has the same effect. In '--debug=1' mode every
+ candidate is aggregated, because all of them are printed. */
 static void aggregate_candidates(struct Parameters *pParam)
 {
   int i;
   struct Cluster *ptr;
-  
+  struct Cluster **ppCandidates;
+  struct AggregateJob job;
+  unsigned long candidateNum, prunedNum;
+  support_t *pWordSupport;
+  struct Cluster **ppLast;
+  char digitTrie[MAXDIGITBIT], digitIndex[MAXDIGITBIT];
+  char digitPruned[MAXDIGITBIT];
+  char logStr[MAXLOGMSGLEN];
+  
+  candidateNum = 0;
   for (i = 1; i <= pParam->biggestConstants; i++)
   {
-    ptr = pParam->pClusterFamily[i];
-    while (ptr)
+    for (ptr = pParam->pClusterFamily[i]; ptr; ptr = ptr->pNext)
     {
-      if (get_first_wildcard_location(ptr) >= 0)
+      candidateNum++;
+    }
+  }
+  
+  ppCandidates = (struct Cluster **) malloc((candidateNum + 1) * 
+                        sizeof(struct Cluster *));
+  pWordSupport = (support_t *) calloc(pParam->freWordNum + 2, 
+                      sizeof(support_t));
+  ppLast = (struct Cluster **) calloc(pParam->freWordNum + 2, 
+                      sizeof(struct Cluster *));
+  if (!ppCandidates || !pWordSupport || !ppLast)
+  {
+    log_msg(MALLOC_ERR_6026, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  /* Candidates are visited from the biggest constants to the smallest. When
+   the candidates with i constants are reached, pWordSupport[] holds the
+   summed supports of candidates with at least i constants, which are the only
+   ones that can be more specific. */
+  candidateNum = 0;
+  prunedNum = 0;
+  for (i = pParam->biggestConstants; i >= 1; i--)
+  {
+    for (ptr = pParam->pClusterFamily[i]; ptr; ptr = ptr->pNext)
+    {
+      add_word_supports(ptr, pWordSupport, ppLast);
+    }
+    
+    for (ptr = pParam->pClusterFamily[i]; ptr; ptr = ptr->pNext)
+    {
+      if (get_first_wildcard_location(ptr) < 0)
       {
-        aggregate_candidate(ptr, pParam);
+        continue;
+      }
+      
+      if (pParam->debug == 1 || can_reach_support(ptr, pWordSupport, pParam))
+      {
+        ppCandidates[candidateNum++] = ptr;
+      }
+      else
+      {
+        prunedNum++;
       }
-      ptr = ptr->pNext;
     }
   }
   
+  free((void *) pWordSupport);
+  free((void *) ppLast);
+  
+  job.ppCandidates = ppCandidates;
+  job.pParam = pParam;
+  job.trieNum = 0;
+  job.indexNum = 0;
+  parallel_for(candidateNum, aggregate_candidate_body, &job, pParam);
+  
+  str_format_int_grouped(digitTrie, job.trieNum);
+  str_format_int_grouped(digitIndex, job.indexNum);
+  str_format_int_grouped(digitPruned, prunedNum);
+  sprintf(logStr, "%s candidates aggregated with the prefix tree, %s with the "
+      "inverted index, %s skipped by upper bound.", digitTrie, digitIndex,
+      digitPruned);
+  log_msg(logStr, LOG_INFO, pParam);
+  free((void *) ppCandidates);
+  
   /* After aggregation is done, assign each cluster candidates with the
    post-processed support value. ptr->pElem->count acts as a mid transfer. */
   for (i = 1; i <= pParam->biggestConstants; i++)
@@ -393,6 +591,92 @@ static void aggregate_candidates(struct Parameters *pParam)
   }
 }
 
+/* Add the support of a cluster candidate to the summed support of each of its
+ constants. ppLast[] remembers the last candidate added for each word, so that
+ a word repeated in the same candidate is counted once. */
+static void add_word_supports(struct Cluster *pCluster, 
+        support_t *pWordSupport, struct Cluster **ppLast)
+{
+  wordnumber_t number;
+  int i;
+  
+  for (i = 1; i <= pCluster->constants; i++)
+  {
+    number = pCluster->ppWord[i]->number;
+    if (ppLast[number] != pCluster)
+    {
+      ppLast[number] = pCluster;
+      pWordSupport[number] += pCluster->count;
+    }
+  }
+}
+
+/* Every more specific candidate contains all constants of pCluster, and has
+ at least as many constants, thus the aggregated support can not exceed the
+ summed support of any of its constants in pWordSupport[]. If the prefix tree
+ is built, every more specific candidate also ends below the common parent,
+ thus the summed support of the subtree is another upper bound.
+ Return 0 if any of these bounds is below the support threshold. */
+static int can_reach_support(struct Cluster *pCluster, support_t *pWordSupport,
+        struct Parameters *pParam)
+{
+  int i;
+  
+  if (pParam->pTrie && 
+      pParam->pTrie[get_common_parent(pCluster, pParam)].subtreeSupport < 
+      pParam->support)
+  {
+    return 0;
+  }
+  
+  for (i = 1; i <= pCluster->constants; i++)
+  {
+    if (pWordSupport[pCluster->ppWord[i]->number] < pParam->support)
+    {
+      return 0;
+    }
+  }
+  
+  return 1;
+}
+
+static void aggregate_candidate_body(unsigned long index, int worker, 
+        void *pArg)
+{
+  struct AggregateJob *pJob;
+  struct Parameters *pParam;
+  struct Cluster *pCluster;
+  int bUseIndex;
+  
+  pJob = (struct AggregateJob *) pArg;
+  pParam = pJob->pParam;
+  pCluster = pJob->ppCandidates[index];
+  
+  if (pParam->aggrEngine == AGGR_ENGINE_AUTO)
+  {
+    bUseIndex = get_shortest_posting_length(pCluster, pParam) * 
+        AGGR_INDEX_COST_FACTOR < 
+        pParam->pTrie[get_common_parent(pCluster, pParam)].subtreeSize;
+  }
+  else
+  {
+    bUseIndex = (pParam->aggrEngine == AGGR_ENGINE_INDEX);
+  }
+  
+  if (bUseIndex)
+  {
+    aggregate_candidate_by_index(pCluster, 
+                   get_first_wildcard_location(pCluster), worker,
+                   pParam);
+    __atomic_fetch_add(&pJob->indexNum, 1, __ATOMIC_RELAXED);
+  }
+  else
+  {
+    aggregate_candidate(pCluster, pParam);
+    __atomic_fetch_add(&pJob->trieNum, 1, __ATOMIC_RELAXED);
+  }
+}
+
 /* Find the first wildcard of a cluster candidates, counting from left to
  right. In other words, find the first constant, who has a wildcard. */
 static int get_first_wildcard_location(struct Cluster *pCluster)
@@ -415,26 +699,30 @@ static int get_first_wildcard_location(struct Cluster *pCluster)
   return -1;
 }
 
-/* This function is called by function aggregate_candidates(). */
+/* This function is called by function aggregate_candidates().
+ suffixBloom[i] has TRIE_BLOOM_BIT() set for constants i...constants of the
+ cluster candidate. A subtree is only searched for the i-th constant, if its
+ wordBloom contains suffixBloom[i]. */
 static void aggregate_candidate(struct Cluster *pCluster, 
         struct Parameters *pParam)
 {
-  struct TrieNode *pParent;
+  unsigned long long suffixBloom[MAXWORDS + 2];
+  trieindex_t parent;
   int firstWildcardLoc;
-  wordnumber_t hash;
+  int i;
   
   firstWildcardLoc = get_first_wildcard_location(pCluster);
-  hash = 0;
   
-  if (firstWildcardLoc)
+  suffixBloom[pCluster->constants + 1] = 0;
+  for (i = pCluster->constants; i >= 1; i--)
   {
-    hash = str2hash(pCluster->ppWord[firstWildcardLoc]->pKey,
-            pParam->prefixSketchSize, pParam->prefixSketchSeed);
+    suffixBloom[i] = suffixBloom[i + 1] | 
+        TRIE_BLOOM_BIT(pCluster->ppWord[i]->number);
   }
   
-  pParent = get_common_parent(pCluster);
-  find_more_specific(pParent, pCluster, firstWildcardLoc, 0, 0, hash, pParam);
-  
+  parent = get_common_parent(pCluster, pParam);
+  find_more_specific(parent, pCluster, firstWildcardLoc, 0, 0, suffixBloom,
+             pParam);
 }
 
 /* Find the common parent of a cluster candidate. From this node on, who is
@@ -442,22 +730,23 @@ static void aggregate_candidate(struct Cluster *pCluster,
  branches have potential of being specified expressions of our cluster
  candidate, thus their support values can be aggregated to our cluster
  candidate's support value. */
-static struct TrieNode *get_common_parent(struct Cluster *pCluster)
+static trieindex_t get_common_parent(struct Cluster *pCluster,
+        struct Parameters *pParam)
 {
-  struct TrieNode *ptr;
+  trieindex_t node;
   int reverseDepth;
   int i;
   
   reverseDepth = get_first_wildcard_reverse_depth(pCluster);
-  ptr = pCluster->pLastNode;
+  node = pCluster->lastNode;
   
   for (i = 1; i <= reverseDepth; i++)
   {
-    ptr = ptr->pParent;
+    node = pParam->pTrie[node].parent;
   }
   
-  /* ptr is the parent of the first wildcard node. */
-  return ptr;
+  /* node is the parent of the first wildcard node. */
+  return node;
 }
 
 /* Find the nearest wildcard, counting from the lowest leaf towards root. */
@@ -500,257 +789,160 @@ static int get_first_wildcard_reverse_depth(struct Cluster *pCluster)
 }
 
 /* The function to find the more specific cluster candidates for a certain
- cluster candidate. */
-static int find_more_specific(struct TrieNode *pParent, 
-        struct Cluster *pCluster, int constant, int min, int max, 
-        wordnumber_t hash, struct Parameters *pParam)
+ cluster candidate. min and max are the number of words that have been jumped
+ over (in the range of wildcards) since the last found constant.
+ 
+ A node is a word node if its wildcardMax is 0, and one word is jumped over.
+ Otherwise it is a wildcard node, and wildcardMin...wildcardMax words are
+ jumped over. */
+static void find_more_specific(trieindex_t parent, struct Cluster *pCluster,
+        int constant, int min, int max, unsigned long long *pSuffixBloom,
+        struct Parameters *pParam)
 {
-  struct TrieNode *ptr;
-  wordnumber_t hashTmp;
+  struct TrieArrayNode *ptr, *pEnd;
+  int childMin, childMax;
+  int remaining;
   
   /* To find the 0st constant, means to deal with the tail of the cluster
    candidates. */
   if (constant == 0)
   {
-    find_more_specific_tail(pParent, pCluster, min, max);
-    return 0;
+    find_more_specific_tail(parent, pCluster, min, max, pParam);
+    return;
   }
   
-  for (ptr = pParent->pChild; ptr; ptr = ptr->pNext)
+  remaining = pCluster->constants - constant + 1;
+  ptr = pParam->pTrie + pParam->pTrie[parent].firstChild;
+  pEnd = ptr + pParam->pTrie[parent].childNum;
+  
+  for (; ptr < pEnd; ptr++)
   {
+    /* Every more specific cluster candidate below this node must contain the
+     remaining constants. If the subtree can not have them, skip it. */
+    if ((ptr->wordBloom & pSuffixBloom[constant]) != pSuffixBloom[constant] ||
+        ptr->maxConstants < remaining)
+    {
+      continue;
+    }
+    
     if (ptr->wildcardMax == 0)
     {
-      min += 1;
-      max += 1;
+      childMin = min + 1;
+      childMax = max + 1;
     }
     else
     {
-      min += ptr->wildcardMin;
-      max += ptr->wildcardMax;
+      childMin = min + ptr->wildcardMin;
+      childMax = max + ptr->wildcardMax;
     }
     
     /* If the jump time is not enough to statisfy the minimum wildcard, jump
      down the tree once more, still looking for this constant. */
-    if (min - 1 < pCluster->fullWildcard[constant * 2])
+    if (childMin - 1 < pCluster->fullWildcard[constant * 2])
     {
-      find_more_specific(ptr, pCluster, constant, min, max, hash, pParam);
-      
-      /* This node is done. Deal with its brothers. */
-      if (ptr->wildcardMax == 0)
-      {
-        min -= 1;
-        max -= 1;
-      }
-      else
-      {
-        min -= ptr->wildcardMin;
-        max -= ptr->wildcardMax;
-      }
+      find_more_specific(ptr - pParam->pTrie, pCluster, constant, childMin,
+                 childMax, pSuffixBloom, pParam);
       continue;
     }
     
-    if (max - 1 > pCluster->fullWildcard[(constant * 2) + 1])
+    /* Jumped over the maximum limit. Not possible to be more specific
+     cluster candidate anymore. */
+    if (childMax - 1 > pCluster->fullWildcard[(constant * 2) + 1])
     {
-      /* Jumped over the maximum limit. Not possible to be more specific
-       cluster candidate anymore. */
-      //break;
-      
-      if (ptr->wildcardMax == 0)
-      {
-        min -= 1;
-        max -= 1;
-      }
-      else
-      {
-        min -= ptr->wildcardMin;
-        max -= ptr->wildcardMax;
-      }
       continue;
     }
     
-    if (ptr->hashValue == hash &&
-      (!strcmp(ptr->pWord->pKey, pCluster->ppWord[constant]->pKey)))
-    {   //Found
-      /* The constants are not all found, continue to look up next
-       constant. */
-      if (constant < pCluster->constants)
-      {
-        hashTmp = str2hash(pCluster->ppWord[constant + 1]->pKey,
-                   pParam->prefixSketchSize,
-                   pParam->prefixSketchSeed);
-        find_more_specific(ptr, pCluster, constant + 1, 0, 0, hashTmp,
-                   pParam);
-        
-        /* After coming back, continue to deal with brothers. */
-        if (ptr->wildcardMax == 0)
-        {
-          min -= 1;
-          max -= 1;
-        }
-        else
-        {
-          min -= ptr->wildcardMin;
-          max -= ptr->wildcardMax;
-        }
-        continue;
-      }
-      /* If all the constants are found. There will be two cases to be
-       considered:
-       1. there is a wildcard in tail.(Tail means what is after the last
-       constant).
-       2. there is no wildcard in tail. */
-      if (constant == pCluster->constants)
+    if (ptr->key != pCluster->ppWord[constant]->number)
+    {
+      find_more_specific(ptr - pParam->pTrie, pCluster, constant, childMin,
+                 childMax, pSuffixBloom, pParam);
+      continue;
+    }
+    
+    //Found
+    /* The constants are not all found, continue to look up next
+     constant. */
+    if (constant < pCluster->constants)
+    {
+      find_more_specific(ptr - pParam->pTrie, pCluster, constant + 1, 0, 0,
+                 pSuffixBloom, pParam);
+      continue;
+    }
+    
+    /* If all the constants are found. There will be two cases to be
+     considered:
+     1. there is a wildcard in tail.(Tail means what is after the last
+     constant).
+     2. there is no wildcard in tail. */
+    if (pCluster->fullWildcard[1] == 0)
+    {
+      /* If there is no wildcard in tail, and if this node is a cluster
+       candidate's end node, one result is found. We aggregate the support
+       value. */
+      if (ptr->pIsEnd && (ptr->pIsEnd != pCluster))
       {
-        /* If there is no wildcard in tail, and if this node is a
-         cluster candidate's end node, one result is found. We
-         aggregate the support value. */
-        if (pCluster->fullWildcard[1] == 0)
-        {
-          if (ptr->pIsEnd && (ptr->pIsEnd != pCluster))
-          {
-            //aggregate support
-            //pCluster->count += ptr->pIsEnd->count;
-            pCluster->pElem->count += ptr->pIsEnd->count;
-          }
-          
-          /* Continue to deal with its brothers. */
-          if (ptr->wildcardMax == 0)
-          {
-            min -= 1;
-            max -= 1;
-          }
-          else
-          {
-            min -= ptr->wildcardMin;
-            max -= ptr->wildcardMax;
-          }
-          continue;
-        }
-        else
-        {
-          /* If there is a wildcard in tail, continue. Note the third
-           parameter is set to 0, which is different from normal
-           cases, and will trigger function find_more_specific_tail().
-           */
-          if (pCluster->fullWildcard[0] == 0 && ptr->pIsEnd &&
-            (ptr->pIsEnd != pCluster))
-          {
-            //aggregate support
-            //pCluster->count += ptr->pIsEnd->count;
-            pCluster->pElem->count += ptr->pIsEnd->count;
-          }
-          
-          find_more_specific(ptr, pCluster, 0, 0, 0, hash, pParam);
-          
-          if (ptr->wildcardMax == 0)
-          {
-            min -= 1;
-            max -= 1;
-          }
-          else
-          {
-            min -= ptr->wildcardMin;
-            max -= ptr->wildcardMax;
-          }
-          continue;
-        }
+        //aggregate support
+        pCluster->pElem->count += ptr->pIsEnd->count;
       }
-      
     }
     else
     {
-      find_more_specific(ptr, pCluster, constant, min, max, hash, pParam);
-      
-      if (ptr->wildcardMax == 0)
-      {
-        min -= 1;
-        max -= 1;
-      }
-      else
+      /* If there is a wildcard in tail, continue with the tail. */
+      if (pCluster->fullWildcard[0] == 0 && ptr->pIsEnd &&
+        (ptr->pIsEnd != pCluster))
       {
-        min -= ptr->wildcardMin;
-        max -= ptr->wildcardMax;
+        //aggregate support
+        pCluster->pElem->count += ptr->pIsEnd->count;
       }
-      continue;
+      
+      find_more_specific_tail(ptr - pParam->pTrie, pCluster, 0, 0, pParam);
     }
   }
-  
-  return 0;
 }
 
-static int find_more_specific_tail(struct TrieNode *pParent, 
-        struct Cluster*pCluster, int min, int max)
+static void find_more_specific_tail(trieindex_t parent, 
+        struct Cluster *pCluster, int min, int max, struct Parameters *pParam)
 {
-  struct TrieNode *ptr;
+  struct TrieArrayNode *ptr, *pEnd;
+  int childMin, childMax;
+  
+  ptr = pParam->pTrie + pParam->pTrie[parent].firstChild;
+  pEnd = ptr + pParam->pTrie[parent].childNum;
   
-  for (ptr = pParent->pChild; ptr; ptr = ptr->pNext)
+  for (; ptr < pEnd; ptr++)
   {
     if (ptr->wildcardMax == 0)
     {
-      min += 1;
-      max += 1;
+      childMin = min + 1;
+      childMax = max + 1;
     }
     else
     {
-      min += ptr->wildcardMin;
-      max += ptr->wildcardMax;
+      childMin = min + ptr->wildcardMin;
+      childMax = max + ptr->wildcardMax;
     }
     
-    if (min < pCluster->fullWildcard[0])
+    if (childMin < pCluster->fullWildcard[0])
     {
-      find_more_specific_tail(ptr, pCluster, min, max);
-      if (ptr->wildcardMax == 0)
-      {
-        min -= 1;
-        max -= 1;
-      }
-      else
-      {
-        min -= ptr->wildcardMin;
-        max -= ptr->wildcardMax;
-      }
+      find_more_specific_tail(ptr - pParam->pTrie, pCluster, childMin,
+                  childMax, pParam);
       continue;
     }
     
-    if (max > pCluster->fullWildcard[1])
+    /* Exceeds the legal jump range. Not possible to be a more specific
+     cluster candidates any more. */
+    if (childMax > pCluster->fullWildcard[1])
     {
-      /* Exceeds the legal jump range. Not possible to be a more specific
-       cluster candidates any more. */
-      //break;
-      if (ptr->wildcardMax == 0)
-      {
-        min -= 1;
-        max -= 1;
-      }
-      else
-      {
-        min -= ptr->wildcardMin;
-        max -= ptr->wildcardMax;
-      }
-      
       continue;
     }
     
     if (ptr->pIsEnd && (ptr->pIsEnd != pCluster))
     {
       //aggregate support
-      //pCluster->count += ptr->pIsEnd->count;
       pCluster->pElem->count += ptr->pIsEnd->count;
     }
     
-    find_more_specific_tail(ptr, pCluster, min, max);
-    if (ptr->wildcardMax == 0)
-    {
-      min -= 1;
-      max -= 1;
-    }
-    else
-    {
-      min -= ptr->wildcardMin;
-      max -= ptr->wildcardMax;
-    }
-    //continue;
+    find_more_specific_tail(ptr - pParam->pTrie, pCluster, childMin, childMax,
+                pParam);
   }
-  
-  return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,465 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* 
+ * File:   aggregate_supports_index.c
+ * 
+ * Content: Inverted index engine of Aggregate_Supports heuristics. Instead of
+ * walking the prefix tree, the candidates containing all constants of a given
+ * candidate are found by intersecting posting lists, and each of them is
+ * checked with the same rules as find_more_specific() applies to a path of the
+ * prefix tree.
+ *
+ * Created on October 19, 2026, 9:05 PM
+ */
+
+#include "common_header.h"
+#include "aggregate_supports_index.h"
+
+#include "output.h"
+
+/* Return values of match_step(). */
+#define MATCH_FAILED 0
+#define MATCH_FOUND 1
+#define MATCH_CONTINUE 2
+
+/* The state of matching a cluster candidate against a more specific one, the
+ same as the parameters of find_more_specific(). constant is 0 while matching
+ the tail. */
+struct MatchState {
+  int constant;
+  int min;
+  int max;
+};
+
+static unsigned long intersect_postings(unsigned int *pShort, 
+        unsigned long shortLen, unsigned int *pLong, unsigned long longLen,
+        unsigned int *pOut);
+static int is_more_specific(struct Cluster *pCluster, int location,
+        struct Cluster *pOther);
+static int match_step(struct Cluster *pCluster, struct MatchState *pState,
+        wordnumber_t number, int wildcardMin, int wildcardMax, int bLast);
+
+/* Collect all cluster candidates into candidateIndex.ppCandidates[], and build
+ the posting list of every frequent word. A candidate is only added once to
+ the posting list of a word, even if the word occurs in it several times. */
+void build_candidate_index(struct Parameters *pParam)
+{
+  struct CandidateIndex *pIndex;
+  struct Cluster *ptr;
+  unsigned long *pFill;
+  unsigned long id, len;
+  wordnumber_t number;
+  int i, j;
+  
+  pIndex = &pParam->candidateIndex;
+  
+  pIndex->candidateNum = 0;
+  for (i = 1; i <= pParam->biggestConstants; i++)
+  {
+    for (ptr = pParam->pClusterFamily[i]; ptr; ptr = ptr->pNext)
+    {
+      pIndex->candidateNum++;
+    }
+  }
+  
+  if (pIndex->candidateNum > (unsigned int) -1)
+  {
+    log_msg("Too many cluster candidates for the inverted index", LOG_ERR,
+        pParam);
+    exit(1);
+  }
+  
+  pIndex->ppCandidates = (struct Cluster **) malloc((pIndex->candidateNum + 1)
+                            * sizeof(struct Cluster *));
+  pIndex->pPostingStart = (unsigned long *) calloc(pParam->freWordNum + 2,
+                           sizeof(unsigned long));
+  pFill = (unsigned long *) malloc((pParam->freWordNum + 2) * 
+                   sizeof(unsigned long));
+  if (!pIndex->ppCandidates || !pIndex->pPostingStart || !pFill)
+  {
+    log_msg(MALLOC_ERR_6027, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  /* Count the postings of each word. pFill[] remembers the last candidate
+   counted for a word, so that repeated words are counted once. */
+  for (number = 0; number < pParam->freWordNum + 2; number++)
+  {
+    pFill[number] = (unsigned long) -1;
+  }
+  
+  id = 0;
+  for (i = 1; i <= pParam->biggestConstants; i++)
+  {
+    for (ptr = pParam->pClusterFamily[i]; ptr; ptr = ptr->pNext)
+    {
+      pIndex->ppCandidates[id] = ptr;
+      for (j = 1; j <= ptr->constants; j++)
+      {
+        number = ptr->ppWord[j]->number;
+        if (pFill[number] != id)
+        {
+          pFill[number] = id;
+          pIndex->pPostingStart[number + 1]++;
+        }
+      }
+      id++;
+    }
+  }
+  
+  pIndex->maxPostingLen = 0;
+  for (number = 1; number < pParam->freWordNum + 2; number++)
+  {
+    len = pIndex->pPostingStart[number];
+    if (len > pIndex->maxPostingLen)
+    {
+      pIndex->maxPostingLen = len;
+    }
+    pIndex->pPostingStart[number] += pIndex->pPostingStart[number - 1];
+  }
+  
+  pIndex->pPostings = (unsigned int *) malloc((pIndex->pPostingStart[
+                          pParam->freWordNum + 1] + 1) *
+                          sizeof(unsigned int));
+  pIndex->pScratch = (unsigned int *) malloc((2 * pIndex->maxPostingLen + 1) *
+                         pParam->threadNum *
+                         sizeof(unsigned int));
+  if (!pIndex->pPostings || !pIndex->pScratch)
+  {
+    log_msg(MALLOC_ERR_6027, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  /* Fill the postings. Candidates are visited in id order, so every posting
+   list is sorted. */
+  for (number = 0; number < pParam->freWordNum + 2; number++)
+  {
+    pFill[number] = pIndex->pPostingStart[number];
+  }
+  
+  for (id = 0; id < pIndex->candidateNum; id++)
+  {
+    ptr = pIndex->ppCandidates[id];
+    for (j = 1; j <= ptr->constants; j++)
+    {
+      number = ptr->ppWord[j]->number;
+      if (pFill[number] == pIndex->pPostingStart[number] ||
+          pIndex->pPostings[pFill[number] - 1] != id)
+      {
+        pIndex->pPostings[pFill[number]++] = (unsigned int) id;
+      }
+    }
+  }
+  
+  free((void *) pFill);
+}
+
+/* The length of the shortest posting list among the constants of a cluster
+ candidate. It is an upper bound of the candidates to be checked. */
+unsigned long get_shortest_posting_length(struct Cluster *pCluster,
+        struct Parameters *pParam)
+{
+  unsigned long *pStart;
+  unsigned long len, shortest;
+  wordnumber_t number;
+  int i;
+  
+  pStart = pParam->candidateIndex.pPostingStart;
+  shortest = (unsigned long) -1;
+  
+  for (i = 1; i <= pCluster->constants; i++)
+  {
+    number = pCluster->ppWord[i]->number;
+    len = pStart[number + 1] - pStart[number];
+    if (len < shortest)
+    {
+      shortest = len;
+    }
+  }
+  
+  return shortest;
+}
+
+/* Aggregate the support of one cluster candidate, whose first wildcard is
+ before its location-th constant (0 means the tail). The posting lists of
+ its constants are intersected from the shortest to the longest, using the
+ worker's scratch buffers, and the surviving candidates are checked one by
+ one. */
+void aggregate_candidate_by_index(struct Cluster *pCluster, int location,
+        int worker, struct Parameters *pParam)
+{
+  struct CandidateIndex *pIndex;
+  struct Cluster *pOther;
+  unsigned int *pBuffer[2];
+  unsigned int *pSurvivors;
+  unsigned long survivorNum, i;
+  wordnumber_t order[MAXWORDS + 1];
+  wordnumber_t number;
+  unsigned long len;
+  int orderNum, j, k, toggle;
+  
+  pIndex = &pParam->candidateIndex;
+  pBuffer[0] = pIndex->pScratch + 
+      (unsigned long) worker * (2 * pIndex->maxPostingLen + 1);
+  pBuffer[1] = pBuffer[0] + pIndex->maxPostingLen;
+  
+  /* Distinct constants, sorted by the length of their posting lists, from
+   short to long (insertion sort, there are only a few of them). */
+  orderNum = 0;
+  for (j = 1; j <= pCluster->constants; j++)
+  {
+    number = pCluster->ppWord[j]->number;
+    len = pIndex->pPostingStart[number + 1] - pIndex->pPostingStart[number];
+    
+    for (k = 0; k < orderNum && order[k] != number; k++)
+    {
+      ;
+    }
+    if (k < orderNum)
+    {
+      continue;
+    }
+    
+    for (k = orderNum; k > 0 && 
+        pIndex->pPostingStart[order[k - 1] + 1] - 
+        pIndex->pPostingStart[order[k - 1]] > len; k--)
+    {
+      order[k] = order[k - 1];
+    }
+    order[k] = number;
+    orderNum++;
+  }
+  
+  /* A candidate always has a constant, but there would be nothing to
+   intersect without one. */
+  if (!orderNum)
+  {
+    return;
+  }
+  
+  pSurvivors = pIndex->pPostings + pIndex->pPostingStart[order[0]];
+  survivorNum = pIndex->pPostingStart[order[0] + 1] - 
+      pIndex->pPostingStart[order[0]];
+  toggle = 0;
+  
+  for (k = 1; k < orderNum && survivorNum; k++)
+  {
+    survivorNum = intersect_postings(pSurvivors, survivorNum,
+                     pIndex->pPostings + 
+                     pIndex->pPostingStart[order[k]],
+                     pIndex->pPostingStart[order[k] + 1] - 
+                     pIndex->pPostingStart[order[k]],
+                     pBuffer[toggle]);
+    pSurvivors = pBuffer[toggle];
+    toggle ^= 1;
+  }
+  
+  for (i = 0; i < survivorNum; i++)
+  {
+    pOther = pIndex->ppCandidates[pSurvivors[i]];
+    if (pOther != pCluster && pOther->constants >= pCluster->constants &&
+        is_more_specific(pCluster, location, pOther))
+    {
+      pCluster->pElem->count += pOther->count;
+    }
+  }
+}
+
+/* Intersect two sorted posting lists into pOut, and return the length of the
+ result. Each id of the short list is searched in the long list by galloping
+ forward from the position of the previous id. */
+static unsigned long intersect_postings(unsigned int *pShort, 
+        unsigned long shortLen, unsigned int *pLong, unsigned long longLen,
+        unsigned int *pOut)
+{
+  unsigned long i, low, high, step, middle, outNum;
+  
+  outNum = 0;
+  low = 0;
+  
+  for (i = 0; i < shortLen && low < longLen; i++)
+  {
+    step = 1;
+    high = low;
+    while (high < longLen && pLong[high] < pShort[i])
+    {
+      low = high + 1;
+      high += step;
+      step <<= 1;
+    }
+    if (high > longLen)
+    {
+      high = longLen;
+    }
+    
+    /* pLong[low - 1] < pShort[i], and pLong[high] >= pShort[i] if high is
+     within the list. */
+    while (low < high)
+    {
+      middle = low + (high - low) / 2;
+      if (pLong[middle] < pShort[i])
+      {
+        low = middle + 1;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+    
+    if (low < longLen && pLong[low] == pShort[i])
+    {
+      pOut[outNum++] = pShort[i];
+      low++;
+    }
+  }
+  
+  return outNum;
+}
+
+/* Check whether pOther would be found by find_more_specific() for pCluster,
+ when walking down its path in the prefix tree. Constants before location are
+ the common parent's path, thus they must be the same and without wildcards.
+ The nodes after the common parent are fed to match_step() one by one. */
+static int is_more_specific(struct Cluster *pCluster, int location,
+        struct Cluster *pOther)
+{
+  struct MatchState state;
+  int prefix, i, ret;
+  
+  prefix = location ? location - 1 : pCluster->constants;
+  
+  for (i = 1; i <= prefix; i++)
+  {
+    if (pOther->fullWildcard[i * 2 + 1] != 0 || 
+        pOther->ppWord[i] != pCluster->ppWord[i])
+    {
+      return 0;
+    }
+  }
+  
+  state.constant = location;
+  state.min = 0;
+  state.max = 0;
+  ret = MATCH_CONTINUE;
+  
+  for (i = prefix + 1; i <= pOther->constants && ret == MATCH_CONTINUE; i++)
+  {
+    if (pOther->fullWildcard[i * 2 + 1] != 0)
+    {
+      ret = match_step(pCluster, &state, 0, pOther->fullWildcard[i * 2],
+               pOther->fullWildcard[i * 2 + 1], 0);
+    }
+    
+    if (ret == MATCH_CONTINUE)
+    {
+      ret = match_step(pCluster, &state, pOther->ppWord[i]->number, 0, 0, 
+               i == pOther->constants && pOther->fullWildcard[1] == 0);
+    }
+  }
+  
+  if (ret == MATCH_CONTINUE && pOther->fullWildcard[1] != 0)
+  {
+    ret = match_step(pCluster, &state, 0, pOther->fullWildcard[0], 
+             pOther->fullWildcard[1], 1);
+  }
+  
+  return ret == MATCH_FOUND;
+}
+
+/* One step of find_more_specific() or find_more_specific_tail(), for a node
+ which is either a word (wildcardMax is 0) or a wildcard. bLast is set if the
+ node is the end of pOther. */
+static int match_step(struct Cluster *pCluster, struct MatchState *pState,
+        wordnumber_t number, int wildcardMin, int wildcardMax, int bLast)
+{
+  int childMin, childMax;
+  int constant;
+  
+  if (wildcardMax == 0)
+  {
+    childMin = pState->min + 1;
+    childMax = pState->max + 1;
+  }
+  else
+  {
+    childMin = pState->min + wildcardMin;
+    childMax = pState->max + wildcardMax;
+  }
+  
+  constant = pState->constant;
+  
+  if (constant == 0)
+  {
+    if (childMin >= pCluster->fullWildcard[0])
+    {
+      if (childMax > pCluster->fullWildcard[1])
+      {
+        return MATCH_FAILED;
+      }
+      
+      if (bLast)
+      {
+        return MATCH_FOUND;
+      }
+    }
+    
+    pState->min = childMin;
+    pState->max = childMax;
+    return MATCH_CONTINUE;
+  }
+  
+  if (childMin - 1 >= pCluster->fullWildcard[constant * 2])
+  {
+    if (childMax - 1 > pCluster->fullWildcard[(constant * 2) + 1])
+    {
+      return MATCH_FAILED;
+    }
+    
+    if (wildcardMax == 0 && number == pCluster->ppWord[constant]->number)
+    {
+      //Found
+      if (constant < pCluster->constants)
+      {
+        pState->constant++;
+        pState->min = 0;
+        pState->max = 0;
+        return MATCH_CONTINUE;
+      }
+      
+      if (pCluster->fullWildcard[1] == 0)
+      {
+        return bLast ? MATCH_FOUND : MATCH_FAILED;
+      }
+      
+      if (pCluster->fullWildcard[0] == 0 && bLast)
+      {
+        return MATCH_FOUND;
+      }
+      
+      pState->constant = 0;
+      pState->min = 0;
+      pState->max = 0;
+      return MATCH_CONTINUE;
+    }
+  }
+  
+  pState->min = childMin;
+  pState->max = childMax;
+  return MATCH_CONTINUE;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* 
+ * File:   aggregate_supports_index.h
+ * 
+ * Content: Declarations of global functions in aggregate_supports_index.c .
+ *
+ * Created on October 19, 2026, 9:05 PM
+ */
+
+#ifndef AGGREGATE_SUPPORTS_INDEX_H
+#define AGGREGATE_SUPPORTS_INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void build_candidate_index(struct Parameters *pParam);
+unsigned long get_shortest_posting_length(struct Cluster *pCluster,
+        struct Parameters *pParam);
+void aggregate_candidate_by_index(struct Cluster *pCluster, int location,
+        int worker, struct Parameters *pParam);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AGGREGATE_SUPPORTS_INDEX_H */
+
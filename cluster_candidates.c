@@ -34,17 +34,36 @@
 #include "utility.h"
 #include "word_filter_search_replace.h"
 #include "join_clusters_heuristic.h"
+#include "sketch.h"
+#include "pipeline.h"
+#include "table_alloc.h"
 
-static tableindex_t create_cluster_candidate_sketch(struct Parameters *pParam);
-static tableindex_t create_cluster_candidate_sketch_with_wfilter(
-  struct Parameters *pParam);
-static wordnumber_t create_cluster_candidates_word_dep(struct Parameters 
-  *pParam);
-static wordnumber_t create_cluster_candidates_word_dep_with_filter(
-  struct Parameters *pParam);
-static wordnumber_t create_cluster_candidates(struct Parameters *pParam);
-static wordnumber_t create_cluster_candidates_with_wfilter(struct Parameters 
-  *pParam);
+/* The cluster candidate of one line, as passed from the tokenizers to
+ candidate_consume(). */
+struct CandidateRecord {
+  int constants;
+  int distinctConstants;
+  int bCluster;
+  struct Elem *pStorage[];
+};
+
+/* State of the cluster candidate pass. */
+struct CandidatePass {
+  wordnumber_t clusterCount;
+  struct Parameters *pParam;
+};
+
+static void cluster_sketch_line(struct SketchWorker *pWorker,
+        struct Parameters *pParam);
+static void cluster_sketch_line_with_wfilter(struct SketchWorker *pWorker,
+        struct Parameters *pParam);
+static void candidate_tokenize(char *line, struct PipelineWorker *pWorker,
+        struct Parameters *pParam);
+static void candidate_tokenize_with_wfilter(char *line,
+        struct PipelineWorker *pWorker, struct Parameters *pParam);
+static void append_candidate_record(struct PipelineWorker *pWorker,
+        int constants, int distinctConstants, struct Parameters *pParam);
+static void candidate_consume(char *pRecord, size_t len, void *pArg);
 
 
 static struct Cluster *create_cluster_instance(struct Elem* pClusterElem,
@@ -56,27 +75,21 @@ static void adjust_cluster_instance(struct Elem* pClusterElem, int constants,
 
 void step_2_create_cluster_candidate_sketch(struct Parameters *pParam)
 {
+  struct SketchPass pass;
   tableindex_t effect;
   char logStr[MAXLOGMSGLEN];
   char digit[MAXDIGITBIT];
   
   log_msg("Creating the cluster sketch...", LOG_NOTICE, pParam);
   pParam->pClusterSketch = (unsigned long *)
-  malloc(sizeof(unsigned long) * pParam->clusterSketchSize);
-  if (!pParam->pClusterSketch)
-  {
-    log_msg(MALLOC_ERR_6016, LOG_ERR, pParam);
-    exit(1);
-  }
+  table_alloc(sizeof(unsigned long) * pParam->clusterSketchSize, pParam);
   
-  if (!pParam->pWordFilter)
-  {
-    effect = create_cluster_candidate_sketch(pParam);
-  }
-  else
-  {
-    effect = create_cluster_candidate_sketch_with_wfilter(pParam);
-  }
+  /* The tables are only read in this pass, so all threads can build the
+   sketch, every thread counting into its own sketch. */
+  sketch_pass_run(&pass, pParam->pClusterSketch, pParam->clusterSketchSize,
+          pParam->pWordFilter ? cluster_sketch_line_with_wfilter : 
+          cluster_sketch_line, pParam);
+  effect = sketch_pass_merge(&pass, pParam->support);
   
   str_format_int_grouped(digit, effect);
   sprintf(logStr, "%s slots in the cluster sketch >= support threshold.",
@@ -84,31 +97,21 @@ void step_2_create_cluster_candidate_sketch(struct Parameters *pParam)
   log_msg(logStr, LOG_INFO, pParam);
 }
 
-/* For the sake of computing speed, four brother functions (
- create_cluster_candidates(), create_cluster_candidates_with_wfilter(),
- create_cluster_candidates_word_dep(), and 
- create_cluster_candidates_word_dep_with_filter()) which have similar 
- function but with a few differences to each other are contained in this 
- function in parallel. This design of course brings inconvenience for future
- maintenance, and it will be fixed with better solution in following updates. */
+/* The lines are read, tokenized and put into the cluster table in a pipeline
+ (see pipeline.c). The cluster table is only changed by the consumer stage. */
 void step_2_find_cluster_candidates(struct Parameters *pParam)
 {
+  struct CandidatePass pass;
   char logStr[MAXLOGMSGLEN];
   char digit[MAXDIGITBIT];
-  int i;
   
   log_msg("Finding cluster candidates...", LOG_NOTICE, pParam);
   if (!pParam->clusterTableSize)
   {
     pParam->clusterTableSize = 100 * pParam->freWordNum;
   }
-  pParam->ppClusterTable = (struct Elem **) malloc(sizeof(struct Elem *) *
-                           pParam->clusterTableSize);
-  if (!pParam->ppClusterTable)
-  {
-    log_msg(MALLOC_ERR_6017, LOG_ERR, pParam);
-    exit(1);
-  }
+  pParam->ppClusterTable = (struct Elem **) table_alloc(sizeof(struct Elem *) *
+                            pParam->clusterTableSize, pParam);
   
   /* For option '--wweight'. For the sake of computing speed, the matrix 
    building process is integrated into this step (find_cluster_candidates). */
@@ -117,45 +120,18 @@ void step_2_find_cluster_candidates(struct Parameters *pParam)
     pParam->wordDepMatrixBreadth = pParam->freWordNum + 1;
     
     pParam->wordDepMatrix = (unsigned long *)
-    malloc(sizeof(unsigned long) * pParam->wordDepMatrixBreadth *
-         pParam->wordDepMatrixBreadth);
-    if (!pParam->wordDepMatrix)
-    {
-      log_msg(MALLOC_ERR_6017, LOG_ERR, pParam);
-      exit(1);
-    }
-    
-    for (i = 0; i < pParam->wordDepMatrixBreadth *
-       pParam->wordDepMatrixBreadth; i++)
-    {
-      pParam->wordDepMatrix[i] = 0;
-    }
-    
-    if (!pParam->pWordFilter)
-    {
-      pParam->clusterCandiNum =
-      create_cluster_candidates_word_dep(pParam);
-    }
-    else
-    {
-      pParam->clusterCandiNum =
-      create_cluster_candidates_word_dep_with_filter(pParam);
-    }
-  }
-  else
-  {
-    if (!pParam->pWordFilter)
-    {
-      pParam->clusterCandiNum = create_cluster_candidates(pParam);
-    }
-    else
-    {
-      pParam->clusterCandiNum =
-      create_cluster_candidates_with_wfilter(pParam);
-    }
-    
+    table_alloc(sizeof(unsigned long) * pParam->wordDepMatrixBreadth *
+          pParam->wordDepMatrixBreadth, pParam);
   }
-    
+  
+  pass.clusterCount = 0;
+  pass.pParam = pParam;
+  
+  pipeline_run(pParam->pWordFilter ? candidate_tokenize_with_wfilter :
+         candidate_tokenize, candidate_consume, &pass, pParam);
+  
+  pParam->clusterCandiNum = pass.clusterCount;
+  
   str_format_int_grouped(digit, pParam->clusterCandiNum);
   sprintf(logStr, "%s cluster candidates were found.", digit);
   log_msg(logStr, LOG_INFO, pParam);
@@ -212,94 +188,57 @@ void debug_1_print_cluster_candidates(struct Parameters *pParam)
 }
 
 /* When making changes to this function, don't forget to also change its
- brother function create_cluster_candidate_sketch_with_wfilter(). 
+ brother function cluster_sketch_line_with_wfilter(). 
  For the sake of computing performance, sorry for this inconvenience. It will
  be fixed with better solution in the following updates. */
-static tableindex_t create_cluster_candidate_sketch(struct Parameters *pParam)
+static void cluster_sketch_line(struct SketchWorker *pWorker,
+        struct Parameters *pParam)
 {
-  FILE *pFile;
-  struct InputFile *pFilePtr;
-  tableindex_t j, hash, oversupport;
-  char logStr[MAXLOGMSGLEN];
-  char line[MAXLINELEN];
-  char words[MAXWORDS][MAXWORDLEN];
-  char key[MAXKEYLEN];
+  tableindex_t hash;
+  char (*words)[MAXWORDLEN];
+  char *key;
   int len, wordcount, last, i;
   struct Elem *pWord;
+  struct Elem *pFound[MAXWORDS];
   
-  for (j = 0; j < pParam->clusterSketchSize; j++)
-  {
-    pParam->pClusterSketch[j] = 0;
-  }
+  words = pWorker->pWords;
+  key = pWorker->key;
+  wordcount = find_words(pWorker->line, words, pWorker->pParser, pParam);
+  
+  last = 0;
+  *key = 0;
+  
+  lookup_elems(words, wordcount, pFound, &pWorker->cache, 
+         pParam->ppWordTable, pParam->wordTableSize, pParam->wordTableSeed);
   
-  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  for (i = 0; i < wordcount; i++)
   {
-    if (!(pFile = fopen(pFilePtr->pName, "r")))
+    pWord = pFound[i];
+    if (words[i][0] != 0 && pWord)
     {
-      sprintf(logStr, "Can't open input file %s", pFilePtr->pName);
-      log_msg(logStr, LOG_ERR, pParam);
-      continue;
-    }
-    
-    while (fgets(line, MAXLINELEN, pFile))
-    {
-      len = (int) strlen(line);
-      if (line[len - 1] == '\n')
-      {
-        line[len - 1] = 0;
-      }
-      
-      wordcount = find_words(line, words, pParam);
-      
-      last = 0;
-      *key = 0;
-      
-      for (i = 0; i < wordcount; i++)
-      {
-        pWord = find_elem(words[i], pParam->ppWordTable,
-                  pParam->wordTableSize, pParam->wordTableSeed);
-        if (words[i][0] != 0 && pWord)
-        {
-          strcat(key, words[i]);
-          len = (int) strlen(key);
-          key[len] = CLUSTERSEP;
-          key[len + 1] = 0;
-          //last records the location of the last constant. */
-          last = i + 1;
-        }
-      }
-      
-      if (!last)
-      {
-        /* !last means there is no frequent word in this line. */
-        continue;
-      }
-      
-      hash = str2hash(key, pParam->clusterSketchSize,
-              pParam->clusterSketchSeed);
-      pParam->pClusterSketch[hash]++;
+      strcat(key, words[i]);
+      len = (int) strlen(key);
+      key[len] = CLUSTERSEP;
+      key[len + 1] = 0;
+      //last records the location of the last constant. */
+      last = i + 1;
     }
-    
-    fclose(pFile);
   }
   
-  oversupport = 0;
-  for (j = 0; j < pParam->clusterSketchSize; j++)
+  if (!last)
   {
-    if (pParam->pClusterSketch[j] >= pParam->support)
-    {
-      oversupport++;
-    }
+    /* !last means there is no frequent word in this line. */
+    return;
   }
   
-  return oversupport;
+  hash = str2hash(key, pParam->clusterSketchSize, pParam->clusterSketchSeed);
+  pWorker->pSketch[hash]++;
 }
 
 /* This is a redundant function, which works similarly as function
- create_cluster_candidate_sketch(), but with consideration of '--wfilter'
- option. Since this function has a coding style with overlapping IFs, it could
- be read while comparing function create_cluster_candidate_sketch() to see the
- differences. */
+ cluster_sketch_line(), but with consideration of '--wfilter' option. Since
+ this function has a coding style with overlapping IFs, it could be read while
+ comparing function cluster_sketch_line() to see the differences. */
 
 /* This redundant function can be integrated into its original function.
  However, for the sake of performance and readability of the original function,
@@ -309,727 +248,358 @@ static tableindex_t create_cluster_candidate_sketch(struct Parameters *pParam)
  called. */
 
 /* When making changes to this function, don't forget to also change its
- brother function create_cluster_candidate_sketch(). 
+ brother function cluster_sketch_line(). 
  For the sake of computing performance, sorry for this inconvenience. It will
  be fixed with better solution in the following updates. */
-static tableindex_t create_cluster_candidate_sketch_with_wfilter(
-  struct Parameters *pParam)
+static void cluster_sketch_line_with_wfilter(struct SketchWorker *pWorker,
+        struct Parameters *pParam)
 {
-  FILE *pFile;
-  struct InputFile *pFilePtr;
-  tableindex_t j, hash, oversupport;
-  char logStr[MAXLOGMSGLEN];
-  char line[MAXLINELEN];
-  char words[MAXWORDS][MAXWORDLEN];
-  char key[MAXKEYLEN];
+  tableindex_t hash;
+  char (*words)[MAXWORDLEN];
+  char *key;
   int len, wordcount, last, i;
   struct Elem *pWord;
-  char newWord[MAXWORDLEN];
+  struct Elem *pFound[MAXWORDS];
+  char *pNewWord;
   
-  *newWord = 0;
+  words = pWorker->pWords;
+  key = pWorker->key;
+  wordcount = find_words(pWorker->line, words, pWorker->pParser, pParam);
   
-  for (j = 0; j < pParam->clusterSketchSize; j++)
-  {
-    pParam->pClusterSketch[j] = 0;
-  }
+  last = 0;
+  *key = 0;
   
-  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  lookup_elems(words, wordcount, pFound, &pWorker->cache, 
+         pParam->ppWordTable, pParam->wordTableSize, pParam->wordTableSeed);
+  
+  for (i = 0; i < wordcount; i++)
   {
-    if (!(pFile = fopen(pFilePtr->pName, "r")))
+    pWord = pFound[i];
+    if (words[i][0] != 0 && pWord)
     {
-      sprintf(logStr, "Can't open input file %s", pFilePtr->pName);
-      log_msg(logStr, LOG_ERR, pParam);
-      continue;
+      strcat(key, words[i]);
+      len = (int) strlen(key);
+      key[len] = CLUSTERSEP;
+      key[len + 1] = 0;
+      /* last records the location of the last constant. */
+      last = i + 1;
     }
-    
-    while (fgets(line, MAXLINELEN, pFile))
+    else if ((pNewWord = word_filter_search_replace(words[i],
+              pWorker->pParser, pParam)))
     {
-      len = (int) strlen(line);
-      if (line[len - 1] == '\n')
+      pWord = lookup_elem(pNewWord, pParam->ppWordTable,
+                pParam->wordTableSize, pParam->wordTableSeed);
+      if (words[i][0] != 0 && pWord)
       {
-        line[len - 1] = 0;
+        strcat(key, pNewWord);
+        len = (int) strlen(key);
+        key[len] = CLUSTERSEP;
+        key[len + 1] = 0;
+        last = i + 1;
       }
-      
-      wordcount = find_words(line, words, pParam);
-      
-      last = 0;
-      *key = 0;
-      
-      for (i = 0; i < wordcount; i++)
-      {
-        pWord = find_elem(words[i], pParam->ppWordTable,
-                  pParam->wordTableSize, pParam->wordTableSeed);
-        if (words[i][0] != 0 && pWord)
-        {
-          strcat(key, words[i]);
-          len = (int) strlen(key);
-          key[len] = CLUSTERSEP;
-          key[len + 1] = 0;
-          /* last records the location of the last constant. */
-          last = i + 1;
-        }
-        else if(is_word_filtered(words[i], pParam))
-        {
-          strcpy(newWord, word_search_replace(words[i], pParam));
-          pWord = find_elem(newWord, pParam->ppWordTable,
-                    pParam->wordTableSize,
-                    pParam->wordTableSeed);
-          if (words[i][0] != 0 && pWord)
-          {
-            strcat(key, newWord);
-            len = (int) strlen(key);
-            key[len] = CLUSTERSEP;
-            key[len + 1] = 0;
-            last = i + 1;
-          }
-        }
-      }
-      
-      if (!last)
-      {
-        /* !last means there is no frequent word in this line. */
-        continue;
-      }
-      
-      hash = str2hash(key, pParam->clusterSketchSize,
-              pParam->clusterSketchSeed);
-      pParam->pClusterSketch[hash]++;
     }
-    
-    fclose(pFile);
   }
   
-  oversupport = 0;
-  for (j = 0; j < pParam->clusterSketchSize; j++)
+  if (!last)
   {
-    if (pParam->pClusterSketch[j] >= pParam->support)
-    {
-      oversupport++;
-    }
+    /* !last means there is no frequent word in this line. */
+    return;
   }
   
-  return oversupport;
+  hash = str2hash(key, pParam->clusterSketchSize, pParam->clusterSketchSeed);
+  pWorker->pSketch[hash]++;
 }
 
-/* When making changes to this function, don't forget to also change all four
- brother functions: create_cluster_candidates(), 
- create_cluster_candidates_with_wfilter(),
- create_cluster_candidates_word_dep(), and 
- create_cluster_candidates_word_dep_with_filter().
+/* Look up the frequent words of one line, and pass the cluster candidate of
+ the line to candidate_consume(). The word tables are only read here, so
+ several tokenizers can run at the same time. */
+
+/* When making changes to this function, don't forget to also change its
+ brother function candidate_tokenize_with_wfilter(). 
  For the sake of computing performance, sorry for this inconvenience. It will
  be fixed with better solution in the following updates. */
-static wordnumber_t create_cluster_candidates_word_dep(struct Parameters 
-  *pParam)
+static void candidate_tokenize(char *line, struct PipelineWorker *pWorker,
+        struct Parameters *pParam)
 {
-  FILE *pFile;
-  struct InputFile *pFilePtr;
-  tableindex_t j, hash;
-  char logStr[MAXLOGMSGLEN];
-  char line[MAXLINELEN];
-  char words[MAXWORDS][MAXWORDLEN];
-  char key[MAXKEYLEN];
-  int wildcard[MAXWORDS + 1];
+  char (*words)[MAXWORDLEN];
+  char *key;
   int len, wordcount, i, constants, variables;
-  struct Elem *pWord, *pElem;
-  struct Elem *pStorage[MAXWORDS + 1];
-  wordnumber_t clusterCount;
-  
-  //wordDep
-  //wordnumber_t wordNumberStorage[MAXWORDS + 1];
-  wordnumber_t p, q;
+  struct Elem *pWord;
+  struct Elem *pFound[MAXWORDS];
   int distinctConstants;
   
+  words = pWorker->pWords;
+  key = pWorker->key;
+  wordcount = find_words(line, words, pWorker->pParser, pParam);
   
-  for (j = 0; j < pParam->clusterTableSize; j++)
-  {
-    pParam->ppClusterTable[j] = 0;
-  }
+  *key = 0;
+  constants = 0;
+  variables = 0;
   
-  for (p = 0; p < pParam->wordDepMatrixBreadth; p++)
-  {
-    for (q = 0; q < pParam->wordDepMatrixBreadth; q++)
-    {
-      pParam->wordDepMatrix[p * pParam->wordDepMatrixBreadth + q] = 0;
-    }
-  }
+  //wordDep
+  distinctConstants = 0;
   
+  lookup_elems(words, wordcount, pFound, &pWorker->cache, 
+         pParam->ppWordTable, pParam->wordTableSize, pParam->wordTableSeed);
   
-  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  for (i = 0; i < wordcount; i++)
   {
-    if (!(pFile = fopen(pFilePtr->pName, "r")))
-    {
-      sprintf(logStr, "Can't open input file %s", pFilePtr->pName);
-      log_msg(logStr, LOG_ERR, pParam);
-      continue;
-    }
-    
-    while (fgets(line, MAXLINELEN, pFile))
+    pWord = pFound[i];
+    if (words[i][0] != 0 && pWord)
     {
-      len = (int) strlen(line);
-      if (line[len - 1] == '\n')
-      {
-        line[len - 1] = 0;
-      }
-      
-      wordcount = find_words(line, words, pParam);
-      
-      *key = 0;
-      constants = 0;
+      strcat(key, words[i]);
+      len = (int) strlen(key);
+      key[len] = CLUSTERSEP;
+      key[len + 1] = 0;
+      
+      constants++;
+      pWorker->pStorage[constants] = pWord;
+      pWorker->wildcard[constants] = variables;
       variables = 0;
       
-      //wordDep
-      distinctConstants = 0;
-      
-      
-      for (i = 0; i < wordcount; i++)
+      if (pParam->wordWeightThreshold)
       {
-        pWord = find_elem(words[i], pParam->ppWordTable,
-                  pParam->wordTableSize, pParam->wordTableSeed);
-        if (words[i][0] != 0 && pWord)
+        //wordDep
+        distinctConstants++;
+        //findRepeated..
+        if (is_word_repeated(pWorker->wordNumStr, pWord->number,
+                   distinctConstants))
         {
-          strcat(key, words[i]);
-          len = (int) strlen(key);
-          key[len] = CLUSTERSEP;
-          key[len + 1] = 0;
-          
-          constants++;
-          pStorage[constants] = pWord;
-          wildcard[constants] = variables;
-          variables = 0;
-          
-          //wordDep
-          distinctConstants++;
-          //findRepeated..
-          if (is_word_repeated(pParam->wordNumStr, pWord->number,
-                     distinctConstants))
-          {
-            distinctConstants--;
-          }
-          else
-          {
-            pParam->wordNumStr[distinctConstants] = pWord->number;
-          }
+          distinctConstants--;
         }
         else
         {
-          variables++;
-        }
-      }
-      
-      //Deal with tail.
-      //wildcard[constants - 1 + 1] = variables;
-      wildcard[0] = variables;
-      
-      if (!constants)
-      {
-        continue;
-      }
-      
-      //wordDep
-      //update wordDep matrix
-      update_word_dep_matrix(pParam->wordNumStr, distinctConstants,
-                   pParam);
-      
-      if (pParam->clusterSketchSize)
-      {
-        hash = str2hash(key, pParam->clusterSketchSize,
-                pParam->clusterSketchSeed);
-        if (pParam->pClusterSketch[hash] < pParam->support)
-        {
-          continue;
+          pWorker->wordNumStr[distinctConstants] = pWord->number;
         }
       }
-      
-      //Put this cluster into clustertable.
-      pElem = add_elem(key, pParam->ppClusterTable,
-               pParam->clusterTableSize, pParam->clusterTableSeed,
-               pParam);
-      
-      if (pElem->count == 1)
-      {
-        clusterCount++;
-        create_cluster_instance(pElem, constants, wildcard, pStorage,
-                    pParam);
-      }
-      
-      adjust_cluster_instance(pElem, constants, wildcard, pParam);
-      
     }
-    
-    fclose(pFile);
+    else
+    {
+      variables++;
+    }
+  }
+  
+  //Deal with tail.
+  //wildcard[constants - 1 + 1] = variables;
+  pWorker->wildcard[0] = variables;
+  
+  if (!constants)
+  {
+    return;
   }
   
-  return clusterCount;
+  append_candidate_record(pWorker, constants, distinctConstants, pParam);
 }
 
 /* This is a redundant function, which works similarly as function
- create_cluster_candidates_word_dep(), but with consideration of '--wfilter'
- option. Since this function has a coding style with overlapping IF-s, it could
- be read while comparing function create_cluster_candidates_word_dep() to see
- the differences. */
-
-/* This redundant function can be integrated into its original function.
- However, for the sake of performance and readability of the original function,
- this function is separated as an alone function. */
+ candidate_tokenize(), but with consideration of '--wfilter' option. Since
+ this function has a coding style with overlapping IF-s, it could be read while
+ comparing function candidate_tokenize() to see the differences. */
 
 /* In program, if '--wfilter' option is not used, this function will not be
  called. */
 
-/* When making changes to this function, don't forget to also change all four
- brother functions: create_cluster_candidates(), 
- create_cluster_candidates_with_wfilter(),
- create_cluster_candidates_word_dep(), and 
- create_cluster_candidates_word_dep_with_filter().
+/* When making changes to this function, don't forget to also change its
+ brother function candidate_tokenize(). 
  For the sake of computing performance, sorry for this inconvenience. It will
  be fixed with better solution in the following updates. */
-static wordnumber_t create_cluster_candidates_word_dep_with_filter(
-  struct Parameters *pParam)
+static void candidate_tokenize_with_wfilter(char *line,
+        struct PipelineWorker *pWorker, struct Parameters *pParam)
 {
-  FILE *pFile;
-  struct InputFile *pFilePtr;
-  tableindex_t j, hash;
-  char logStr[MAXLOGMSGLEN];
-  char line[MAXLINELEN];
-  char words[MAXWORDS][MAXWORDLEN];
-  char key[MAXKEYLEN];
-  int wildcard[MAXWORDS + 1];
+  char (*words)[MAXWORDLEN];
+  char *key;
   int len, wordcount, i, constants, variables;
-  struct Elem *pWord, *pElem;
-  struct Elem *pStorage[MAXWORDS + 1];
-  wordnumber_t clusterCount;
-  char newWord[MAXWORDLEN];
-  
-  //wordDep
-  //wordnumber_t wordNumberStorage[MAXWORDS + 1];
-  wordnumber_t p, q;
+  struct Elem *pWord;
+  struct Elem *pFound[MAXWORDS];
+  char *pNewWord;
   int distinctConstants;
   
-  *newWord = 0;
-  for (j = 0; j < pParam->clusterTableSize; j++)
-  {
-    pParam->ppClusterTable[j] = 0;
-  }
+  words = pWorker->pWords;
+  key = pWorker->key;
+  wordcount = find_words(line, words, pWorker->pParser, pParam);
   
-  for (p = 0; p < pParam->wordDepMatrixBreadth; p++)
-  {
-    for (q = 0; q < pParam->wordDepMatrixBreadth; q++)
-    {
-      pParam->wordDepMatrix[p * pParam->wordDepMatrixBreadth + q] = 0;
-    }
-  }
+  *key = 0;
+  constants = 0;
+  variables = 0;
   
+  //wordDep
+  distinctConstants = 0;
+  
+  lookup_elems(words, wordcount, pFound, &pWorker->cache, 
+         pParam->ppWordTable, pParam->wordTableSize, pParam->wordTableSeed);
   
-  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  for (i = 0; i < wordcount; i++)
   {
-    if (!(pFile = fopen(pFilePtr->pName, "r")))
+    pWord = pFound[i];
+    if (words[i][0] != 0 && pWord)
     {
-      sprintf(logStr, "Can't open inputfile %s", pFilePtr->pName);
-      log_msg(logStr, LOG_ERR, pParam);
-      continue;
-    }
-    
-    while (fgets(line, MAXLINELEN, pFile))
-    {
-      len = (int) strlen(line);
-      if (line[len - 1] == '\n')
-      {
-        line[len - 1] = 0;
-      }
-      
-      wordcount = find_words(line, words, pParam);
-      
-      *key = 0;
-      constants = 0;
+      strcat(key, words[i]);
+      len = (int) strlen(key);
+      key[len] = CLUSTERSEP;
+      key[len + 1] = 0;
+      
+      constants++;
+      pWorker->pStorage[constants] = pWord;
+      pWorker->wildcard[constants] = variables;
       variables = 0;
       
-      //wordDep
-      distinctConstants = 0;
-      
-      
-      for (i = 0; i < wordcount; i++)
+      if (pParam->wordWeightThreshold)
       {
-        pWord = find_elem(words[i], pParam->ppWordTable,
-                  pParam->wordTableSize, pParam->wordTableSeed);
-        if (words[i][0] != 0 && pWord)
+        //wordDep
+        distinctConstants++;
+        //findRepeated..
+        if (is_word_repeated(pWorker->wordNumStr, pWord->number,
+                   distinctConstants))
+        {
+          distinctConstants--;
+        }
+        else
+        {
+          pWorker->wordNumStr[distinctConstants] = pWord->number;
+        }
+      }
+    }
+    else if ((pNewWord = word_filter_search_replace(words[i],
+              pWorker->pParser, pParam)))
+    {
+      pWord = lookup_elem(pNewWord, pParam->ppWordTable,
+                pParam->wordTableSize, pParam->wordTableSeed);
+      if (words[i][0] != 0 && pWord)
+      {
+        strcat(key, pNewWord);
+        len = (int) strlen(key);
+        key[len] = CLUSTERSEP;
+        key[len + 1] = 0;
+        
+        constants++;
+        pWorker->pStorage[constants] = pWord;
+        pWorker->wildcard[constants] = variables;
+        variables = 0;
+        
+        if (pParam->wordWeightThreshold)
         {
-          strcat(key, words[i]);
-          len = (int) strlen(key);
-          key[len] = CLUSTERSEP;
-          key[len + 1] = 0;
-          
-          constants++;
-          pStorage[constants] = pWord;
-          wildcard[constants] = variables;
-          variables = 0;
-          
           //wordDep
           distinctConstants++;
           //findRepeated..
-          if (is_word_repeated(pParam->wordNumStr, pWord->number,
+          if (is_word_repeated(pWorker->wordNumStr, pWord->number,
                      distinctConstants))
           {
             distinctConstants--;
           }
           else
           {
-            pParam->wordNumStr[distinctConstants] = pWord->number;
-          }
-          
-        }
-        else if (is_word_filtered(words[i], pParam))
-        {
-          strcpy(newWord, word_search_replace(words[i], pParam));
-          pWord = find_elem(newWord, pParam->ppWordTable,
-                    pParam->wordTableSize,
-                    pParam->wordTableSeed);
-          if (words[i][0] != 0 && pWord)
-          {
-            strcat(key, newWord);
-            len = (int) strlen(key);
-            key[len] = CLUSTERSEP;
-            key[len + 1] = 0;
-            
-            constants++;
-            pStorage[constants] = pWord;
-            wildcard[constants] = variables;
-            variables = 0;
-            
-            //wordDep
-            distinctConstants++;
-            //findRepeated..
-            if (is_word_repeated(pParam->wordNumStr,
-                       pWord->number,
-                       distinctConstants))
-            {
-              distinctConstants--;
-            }
-            else
-            {
-              pParam->wordNumStr[distinctConstants] =
-              pWord->number;
-            }
-          }
-          else
-          {
-            variables++;
+            pWorker->wordNumStr[distinctConstants] = pWord->number;
           }
         }
-        else
-        {
-          variables++;
-        }
       }
-      
-      //Deal with tail.
-      //wildcard[constants - 1 + 1] = variables;
-      wildcard[0] = variables;
-      
-      if (!constants)
+      else
       {
-        continue;
+        variables++;
       }
-      
-      //wordDep
-      //update wordDep matrix
-      update_word_dep_matrix(pParam->wordNumStr, distinctConstants,
-                   pParam);
-      
-      if (pParam->clusterSketchSize)
-      {
-        hash = str2hash(key, pParam->clusterSketchSize, 
-                pParam->clusterSketchSeed);
-        if (pParam->pClusterSketch[hash] < pParam->support)
-        {
-          continue;
-        }
-      }
-      
-      //Put this cluster into clustertable.
-      pElem = add_elem(key, pParam->ppClusterTable,
-               pParam->clusterTableSize, pParam->clusterTableSeed,
-               pParam);
-      
-      if (pElem->count == 1)
-      {
-        clusterCount++;
-        create_cluster_instance(pElem, constants, wildcard, pStorage,
-                    pParam);
-      }
-      
-      adjust_cluster_instance(pElem, constants, wildcard, pParam);
-      
     }
-    
-    fclose(pFile);
+    else
+    {
+      variables++;
+    }
+  }
+  
+  //Deal with tail.
+  //wildcard[constants - 1 + 1] = variables;
+  pWorker->wildcard[0] = variables;
+  
+  if (!constants)
+  {
+    return;
   }
   
-  return clusterCount;
+  append_candidate_record(pWorker, constants, distinctConstants, pParam);
 }
 
-/* When making changes to this function, don't forget to also change all four
- brother functions: create_cluster_candidates(), 
- create_cluster_candidates_with_wfilter(),
- create_cluster_candidates_word_dep(), and 
- create_cluster_candidates_word_dep_with_filter().
- For the sake of computing performance, sorry for this inconvenience. It will
- be fixed with better solution in the following updates. */
-static wordnumber_t create_cluster_candidates(struct Parameters *pParam)
+/* The record of a line is the CandidateRecord header, followed by
+ pStorage[0...constants], wordNumStr[0...distinctConstants],
+ wildcard[0...constants] and the key. A line whose cluster can't be frequent
+ according to the cluster sketch is still passed on for '--wweight'. */
+static void append_candidate_record(struct PipelineWorker *pWorker,
+        int constants, int distinctConstants, struct Parameters *pParam)
 {
-  FILE *pFile;
-  struct InputFile *pFilePtr;
-  tableindex_t j, hash;
-  char logStr[MAXLOGMSGLEN];
-  char line[MAXLINELEN];
-  char words[MAXWORDS][MAXWORDLEN];
-  char key[MAXKEYLEN];
-  int wildcard[MAXWORDS + 1];
-  int len, wordcount, i, constants, variables;
-  struct Elem *pWord, *pElem;
-  struct Elem *pStorage[MAXWORDS + 1];
-  wordnumber_t clusterCount;
+  struct CandidateRecord record;
+  tableindex_t hash;
   
-  for (j = 0; j < pParam->clusterTableSize; j++)
-  {
-    pParam->ppClusterTable[j] = 0;
-  }
+  record.constants = constants;
+  record.distinctConstants = distinctConstants;
+  record.bCluster = 1;
   
-  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  if (pParam->clusterSketchSize)
   {
-    if (!(pFile = fopen(pFilePtr->pName, "r")))
+    hash = str2hash(pWorker->key, pParam->clusterSketchSize,
+            pParam->clusterSketchSeed);
+    if (pParam->pClusterSketch[hash] < pParam->support)
     {
-      sprintf(logStr, "Can't open input file %s", pFilePtr->pName);
-      log_msg(logStr, LOG_ERR, pParam);
-      continue;
+      record.bCluster = 0;
     }
-    
-    while (fgets(line, MAXLINELEN, pFile))
-    {
-      len = (int) strlen(line);
-      if (line[len - 1] == '\n')
-      {
-        line[len - 1] = 0;
-      }
-      
-      wordcount = find_words(line, words, pParam);
-      
-      *key = 0;
-      constants = 0;
-      variables = 0;
-      
-      for (i = 0; i < wordcount; i++)
-      {
-        pWord = find_elem(words[i], pParam->ppWordTable,
-                  pParam->wordTableSize, pParam->wordTableSeed);
-        if (words[i][0] != 0 && pWord)
-        {
-          strcat(key, words[i]);
-          len = (int) strlen(key);
-          key[len] = CLUSTERSEP;
-          key[len + 1] = 0;
-          
-          constants++;
-          pStorage[constants] = pWord;
-          wildcard[constants] = variables;
-          variables = 0;
-        }
-        else
-        {
-          variables++;
-        }
-      }
-      
-      //Deal with tail.
-      //wildcard[constants - 1 + 1] = variables;
-      wildcard[0] = variables;
-      
-      if (!constants)
-      {
-        continue;
-      }
-      
-      if (pParam->clusterSketchSize)
-      {
-        hash = str2hash(key, pParam->clusterSketchSize,
-                pParam->clusterSketchSeed);
-        if (pParam->pClusterSketch[hash] < pParam->support)
-        {
-          continue;
-        }
-      }
-      
-      //Put this cluster into clustertable.
-      pElem = add_elem(key, pParam->ppClusterTable,
-               pParam->clusterTableSize, pParam->clusterTableSeed,
-               pParam);
-      
-      if (pElem->count == 1)
-      {
-        clusterCount++;
-        create_cluster_instance(pElem, constants, wildcard, pStorage,
-                    pParam);
-      }
-      
-      adjust_cluster_instance(pElem, constants, wildcard, pParam);
-      
-    }
-    
-    fclose(pFile);
   }
   
-  return clusterCount;
+  if (!record.bCluster && !pParam->wordWeightThreshold)
+  {
+    return;
+  }
+  
+  pipeline_append(pWorker, &record, sizeof(struct CandidateRecord));
+  pipeline_append(pWorker, pWorker->pStorage, 
+          sizeof(struct Elem *) * (constants + 1));
+  pipeline_append(pWorker, pWorker->wordNumStr,
+          sizeof(wordnumber_t) * (distinctConstants + 1));
+  pipeline_append(pWorker, pWorker->wildcard, sizeof(int) * (constants + 1));
+  pipeline_append(pWorker, pWorker->key, strlen(pWorker->key) + 1);
 }
 
-/* This is a redundant function, which works similarly as function
- create_cluster_candidates(), but with consideration of '--wfilter'
- option. Since this function has a coding style with overlapping IF-s, it could
- be read while comparing function create_cluster_candidates() to see the
- differences. */
-
-/* This redundant function can be integrated into its original function.
- However, for the sake of performance and readability of the original function,
- this function is separated as an alone function. */
-
-/* In program, if '--wfilter' option is not used, this function will not be
- called. */
-
-/* When making changes to this function, don't forget to also change all four
- brother functions: create_cluster_candidates(), 
- create_cluster_candidates_with_wfilter(),
- create_cluster_candidates_word_dep(), and 
- create_cluster_candidates_word_dep_with_filter().
- For the sake of computing performance, sorry for this inconvenience. It will
- be fixed with better solution in the following updates. */
-static wordnumber_t create_cluster_candidates_with_wfilter(struct Parameters 
-  *pParam)
+/* Put the cluster candidate of one line into the cluster table. The records
+ come in the order of the input, so the candidates are created in the same
+ order as by a single thread. */
+static void candidate_consume(char *pRecord, size_t len, void *pArg)
 {
-  FILE *pFile;
-  struct InputFile *pFilePtr;
-  tableindex_t j, hash;
-  char logStr[MAXLOGMSGLEN];
-  char line[MAXLINELEN];
-  char words[MAXWORDS][MAXWORDLEN];
-  char key[MAXKEYLEN];
-  int wildcard[MAXWORDS + 1];
-  int len, wordcount, i, constants, variables;
-  struct Elem *pWord, *pElem;
-  struct Elem *pStorage[MAXWORDS + 1];
-  wordnumber_t clusterCount;
-  char newWord[MAXWORDLEN];
+  struct CandidatePass *pPass;
+  struct Parameters *pParam;
+  struct CandidateRecord *pRecordHead;
+  struct Elem **pStorage;
+  struct Elem *pElem;
+  wordnumber_t *pWordNum;
+  int *wildcard;
+  char *key;
+  
+  pPass = (struct CandidatePass *) pArg;
+  pParam = pPass->pParam;
+  
+  pRecordHead = (struct CandidateRecord *) pRecord;
+  pStorage = pRecordHead->pStorage;
+  pWordNum = (wordnumber_t *) (pStorage + pRecordHead->constants + 1);
+  wildcard = (int *) (pWordNum + pRecordHead->distinctConstants + 1);
+  key = (char *) (wildcard + pRecordHead->constants + 1);
   
-  *newWord = 0;
+  if (pParam->wordWeightThreshold)
+  {
+    //wordDep
+    //update wordDep matrix
+    update_word_dep_matrix(pWordNum, pRecordHead->distinctConstants, pParam);
+  }
   
-  for (j = 0; j < pParam->clusterTableSize; j++)
+  if (!pRecordHead->bCluster)
   {
-    pParam->ppClusterTable[j] = 0;
+    return;
   }
   
-  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  //Put this cluster into clustertable.
+  pElem = add_elem(key, pParam->ppClusterTable, pParam->clusterTableSize,
+           pParam->clusterTableSeed, pParam);
+  
+  if (pElem->count == 1)
   {
-    if (!(pFile = fopen(pFilePtr->pName, "r")))
-    {
-      sprintf(logStr, "Can't open input file %s", pFilePtr->pName);
-      log_msg(logStr, LOG_ERR, pParam);
-      continue;
-    }
-    
-    while (fgets(line, MAXLINELEN, pFile))
-    {
-      len = (int) strlen(line);
-      if (line[len - 1] == '\n')
-      {
-        line[len - 1] = 0;
-      }
-      
-      wordcount = find_words(line, words, pParam);
-      
-      *key = 0;
-      constants = 0;
-      variables = 0;
-      
-      for (i = 0; i < wordcount; i++)
-      {
-        pWord = find_elem(words[i], pParam->ppWordTable,
-                  pParam->wordTableSize, pParam->wordTableSeed);
-        if (words[i][0] != 0 && pWord)
-        {
-          strcat(key, words[i]);
-          len = (int) strlen(key);
-          key[len] = CLUSTERSEP;
-          key[len + 1] = 0;
-          
-          constants++;
-          pStorage[constants] = pWord;
-          wildcard[constants] = variables;
-          variables = 0;
-        }
-        else if(is_word_filtered(words[i], pParam))
-        {
-          strcpy(newWord, word_search_replace(words[i], pParam));
-          pWord = find_elem(newWord, pParam->ppWordTable,
-                    pParam->wordTableSize,
-                    pParam->wordTableSeed);
-          if (words[i][0] != 0 && pWord)
-          {
-            strcat(key, newWord);
-            len = (int) strlen(key);
-            key[len] = CLUSTERSEP;
-            key[len + 1] = 0;
-            
-            constants++;
-            pStorage[constants] = pWord;
-            wildcard[constants] = variables;
-            variables = 0;
-          }
-          else
-          {
-            variables++;
-          }
-        }
-        else
-        {
-          variables++;
-        }
-      }
-      
-      //Deal with tail.
-      //wildcard[constants - 1 + 1] = variables;
-      wildcard[0] = variables;
-      
-      if (!constants)
-      {
-        continue;
-      }
-      
-      if (pParam->clusterSketchSize)
-      {
-        hash = str2hash(key, pParam->clusterSketchSize,
-                pParam->clusterSketchSeed);
-        if (pParam->pClusterSketch[hash] < pParam->support)
-        {
-          continue;
-        }
-      }
-      
-      //Put this cluster into clustertable.
-      pElem = add_elem(key, pParam->ppClusterTable,
-               pParam->clusterTableSize, pParam->clusterTableSeed,
-               pParam);
-      
-      if (pElem->count == 1)
-      {
-        clusterCount++;
-        create_cluster_instance(pElem, constants, wildcard, pStorage,
-                    pParam);
-      }
-      
-      adjust_cluster_instance(pElem, constants, wildcard, pParam);
-      
-    }
-    
-    fclose(pFile);
+    pPass->clusterCount++;
+    create_cluster_instance(pElem, pRecordHead->constants, wildcard, pStorage,
+                pParam);
   }
   
-  return clusterCount;
+  adjust_cluster_instance(pElem, pRecordHead->constants, wildcard, pParam);
 }
 
 static struct Cluster *create_cluster_instance(struct Elem* pClusterElem,
@@ -1057,7 +627,7 @@ static struct Cluster *create_cluster_instance(struct Elem* pClusterElem,
   }
   
   ptr->fullWildcard = (int *) malloc(2 * (constants + 1) * sizeof(int));
-
+  
   if (!ptr->fullWildcard)
   {
     log_msg(MALLOC_ERR_6009, LOG_ERR, pParam);
@@ -1079,7 +649,7 @@ static struct Cluster *create_cluster_instance(struct Elem* pClusterElem,
   ptr->constants = constants;
   ptr->count = 0;
   ptr->bIsJoined = 0;
-  ptr->pLastNode = 0;
+  ptr->lastNode = 0;
   
   //Build bidirectional link.
   pClusterElem->pCluster = ptr;
@@ -0,0 +1,591 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * File:   cluster_writer.c
+ *
+ * Content: Buffered writer of the detected clusters, in the formats of
+ * '--outputformat' option.
+ *
+ * Created on October 19, 2026, 9:10 PM
+ */
+
+#include "common_header.h"
+#include "cluster_writer.h"
+
+#include <string.h>    /* for strlen(), memcpy(), etc. */
+#include <errno.h>     /* for errno */
+#include <sys/uio.h>   /* for writev() */
+
+#include "output.h"
+
+/* Clusters are formatted into one big buffer, which is written out only when
+ it is full. A piece of data that does not fit is written together with the
+ buffer by one writev(), without being copied.
+ 
+ Formats:
+ 
+ text: the classic output, e.g.
+   Interface *{1,1} (up|down)
+   Support : 1,234
+ 
+ jsonl: one JSON object per cluster, e.g.
+   {"id":1,"support":1234,"pattern":"Interface *{1,1} (up|down) ",
+    "constants":[{"wildcard":[0,0],"words":["Interface"]},
+    {"wildcard":[1,1],"token":true,"words":["up","down"]}],"tail":[0,0]}
+ "wildcard" is the range of wildcards before the constant, "tail" is the range
+ after the last one. A token lists all of its words. A byte of a word that is
+ not part of a valid UTF-8 sequence is written as \u0080...\u00ff, as if it
+ were Latin-1 (e.g. the byte 0xe9 as \u00e9), so every line is valid JSON.
+ 
+ tsv: a header line, then one line per cluster with id, support, the number of
+ constants and the pattern. Tab, newline, carriage return and backslash in
+ the pattern are escaped as \t, \n, \r and \\.
+ 
+ binary: the magic "LCCB" and the format version (u32), then one record per
+ cluster: id (u64), support (u64), constants (u32), then for each constant
+ the wildcard range before it (2 x i32), then the tail wildcard range
+ (2 x i32), then for each constant a token flag (u8), the number of its words
+ (u32), and each word as its length (u32) and its bytes. All integers are
+ little-endian.
+ 
+ Cluster IDs are the positions of the clusters in the output, from 1. */
+
+#define ESCAPE_NONE 0
+#define ESCAPE_JSON 1
+#define ESCAPE_TSV 2
+
+static void writer_flush(struct ClusterWriter *pWriter, const char *pData,
+        size_t len);
+static void writer_append(struct ClusterWriter *pWriter, const char *pData,
+        size_t len);
+static char *writer_reserve(struct ClusterWriter *pWriter, size_t len);
+static void append_ulong(struct ClusterWriter *pWriter, unsigned long value,
+        int bGrouped);
+static void append_int(struct ClusterWriter *pWriter, int value);
+static void append_escaped(struct ClusterWriter *pWriter, const char *pStr,
+        int escape);
+static int utf8_sequence_length(const unsigned char *p);
+static void append_u32(struct ClusterWriter *pWriter, unsigned long value);
+static void append_u64(struct ClusterWriter *pWriter,
+        unsigned long long value);
+static void write_pattern(struct ClusterWriter *pWriter, int constants,
+        int *fullWildcard, struct Elem **ppWord, struct TokenSet *pTokens,
+        int escape);
+static void write_json_words(struct ClusterWriter *pWriter,
+        struct Elem **ppWord, int num);
+
+void writer_open(struct ClusterWriter *pWriter, int fd,
+        struct Parameters *pParam)
+{
+  pWriter->size = CLUSTER_WRITER_BUFFER;
+  pWriter->pBuffer = (char *) malloc(pWriter->size);
+  if (!pWriter->pBuffer)
+  {
+    log_msg(MALLOC_ERR_6031, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  pWriter->used = 0;
+  pWriter->clusterId = 0;
+  pWriter->fd = fd;
+  pWriter->format = pParam->outputFormat;
+  pWriter->bDetailedTokenFlag = pParam->bDetailedTokenFlag;
+  pWriter->pParam = pParam;
+  
+  /* Whatever is still in stdio's buffer goes first. */
+  fflush(stdout);
+  
+  switch (pWriter->format)
+  {
+    case OUTPUT_FORMAT_TEXT:
+      writer_append(pWriter, "\n", 1);
+      break;
+    case OUTPUT_FORMAT_TSV:
+      writer_append(pWriter, "id\tsupport\tconstants\tpattern\n", 29);
+      break;
+    case OUTPUT_FORMAT_BINARY:
+      writer_append(pWriter, "LCCB", 4);
+      append_u32(pWriter, CLUSTER_BINARY_VERSION);
+      break;
+    default:
+      break;
+  }
+}
+
+/* Writes one cluster. ppWord[1...constants] are the constants. If pTokens is
+ not 0, a constant i with pTokens[i].num != 0 is a token('--wweight' option),
+ whose words are printed from the latest joined one to the earliest. */
+void writer_write_cluster(struct ClusterWriter *pWriter, int constants,
+        int *fullWildcard, struct Elem **ppWord, struct TokenSet *pTokens,
+        support_t count)
+{
+  int i, j, bIsToken;
+  size_t len;
+  
+  pWriter->clusterId++;
+  
+  switch (pWriter->format)
+  {
+    case OUTPUT_FORMAT_TEXT:
+      write_pattern(pWriter, constants, fullWildcard, ppWord, pTokens,
+              ESCAPE_NONE);
+      writer_append(pWriter, "\nSupport : ", 11);
+      append_ulong(pWriter, count, 1);
+      writer_append(pWriter, "\n\n", 2);
+      break;
+    case OUTPUT_FORMAT_JSONL:
+      writer_append(pWriter, "{\"id\":", 6);
+      append_ulong(pWriter, pWriter->clusterId, 0);
+      writer_append(pWriter, ",\"support\":", 11);
+      append_ulong(pWriter, count, 0);
+      writer_append(pWriter, ",\"pattern\":\"", 12);
+      write_pattern(pWriter, constants, fullWildcard, ppWord, pTokens,
+              ESCAPE_JSON);
+      writer_append(pWriter, "\",\"constants\":[", 15);
+      for (i = 1; i <= constants; i++)
+      {
+        if (i > 1)
+        {
+          writer_append(pWriter, ",", 1);
+        }
+        writer_append(pWriter, "{\"wildcard\":[", 13);
+        append_int(pWriter, fullWildcard[i * 2]);
+        writer_append(pWriter, ",", 1);
+        append_int(pWriter, fullWildcard[i * 2 + 1]);
+        writer_append(pWriter, "],", 2);
+        if (pTokens && pTokens[i].num)
+        {
+          writer_append(pWriter, "\"token\":true,", 13);
+          write_json_words(pWriter, pTokens[i].ppWord, pTokens[i].num);
+        }
+        else
+        {
+          write_json_words(pWriter, ppWord + i, 1);
+        }
+        writer_append(pWriter, "}", 1);
+      }
+      writer_append(pWriter, "],\"tail\":[", 10);
+      append_int(pWriter, fullWildcard[0]);
+      writer_append(pWriter, ",", 1);
+      append_int(pWriter, fullWildcard[1]);
+      writer_append(pWriter, "]}\n", 3);
+      break;
+    case OUTPUT_FORMAT_TSV:
+      append_ulong(pWriter, pWriter->clusterId, 0);
+      writer_append(pWriter, "\t", 1);
+      append_ulong(pWriter, count, 0);
+      writer_append(pWriter, "\t", 1);
+      append_ulong(pWriter, (unsigned long) constants, 0);
+      writer_append(pWriter, "\t", 1);
+      write_pattern(pWriter, constants, fullWildcard, ppWord, pTokens,
+              ESCAPE_TSV);
+      writer_append(pWriter, "\n", 1);
+      break;
+    case OUTPUT_FORMAT_BINARY:
+      append_u64(pWriter, pWriter->clusterId);
+      append_u64(pWriter, count);
+      append_u32(pWriter, (unsigned long) constants);
+      for (i = 1; i <= constants; i++)
+      {
+        append_u32(pWriter, (unsigned long) fullWildcard[i * 2]);
+        append_u32(pWriter, (unsigned long) fullWildcard[i * 2 + 1]);
+      }
+      append_u32(pWriter, (unsigned long) fullWildcard[0]);
+      append_u32(pWriter, (unsigned long) fullWildcard[1]);
+      for (i = 1; i <= constants; i++)
+      {
+        bIsToken = pTokens && pTokens[i].num;
+        *writer_reserve(pWriter, 1) = (char) bIsToken;
+        pWriter->used++;
+        if (bIsToken)
+        {
+          append_u32(pWriter, (unsigned long) pTokens[i].num);
+          for (j = pTokens[i].num - 1; j >= 0; j--)
+          {
+            len = strlen(pTokens[i].ppWord[j]->pKey);
+            append_u32(pWriter, (unsigned long) len);
+            writer_append(pWriter, pTokens[i].ppWord[j]->pKey, len);
+          }
+        }
+        else
+        {
+          append_u32(pWriter, 1);
+          len = strlen(ppWord[i]->pKey);
+          append_u32(pWriter, (unsigned long) len);
+          writer_append(pWriter, ppWord[i]->pKey, len);
+        }
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void writer_close(struct ClusterWriter *pWriter)
+{
+  if (pWriter->format == OUTPUT_FORMAT_TEXT)
+  {
+    writer_append(pWriter, "\n", 1);
+  }
+  
+  writer_flush(pWriter, 0, 0);
+  
+  free((void *) pWriter->pBuffer);
+  pWriter->pBuffer = 0;
+}
+
+/* Writes the buffer, followed by len bytes of pData, with as few system calls
+ as possible, and empties the buffer. */
+static void writer_flush(struct ClusterWriter *pWriter, const char *pData,
+        size_t len)
+{
+  char logStr[MAXLOGMSGLEN];
+  struct iovec iov[2];
+  int first, num;
+  ssize_t written;
+  
+  iov[0].iov_base = pWriter->pBuffer;
+  iov[0].iov_len = pWriter->used;
+  iov[1].iov_base = (void *) pData;
+  iov[1].iov_len = len;
+  
+  first = 0;
+  num = len ? 2 : 1;
+  
+  while (first < num)
+  {
+    if (iov[first].iov_len == 0)
+    {
+      first++;
+      continue;
+    }
+    
+    written = writev(pWriter->fd, iov + first, num - first);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      sprintf(logStr, "Can't write clusters: %s", strerror(errno));
+      log_msg(logStr, LOG_ERR, pWriter->pParam);
+      exit(1);
+    }
+    
+    /* Skip what was written, which may end in the middle of a vector. */
+    while (first < num && (size_t) written >= iov[first].iov_len)
+    {
+      written -= iov[first].iov_len;
+      first++;
+    }
+    if (first < num)
+    {
+      iov[first].iov_base = (char *) iov[first].iov_base + written;
+      iov[first].iov_len -= written;
+    }
+  }
+  
+  pWriter->used = 0;
+}
+
+static void writer_append(struct ClusterWriter *pWriter, const char *pData,
+        size_t len)
+{
+  if (pWriter->used + len <= pWriter->size)
+  {
+    memcpy(pWriter->pBuffer + pWriter->used, pData, len);
+    pWriter->used += len;
+  }
+  else
+  {
+    writer_flush(pWriter, pData, len);
+  }
+}
+
+/* Makes room for len bytes (at most a few dozen) at the end of the buffer,
+ and returns where they start. The caller advances pWriter->used. */
+static char *writer_reserve(struct ClusterWriter *pWriter, size_t len)
+{
+  if (pWriter->used + len > pWriter->size)
+  {
+    writer_flush(pWriter, 0, 0);
+  }
+  
+  return pWriter->pBuffer + pWriter->used;
+}
+
+/* Appends the decimal value, with a comma between every 3 digits if
+ bGrouped (same as str_format_int_grouped()). */
+static void append_ulong(struct ClusterWriter *pWriter, unsigned long value,
+        int bGrouped)
+{
+  char digit[MAXDIGITBIT];
+  char *p;
+  int n;
+  
+  p = digit + MAXDIGITBIT;
+  n = 0;
+  
+  do
+  {
+    if (bGrouped && n && n % 3 == 0)
+    {
+      *--p = ',';
+    }
+    *--p = (char) ('0' + value % 10);
+    value /= 10;
+    n++;
+  }
+  while (value);
+  
+  writer_append(pWriter, p, (size_t) (digit + MAXDIGITBIT - p));
+}
+
+static void append_int(struct ClusterWriter *pWriter, int value)
+{
+  if (value < 0)
+  {
+    writer_append(pWriter, "-", 1);
+    append_ulong(pWriter, (unsigned long) -(long) value, 0);
+  }
+  else
+  {
+    append_ulong(pWriter, (unsigned long) value, 0);
+  }
+}
+
+/* Appends the string, escaped for a JSON string or a TSV field. Runs of
+ characters that need no escaping are appended at once. In a JSON string, a
+ byte that is not part of a valid UTF-8 sequence is escaped as \u00XX. */
+static void append_escaped(struct ClusterWriter *pWriter, const char *pStr,
+        int escape)
+{
+  const char *pRun;
+  char seq[8];
+  unsigned char c;
+  int len;
+  
+  if (escape == ESCAPE_NONE)
+  {
+    writer_append(pWriter, pStr, strlen(pStr));
+    return;
+  }
+  
+  for (pRun = pStr; (c = (unsigned char) *pStr); pStr++)
+  {
+    if (c >= 0x80 && escape == ESCAPE_JSON)
+    {
+      if ((len = utf8_sequence_length((const unsigned char *) pStr)))
+      {
+        pStr += len - 1;
+        continue;
+      }
+    }
+    else if (c >= 0x20 && c != '\\' && (c != '"' || escape != ESCAPE_JSON))
+    {
+      continue;
+    }
+    
+    writer_append(pWriter, pRun, (size_t) (pStr - pRun));
+    pRun = pStr + 1;
+    
+    switch (c)
+    {
+      case '\\':
+        writer_append(pWriter, "\\\\", 2);
+        break;
+      case '"':
+        writer_append(pWriter, "\\\"", 2);
+        break;
+      case '\t':
+        writer_append(pWriter, "\\t", 2);
+        break;
+      case '\n':
+        writer_append(pWriter, "\\n", 2);
+        break;
+      case '\r':
+        writer_append(pWriter, "\\r", 2);
+        break;
+      default:
+        if (escape == ESCAPE_JSON)
+        {
+          sprintf(seq, "\\u%04x", c);
+          writer_append(pWriter, seq, 6);
+        }
+        else
+        {
+          writer_append(pWriter, (const char *) &c, 1);
+        }
+        break;
+    }
+  }
+  
+  writer_append(pWriter, pRun, (size_t) (pStr - pRun));
+}
+
+/* Returns the length of the valid UTF-8 sequence at p, whose first byte is
+ 0x80 or more, or 0 if it is not valid (a stray continuation byte, a
+ truncated or overlong sequence, a surrogate or a code point above
+ U+10FFFF). */
+static int utf8_sequence_length(const unsigned char *p)
+{
+  int len, i;
+  
+  if (p[0] >= 0xc2 && p[0] <= 0xdf)
+  {
+    len = 2;
+  }
+  else if (p[0] >= 0xe0 && p[0] <= 0xef)
+  {
+    len = 3;
+    if ((p[0] == 0xe0 && p[1] < 0xa0) || (p[0] == 0xed && p[1] >= 0xa0))
+    {
+      return 0;
+    }
+  }
+  else if (p[0] >= 0xf0 && p[0] <= 0xf4)
+  {
+    len = 4;
+    if ((p[0] == 0xf0 && p[1] < 0x90) || (p[0] == 0xf4 && p[1] >= 0x90))
+    {
+      return 0;
+    }
+  }
+  else
+  {
+    return 0;
+  }
+  
+  /* The terminating '\0' is not a continuation byte, so the string is never
+   read past its end. */
+  for (i = 1; i < len; i++)
+  {
+    if ((p[i] & 0xc0) != 0x80)
+    {
+      return 0;
+    }
+  }
+  
+  return len;
+}
+
+static void append_u32(struct ClusterWriter *pWriter, unsigned long value)
+{
+  unsigned char *p;
+  int i;
+  
+  p = (unsigned char *) writer_reserve(pWriter, 4);
+  for (i = 0; i < 4; i++)
+  {
+    p[i] = (unsigned char) (value >> (i * 8));
+  }
+  pWriter->used += 4;
+}
+
+static void append_u64(struct ClusterWriter *pWriter,
+        unsigned long long value)
+{
+  unsigned char *p;
+  int i;
+  
+  p = (unsigned char *) writer_reserve(pWriter, 8);
+  for (i = 0; i < 8; i++)
+  {
+    p[i] = (unsigned char) (value >> (i * 8));
+  }
+  pWriter->used += 8;
+}
+
+/* The cluster's pattern, as in the text output. */
+static void write_pattern(struct ClusterWriter *pWriter, int constants,
+        int *fullWildcard, struct Elem **ppWord, struct TokenSet *pTokens,
+        int escape)
+{
+  struct TokenSet *pTokenSet;
+  int i, j;
+  
+  for (i = 1; i <= constants; i++)
+  {
+    if (fullWildcard[i * 2 + 1])
+    {
+      writer_append(pWriter, "*{", 2);
+      append_int(pWriter, fullWildcard[i * 2]);
+      writer_append(pWriter, ",", 1);
+      append_int(pWriter, fullWildcard[i * 2 + 1]);
+      writer_append(pWriter, "} ", 2);
+    }
+    
+    pTokenSet = pTokens ? pTokens + i : 0;
+    
+    if (pTokenSet && pTokenSet->num)
+    {
+      if (pWriter->bDetailedTokenFlag == 0 && pTokenSet->num == 1)
+      {
+        /* This solution will not mark a token, if it is the only word.
+         */
+        append_escaped(pWriter, pTokenSet->ppWord[0]->pKey, escape);
+        writer_append(pWriter, " ", 1);
+      }
+      else
+      {
+        /* A token with more than one word, or every token if
+         '--detailtoken' option is given, is marked with (). */
+        writer_append(pWriter, "(", 1);
+        for (j = pTokenSet->num - 1; j >= 0; j--)
+        {
+          append_escaped(pWriter, pTokenSet->ppWord[j]->pKey, escape);
+          if (j)
+          {
+            writer_append(pWriter, "|", 1);
+          }
+        }
+        writer_append(pWriter, ") ", 2);
+      }
+    }
+    else
+    {
+      append_escaped(pWriter, ppWord[i]->pKey, escape);
+      writer_append(pWriter, " ", 1);
+    }
+  }
+  
+  if (fullWildcard[1])
+  {
+    writer_append(pWriter, "*{", 2);
+    append_int(pWriter, fullWildcard[0]);
+    writer_append(pWriter, ",", 1);
+    append_int(pWriter, fullWildcard[1]);
+    writer_append(pWriter, "}", 1);
+  }
+}
+
+/* "words":[...], with the words from ppWord[num - 1] to ppWord[0]. */
+static void write_json_words(struct ClusterWriter *pWriter,
+        struct Elem **ppWord, int num)
+{
+  int j;
+  
+  writer_append(pWriter, "\"words\":[", 9);
+  for (j = num - 1; j >= 0; j--)
+  {
+    writer_append(pWriter, "\"", 1);
+    append_escaped(pWriter, ppWord[j]->pKey, ESCAPE_JSON);
+    writer_append(pWriter, j ? "\"," : "\"", j ? 2 : 1);
+  }
+  writer_append(pWriter, "]", 1);
+}
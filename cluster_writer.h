@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * File:   cluster_writer.h
+ *
+ * Content: Declarations of global functions in cluster_writer.c .
+ *
+ * Created on October 19, 2026, 9:10 PM
+ */
+
+#ifndef CLUSTER_WRITER_H
+#define CLUSTER_WRITER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void writer_open(struct ClusterWriter *pWriter, int fd,
+        struct Parameters *pParam);
+void writer_write_cluster(struct ClusterWriter *pWriter, int constants,
+        int *fullWildcard, struct Elem **ppWord, struct TokenSet *pTokens,
+        support_t count);
+void writer_close(struct ClusterWriter *pWriter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CLUSTER_WRITER_H */
+
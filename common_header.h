@@ -32,6 +32,13 @@
 extern "C" {
 #endif
 
+/* Expose POSIX and GNU interfaces (e.g. pthread_*(), clock_gettime() and
+ ctime_r()) while compiling with -std=c99. It must precede any system header,
+ which is why every source file includes common_header.h first. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>    /* for malloc(), atoi/f() and rand() */
 
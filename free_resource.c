@@ -26,9 +26,13 @@
 #include "common_header.h"
 #include "free_resource.h"
 
-#include <regex.h>     /* for regcomp() and regexec() */
 #include <syslog.h>    /* for syslog() */
 
+#include "regex_backend.h"
+#include "line_processing.h"
+#include "table_alloc.h"
+#include "thread_pool.h"
+
 static void free_inputfiles(struct Parameters *pParam);
 static void free_delim(struct Parameters *pParam);
 static void free_filter(struct Parameters *pParam);
@@ -51,75 +55,6 @@ void free_syslog_facility(struct Parameters *pParam)
   free((void *) pParam->pSyslogFacility);
 }
 
-//This function can cause segment 11 error when trie is large. Thus it is not 
-//used. For more details, see the comments of function 
-//step_2_aggregate_supports();
-//void free_trie_nodes(struct TrieNode *pNode, struct Parameters *pParam)
-//{
-//  struct TrieNode *pNext, *pParent;
-//  
-//  if (pNode == 0)
-//  {
-//    return;
-//  }
-//  
-//  /*
-//   if (pParam->pPrefixRoot == 0)
-//   {
-//   return;
-//   }
-//   */
-//  
-//  //ptr = pNode;
-//  
-//  //debug purpose
-//  //char *tmp = "null11";
-//  //debug purpose...
-//  
-//  while (pNode)
-//  {
-//    free_trie_nodes(pNode->pChild, pParam);
-//    
-//    if (pParam->pPrefixRoot == 0)
-//    {
-//      return;
-//    }
-//    
-//    if (pNode != pParam->pPrefixRoot)
-//    {
-//      pNode->pParent->pChild = pNode->pNext;
-//    }
-//    
-//    pNext = pNode->pNext;
-//    pParent = pNode->pParent;
-//    
-//    //debug purpose
-//    //if (pNode->pWord) {
-//    //  log_msg(pNode->pWord->pKey, LOG_INFO, pParam);
-//    
-//    //}
-//    //else
-//    //{
-//    //  log_msg(tmp, LOG_INFO, pParam);
-//    //}
-//    //debug purpose...
-//    
-//    if (pNode == pParam->pPrefixRoot)
-//    {
-//      pParam->pPrefixRoot = 0;
-//    }
-//    
-//    free((void *) pNode);
-//    pNode = pNext;
-//    if (!pNode)
-//    {
-//      pNode =pParent;
-//      //pParent->pChild = 0;
-//    }
-//  }
-//  
-//}
-
 void free_and_clean_step_0(struct Parameters *pParam)
 {
   free_inputfiles(pParam);
@@ -131,6 +66,8 @@ void free_and_clean_step_0(struct Parameters *pParam)
   free_wfilter(pParam);
   free_wsearch(pParam);
   free_wreplace(pParam);
+  line_parser_free(&pParam->lineParser);
+  thread_pool_free(pParam);
   if (pParam->bSyslogFlag == 1)
   {
     closelog();
@@ -148,9 +85,16 @@ void free_and_clean_step_2(struct Parameters *pParam)
   free_cluster_table(pParam);
   free_cluster_sketch(pParam);
   free_cluster_instances(pParam);
+  free((void *) pParam->pTrie);
+  free((void *) pParam->candidateIndex.ppCandidates);
+  free((void *) pParam->candidateIndex.pPostingStart);
+  free((void *) pParam->candidateIndex.pPostings);
+  free((void *) pParam->candidateIndex.pScratch);
   if (pParam->wordWeightThreshold)
   {
-    free((void *) pParam->wordDepMatrix);
+    table_free((void *) pParam->wordDepMatrix, sizeof(unsigned long) *
+           pParam->wordDepMatrixBreadth * pParam->wordDepMatrixBreadth, 
+           pParam);
   }
 }
 
@@ -179,7 +123,7 @@ static void free_inputfiles(struct Parameters *pParam)
 
 static void free_delim(struct Parameters *pParam)
 {
-  regfree(&pParam->delim_regex);
+  regex_free(&pParam->delim_regex);
   if (pParam->pDelim)
   {
     free((void *) pParam->pDelim);
@@ -190,7 +134,7 @@ static void free_filter(struct Parameters *pParam)
 {
   if (pParam->pFilter)
   {
-    regfree(&pParam->filter_regex);
+    regex_free(&pParam->filter_regex);
     free((void *) pParam->pFilter);
   }
   
@@ -206,9 +150,12 @@ static void free_template(struct Parameters *pParam)
   {
     pNext = ptr->pNext;
     free((void *) ptr->pStr);
+    free((void *) ptr->pName);
     free((void *) ptr);
     ptr = pNext;
   }
+  
+  free((void *) pParam->pTemplateInstr);
 }
 
 static void free_outlier(struct Parameters *pParam)
@@ -217,13 +164,18 @@ static void free_outlier(struct Parameters *pParam)
   {
     free((void *) pParam->pOutlier);
   }
+  
+  if (pParam->pOutlierCompress)
+  {
+    free((void *) pParam->pOutlierCompress);
+  }
 }
 
 static void free_wfilter(struct Parameters *pParam)
 {
   if (pParam->pWordFilter)
   {
-    regfree(&pParam->wfilter_regex);
+    regex_free(&pParam->wfilter_regex);
     free((void *) pParam->pWordFilter);
   }
 }
@@ -232,7 +184,7 @@ static void free_wsearch(struct Parameters *pParam)
 {
   if (pParam->pWordSearch)
   {
-    regfree(&pParam->wsearch_regex);
+    regex_free(&pParam->wsearch_regex);
     free((void *) pParam->pWordSearch);
   }
 }
@@ -271,14 +223,16 @@ static void free_word_table(struct Parameters *pParam)
     
   }
   
-  free((void *) pParam->ppWordTable);
+  table_free((void *) pParam->ppWordTable, 
+         sizeof(struct Elem *) * pParam->wordTableSize, pParam);
 }
 
 static void free_word_sketch(struct Parameters *pParam)
 {
   if (pParam->pWordSketch)
   {
-    free((void *) pParam->pWordSketch);
+    table_free((void *) pParam->pWordSketch, 
+           sizeof(unsigned long) * pParam->wordSketchSize, pParam);
   }
   
 }
@@ -308,7 +262,8 @@ static void free_cluster_table(struct Parameters *pParam)
       }
     }
     
-    free((void *) pParam->ppClusterTable);
+    table_free((void *) pParam->ppClusterTable, 
+           sizeof(struct Elem *) * pParam->clusterTableSize, pParam);
   }
   
 }
@@ -317,7 +272,8 @@ static void free_cluster_sketch(struct Parameters *pParam)
 {
   if (pParam->pClusterSketch)
   {
-    free((void *) pParam->pClusterSketch);
+    table_free((void *) pParam->pClusterSketch, 
+           sizeof(unsigned long) * pParam->clusterSketchSize, pParam);
   }
 }
 
@@ -353,29 +309,21 @@ static void free_cluster_with_token_instances(struct Parameters *pParam)
     {
       pNext = ptr->pNext;
       free_token(ptr);
-      free((void *) ptr->ppToken);
-      free((void *) ptr->ppWord);
-      free((void *) ptr->fullWildcard);
       free((void *) ptr);
       ptr = pNext;
     }
   }
+  
+  free((void *) pParam->ppJoinedTable);
+  pParam->ppJoinedTable = 0;
 }
 
 static void free_token(struct ClusterWithToken *pClusterWithToken)
 {
   int i;
-  struct Token *ptr, *pNext;
   
   for (i = 1; i <= pClusterWithToken->constants; i++)
   {
-    ptr = pClusterWithToken->ppToken[i];
-    
-    while (ptr)
-    {
-      pNext = ptr->pNext;
-      free((void *) ptr);
-      ptr = pNext;
-    }
+    free((void *) pClusterWithToken->pTokens[i].ppWord);
   }
 }
\ No newline at end of file
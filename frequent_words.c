@@ -33,36 +33,59 @@
 #include "utility.h"
 #include "word_filter_search_replace.h"
 #include "hash_table_processing.h"
+#include "sketch.h"
+#include "pipeline.h"
+#include "table_alloc.h"
 
-static tableindex_t create_word_sketch(struct Parameters *pParam);
-static tableindex_t create_word_sketch_with_wfilter(struct Parameters *pParam);
-static wordnumber_t create_vocabulary(struct Parameters *pParam);
-static wordnumber_t create_vocabulary_with_wfilter(struct Parameters *pParam);
+/* State of the vocabulary pass. number is the number of words inserted, cache
+ is the hot word cache of the consumer. */
+struct VocabularyPass {
+  wordnumber_t number;
+  struct WordCache cache;
+  struct Parameters *pParam;
+};
+
+static void word_sketch_line(struct SketchWorker *pWorker,
+        struct Parameters *pParam);
+static void word_sketch_line_with_wfilter(struct SketchWorker *pWorker,
+        struct Parameters *pParam);
+static void vocabulary_tokenize(char *line, struct PipelineWorker *pWorker,
+        struct Parameters *pParam);
+static void vocabulary_tokenize_with_wfilter(char *line,
+        struct PipelineWorker *pWorker, struct Parameters *pParam);
+static void vocabulary_consume(char *pRecord, size_t len, void *pArg);
+static void vocabulary_consume_shared(char *pRecord, size_t len, void *pArg);
 
 void step_1_create_word_sketch(struct Parameters *pParam)
 {
+  struct SketchPass pass;
   tableindex_t effect;
+  support_t linecount;
   char logStr[MAXLOGMSGLEN];
   char digit[MAXDIGITBIT];
   
   log_msg("Creating the word sketch...", LOG_NOTICE, pParam);
-  pParam->pWordSketch = (unsigned long *) malloc(sizeof(unsigned long) *
-                           pParam->wordSketchSize);
-  if (!pParam->pWordSketch)
-  {
-    log_msg(MALLOC_ERR_6014, LOG_ERR, pParam);
-    exit(1);
-  }
+  pParam->pWordSketch = (unsigned long *) table_alloc(sizeof(unsigned long) *
+                            pParam->wordSketchSize, pParam);
+  
+  /* The word sketch is built by all threads, every thread counting into
+   its own sketch. The sketches are added up after the support threshold is
+   known. */
+  linecount = sketch_pass_run(&pass, pParam->pWordSketch,
+                pParam->wordSketchSize, pParam->pWordFilter ? 
+                word_sketch_line_with_wfilter : word_sketch_line, pParam);
   
-  if (!pParam->pWordFilter)
+  if (!pParam->linecount)
   {
-    effect = create_word_sketch(pParam);
+    pParam->linecount = linecount;
   }
-  else
+  
+  if (!pParam->support)
   {
-    effect = create_word_sketch_with_wfilter(pParam);
+    pParam->support = linecount * pParam->pctSupport / 100;
   }
   
+  effect = sketch_pass_merge(&pass, pParam->support);
   
   str_format_int_grouped(digit, effect);
   sprintf(logStr, "%s slots in the word sketch >= support threshhold", digit);
@@ -71,28 +94,60 @@ void step_1_create_word_sketch(struct Parameters *pParam)
 
 wordnumber_t step_1_create_vocabulary(struct Parameters *pParam)
 {
+  struct VocabularyPass pass;
+  struct Elem *ptr;
   wordnumber_t totalWordNum;
+  tableindex_t j;
+  support_t linecount;
   char logStr[MAXLOGMSGLEN];
   char digit[MAXDIGITBIT];
   
   log_msg("Creating vocabulary...", LOG_NOTICE, pParam);
-  pParam->ppWordTable = (struct Elem **) malloc(sizeof(struct Elem *) *
-                          pParam->wordTableSize);
-  if (!pParam->ppWordTable)
+  pParam->ppWordTable = (struct Elem **) table_alloc(sizeof(struct Elem *) *
+                           pParam->wordTableSize, pParam);
+  
+  pass.number = 0;
+  pass.pParam = pParam;
+  word_cache_init(&pass.cache);
+  
+  if (pParam->vocabTable == VOCAB_TABLE_SHARED && pParam->threadNum > 1)
   {
-    log_msg(MALLOC_ERR_6015, LOG_ERR, pParam);
-    exit(1);
+    /* The words are numbered after the pass, since the order in which they
+     are inserted is not defined. */
+    linecount = pipeline_run_shared(pParam->pWordFilter ? 
+                    vocabulary_tokenize_with_wfilter : 
+                    vocabulary_tokenize, vocabulary_consume_shared,
+                    &pass, pParam);
+    
+    for (j = 0; j < pParam->wordTableSize; j++)
+    {
+      for (ptr = pParam->ppWordTable[j]; ptr; ptr = ptr->pNext)
+      {
+        ptr->number = ++pass.number;
+      }
+    }
+  }
+  else
+  {
+    linecount = pipeline_run(pParam->pWordFilter ? 
+                 vocabulary_tokenize_with_wfilter : vocabulary_tokenize,
+                 vocabulary_consume, &pass, pParam);
   }
   
-  if (!pParam->pWordFilter)
+  word_cache_flush(&pass.cache, pParam);
+  
+  if (!pParam->linecount)
   {
-    totalWordNum = create_vocabulary(pParam);
+    pParam->linecount = linecount;
   }
-  else
+  
+  if (!pParam->support)
   {
-    totalWordNum = create_vocabulary_with_wfilter(pParam);
+    pParam->support = linecount * pParam->pctSupport / 100;
   }
   
+  totalWordNum = pass.number;
+  
   str_format_int_grouped(digit, totalWordNum);
   sprintf(logStr, "%s words were inserted into the vocabulary.", digit);
   log_msg(logStr, LOG_INFO, pParam);
@@ -266,92 +321,37 @@ void debug_1_print_frequent_words(struct Parameters *pParam)
 }
 
 /* When making changes to this function, don't forget to also change its
- brother function create_word_sketch_with_wfilter(). 
+ brother function word_sketch_line_with_wfilter(). 
  For the sake of computing performance, sorry for this inconvenience. It will
  be fixed with better solution in the following updates. */
-static tableindex_t create_word_sketch(struct Parameters *pParam)
+static void word_sketch_line(struct SketchWorker *pWorker,
+        struct Parameters *pParam)
 {
-  FILE *pFile;
-  tableindex_t hash, j, oversupport;
-  int len, i, wordcount;
-  support_t linecount;
-  struct InputFile *pFilePtr;
-  char logStr[MAXLOGMSGLEN];
-  char line[MAXLINELEN];
-  char words[MAXWORDS][MAXWORDLEN];
-  
-  linecount = 0;
+  tableindex_t hash;
+  int i, wordcount;
+  char (*words)[MAXWORDLEN];
   
-  for (j = 0; j < pParam->wordSketchSize; j++)
-  {
-    pParam->pWordSketch[j] = 0;
-  }
+  words = pWorker->pWords;
+  wordcount = find_words(pWorker->line, words, pWorker->pParser, pParam);
   
-  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  for (i = 0; i < wordcount; i++)
   {
-    if (!(pFile = fopen(pFilePtr->pName, "r")))
+    if (words[i][0] == 0)
     {
-      sprintf(logStr, "Can't open input file %s", pFilePtr->pName);
-      log_msg(logStr, LOG_ERR, pParam);
       continue;
     }
     
-    while (fgets(line, MAXLINELEN, pFile))
-    {
-      len = (int) strlen(line);
-      if (line[len - 1] == '\n')
-      {
-        line[len - 1] = 0;
-      }
-      
-      wordcount = find_words(line, words, pParam);
-      
-      for (i = 0; i < wordcount; i++)
-      {
-        if (words[i][0] == 0)
-        {
-          continue;
-        }
-        
-        hash = str2hash(words[i], pParam->wordSketchSize,
-                pParam->wordSketchSeed);
-        
-        pParam->pWordSketch[hash]++;
-      }
-      
-      linecount++;
-    }
+    hash = str2hash(words[i], pParam->wordSketchSize,
+            pParam->wordSketchSeed);
     
-    fclose(pFile);
+    pWorker->pSketch[hash]++;
   }
-  
-  if (!pParam->linecount)
-  {
-    pParam->linecount = linecount;
-  }
-  
-  if (!pParam->support)
-  {
-    pParam->support = linecount * pParam->pctSupport / 100;
-  }
-  
-  oversupport = 0;
-  
-  for (j = 0; j < pParam->wordSketchSize; j++)
-  {
-    if (pParam->pWordSketch[j] >= pParam->support)
-    {
-      oversupport++;
-    }
-  }
-  
-  return oversupport;
 }
 
 /* This is a redundant function, which works similarly as function
- create_word_sketch(), but with consideration of '--wfilter' option. Since
+ word_sketch_line(), but with consideration of '--wfilter' option. Since
  this function has a coding style with overlapping IF-s, it could be read while
- comparing function create_word_sketch() to see the differences. */
+ comparing function word_sketch_line() to see the differences. */
 
 /* This redundant function can be integrated into its original function.
  However, for the sake of performance and readability of the original function,
@@ -361,419 +361,226 @@ static tableindex_t create_word_sketch(struct Parameters *pParam)
  called. */
 
 /* When making changes to this function, don't forget to also change its
- brother function create_word_sketch(). 
+ brother function word_sketch_line(). 
  For the sake of computing performance, sorry for this inconvenience. It will
  be fixed with better solution in the following updates. */
-static tableindex_t create_word_sketch_with_wfilter(struct Parameters *pParam)
+static void word_sketch_line_with_wfilter(struct SketchWorker *pWorker,
+        struct Parameters *pParam)
 {
-  FILE *pFile;
-  tableindex_t hash, j, oversupport;
-  int len, i, wordcount;
-  support_t linecount;
-  struct InputFile *pFilePtr;
-  char logStr[MAXLOGMSGLEN];
-  char line[MAXLINELEN];
-  char words[MAXWORDS][MAXWORDLEN];
-  
+  tableindex_t hash;
+  int i, wordcount;
+  char (*words)[MAXWORDLEN];
+  char *pNewWord;
   
-  linecount = 0;
-  
-  for (j = 0; j < pParam->wordSketchSize; j++)
-  {
-    pParam->pWordSketch[j] = 0;
-  }
+  words = pWorker->pWords;
+  wordcount = find_words(pWorker->line, words, pWorker->pParser, pParam);
   
-  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  for (i = 0; i < wordcount; i++)
   {
-    if (!(pFile = fopen(pFilePtr->pName, "r")))
+    if (words[i][0] == 0)
     {
-      sprintf(logStr, "Can't open input file %s", pFilePtr->pName);
-      log_msg(logStr, LOG_ERR, pParam);
       continue;
     }
     
-    while (fgets(line, MAXLINELEN, pFile))
-    {
-      len = (int) strlen(line);
-      if (line[len - 1] == '\n')
-      {
-        line[len - 1] = 0;
-      }
-      
-      wordcount = find_words(line, words, pParam);
-      
-      for (i = 0; i < wordcount; i++)
-      {
-        if (words[i][0] == 0)
-        {
-          continue;
-        }
-        
-        hash = str2hash(words[i], pParam->wordSketchSize,
-                pParam->wordSketchSeed);
-        
-        pParam->pWordSketch[hash]++;
-        
-        if (is_word_filtered(words[i], pParam))
-        {
-          hash = str2hash(word_search_replace(words[i], pParam),
-                  pParam->wordSketchSize,
-                  pParam->wordSketchSeed);
-          
-          pParam->pWordSketch[hash]++;
-        }
-      }
-      
-      linecount++;
-    }
+    hash = str2hash(words[i], pParam->wordSketchSize,
+            pParam->wordSketchSeed);
     
-    fclose(pFile);
-  }
-  
-  if (!pParam->linecount)
-  {
-    pParam->linecount = linecount;
-  }
-  
-  if (!pParam->support)
-  {
-    pParam->support = linecount * pParam->pctSupport / 100;
-  }
-  
-  oversupport = 0;
-  
-  for (j = 0; j < pParam->wordSketchSize; j++)
-  {
-    if (pParam->pWordSketch[j] >= pParam->support)
+    pWorker->pSketch[hash]++;
+    
+    if ((pNewWord = word_filter_search_replace(words[i], pWorker->pParser,
+                         pParam)))
     {
-      oversupport++;
+      hash = str2hash(pNewWord, pParam->wordSketchSize,
+              pParam->wordSketchSeed);
+      
+      pWorker->pSketch[hash]++;
     }
   }
-  
-  return oversupport;
 }
 
 /* When making changes to this function, don't forget to also change its
- brother function create_vocabulary_with_wfilter(). 
+ brother function vocabulary_tokenize_with_wfilter(). 
  For the sake of computing performance, sorry for this inconvenience. It will
- be fixed with better solution in the following updates. */
-static wordnumber_t create_vocabulary(struct Parameters *pParam)
+ be fixed with better solution in the following updates. 
+ The record of the line is the words to be inserted into the vocabulary, in
+ the order of the line, each terminated by '\0'. */
+static void vocabulary_tokenize(char *line, struct PipelineWorker *pWorker,
+        struct Parameters *pParam)
 {
-  wordnumber_t number = 0;
-  tableindex_t j, hash;
-  struct InputFile *pFilePtr;
-  FILE *pFile;
-  char logStr[MAXLOGMSGLEN];
-  char line[MAXLINELEN];
-  char words[MAXWORDS][MAXWORDLEN];
-  int i, len, wordcount, distinctWords;
-  struct Elem *word;
-  support_t linecount;
-  
+  tableindex_t hash;
+  char (*words)[MAXWORDLEN];
+  int i, wordcount;
   
-  for (j = 0; j < pParam->wordTableSize; j++)
-  {
-    pParam->ppWordTable[j] = 0;
-  }
+  words = pWorker->pWords;
+  wordcount = find_words(line, words, pWorker->pParser, pParam);
   
-  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  for (i = 0; i < wordcount; i++)
   {
-    if (!(pFile = fopen(pFilePtr->pName, "r")))
+    if (words[i][0] == 0)
     {
-      sprintf(logStr, "Can't open input file %s", pFilePtr->pName);
-      log_msg(logStr, LOG_ERR, pParam);
       continue;
     }
     
-    while (fgets(line, MAXLINELEN, pFile))
+    /* The technique to save memory space. */
+    if (pParam->wordSketchSize)
     {
-      len = (int) strlen(line);
-      if (line[len - 1] == '\n')
+      hash = str2hash(words[i], pParam->wordSketchSize, 
+              pParam->wordSketchSeed);
+      if (pParam->pWordSketch[hash] < pParam->support)
       {
-        line[len - 1] = 0;
+        continue;
       }
-      
-      wordcount = find_words(line, words, pParam);
-      
-      distinctWords = 0;
-      
-      for (i = 0; i < wordcount; i++)
-      {
-        if (words[i][0] == 0)
-        {
-          continue;
-        }
-        
-        /* The technique to save memory space. */
-        if (pParam->wordSketchSize)
-        {
-          hash = str2hash(words[i], pParam->wordSketchSize, 
-                  pParam->wordSketchSeed);
-          if (pParam->pWordSketch[hash] < pParam->support)
-          {
-            continue;
-          }
-        }
-        
-        word = add_elem(words[i], pParam->ppWordTable, pParam->wordTableSize, 
-                pParam->wordTableSeed, pParam);
-        distinctWords++;
-        
-        if (word->count == 1)
-        {
-          number++;
-          word->number = number;
-        }
-        
-        /* If word is repeated..its support will not increment more than
-         once in one log line. */
-        if (is_word_repeated(pParam->wordNumStr, word->number,
-                   distinctWords))
-        {
-          distinctWords--;
-          word->count--;
-        }
-        else
-        {
-          pParam->wordNumStr[distinctWords] = word->number;
-        }
-        
-      }
-      
-      linecount++;
     }
     
-    fclose(pFile);
-    
-  }
-  
-  if (!pParam->linecount)
-  {
-    pParam->linecount = linecount;
-  }
-  
-  if (!pParam->support)
-  {
-    pParam->support = linecount * pParam->pctSupport / 100;
+    pipeline_append(pWorker, words[i], strlen(words[i]) + 1);
   }
-  
-  return number;
 }
 
 /* This is a redundant function, which works similarly as function
- create_vocabulary(), but with consideration of '--wfilter' option. Since
+ vocabulary_tokenize(), but with consideration of '--wfilter' option. Since
  this function has a coding style with overlapping IF-s, it could be read while
- comparing function create_vocabulary() to see the differences. */
-
-/* This redundant function can be integrated into its original function.
- However, for the sake of performance and readability of the original function,
- this function is separated as an alone function. */
+ comparing function vocabulary_tokenize() to see the differences. */
 
 /* In program, if '--wfilter' option is not used, this function will not be
  called. */
 
 /* When making changes to this function, don't forget to also change its
- brother function create_vocabulary(). 
+ brother function vocabulary_tokenize(). 
  For the sake of computing performance, sorry for this inconvenience. It will
  be fixed with better solution in the following updates. */
-static wordnumber_t create_vocabulary_with_wfilter(struct Parameters *pParam)
+static void vocabulary_tokenize_with_wfilter(char *line,
+        struct PipelineWorker *pWorker, struct Parameters *pParam)
 {
-  wordnumber_t number = 0;
-  tableindex_t j, hash;
-  struct InputFile *pFilePtr;
-  FILE *pFile;
-  char logStr[MAXLOGMSGLEN];
-  char line[MAXLINELEN];   /*10240*/
-  char words[MAXWORDS][MAXWORDLEN];   /*512 10248*/
-  int i, len, wordcount, distinctWords;
-  struct Elem *word;
-  support_t linecount;
-  char newWord[MAXWORDLEN];
-  
-  *newWord = 0;
+  tableindex_t hash;
+  char (*words)[MAXWORDLEN];
+  int i, wordcount;
+  char *pNewWord;
   
-  for (j = 0; j < pParam->wordTableSize; j++)
-  {
-    pParam->ppWordTable[j] = 0;
-  }
+  words = pWorker->pWords;
+  wordcount = find_words(line, words, pWorker->pParser, pParam);
   
-  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  for (i = 0; i < wordcount; i++)
   {
-    if (!(pFile = fopen(pFilePtr->pName, "r")))
+    if (words[i][0] == 0)
     {
-      sprintf(logStr, "Can't open input file %s", pFilePtr->pName);
-      log_msg(logStr, LOG_ERR, pParam);
       continue;
     }
     
-    while (fgets(line, MAXLINELEN, pFile))
+    if (pParam->wordSketchSize)
     {
-      len = (int) strlen(line);
-      if (line[len - 1] == '\n')
+      hash = str2hash(words[i], pParam->wordSketchSize,
+              pParam->wordSketchSeed);
+      
+      if (pParam->pWordSketch[hash] >= pParam->support)
       {
-        line[len - 1] = 0;
+        pipeline_append(pWorker, words[i], strlen(words[i]) + 1);
       }
       
-      wordcount = find_words(line, words, pParam);
-      
-      distinctWords = 0;
-      
-      for (i = 0; i < wordcount; i++)
+      if ((pNewWord = word_filter_search_replace(words[i],
+                pWorker->pParser, pParam)))
       {
-        if (words[i][0] == 0)
-        {
-          continue;
-        }
+        hash = str2hash(pNewWord, pParam->wordSketchSize,
+                pParam->wordSketchSeed);
         
-        if (pParam->wordSketchSize)
+        if (pParam->pWordSketch[hash] >= pParam->support)
         {
-          hash = str2hash(words[i], pParam->wordSketchSize,
-                  pParam->wordSketchSeed);
-          
-          if (pParam->pWordSketch[hash] >= pParam->support)
-          {
-            word = add_elem(words[i], pParam->ppWordTable,
-                    pParam->wordTableSize,
-                    pParam->wordTableSeed,
-                    pParam);
-            
-            distinctWords++;
-            
-            if (word->count == 1)
-            {
-              number++;
-              word->number = number;
-            }
-            
-            /* If word is repeated..its support will not increment
-             more than once in one log line. */
-            if (is_word_repeated(pParam->wordNumStr, word->number,
-                       distinctWords))
-            {
-              distinctWords--;
-              word->count--;
-            }
-            else
-            {
-              pParam->wordNumStr[distinctWords] = word->number;
-            }
-            
-          }
-          
-          if (is_word_filtered(words[i], pParam))
-          {
-            strcpy(newWord, word_search_replace(words[i], pParam));
-            hash = str2hash(newWord, pParam->wordSketchSize,
-                    pParam->wordSketchSeed);
-            
-            if (pParam->pWordSketch[hash] >= pParam->support)
-            {
-              word = add_elem(newWord, pParam->ppWordTable,
-                      pParam->wordTableSize,
-                      pParam->wordTableSeed,
-                      pParam);
-              
-              distinctWords++;
-              
-              if (word->count == 1)
-              {
-                number++;
-                word->number = number;
-              }
-              
-              /* If word is repeated..its support will not
-               increment more than once in one log line. */
-              if (is_word_repeated(pParam->wordNumStr,
-                         word->number, distinctWords))
-              {
-                distinctWords--;
-                word->count--;
-              }
-              else
-              {
-                pParam->wordNumStr[distinctWords]= word->number;
-              }
-              
-            }
-          }
-        }
-        else
-        {
-          word = add_elem(words[i], pParam->ppWordTable,
-                  pParam->wordTableSize,
-                  pParam->wordTableSeed,
-                  pParam);
-          
-          distinctWords++;
-          
-          if (word->count == 1)
-          {
-            number++;
-            word->number = number;
-          }
-          
-          /* If word is repeated..its support will not increment more
-           than once in one log line. */
-          if (is_word_repeated(pParam->wordNumStr, word->number,
-                     distinctWords))
-          {
-            distinctWords--;
-            word->count--;
-          }
-          else
-          {
-            pParam->wordNumStr[distinctWords] = word->number;
-          }
-          
-          if (is_word_filtered(words[i], pParam))
-          {
-            strcpy(newWord, word_search_replace(words[i], pParam));
-            word = add_elem(newWord, pParam->ppWordTable,
-                    pParam->wordTableSize,
-                    pParam->wordTableSeed,
-                    pParam);
-            
-            distinctWords++;
-            
-            if (word->count == 1)
-            {
-              number++;
-              word->number = number;
-            }
-            
-            /* If word is repeated..its support will not increment
-             more than once in one log line. */
-            if (is_word_repeated(pParam->wordNumStr, word->number,
-                       distinctWords))
-            {
-              distinctWords--;
-              word->count--;
-            }
-            else
-            {
-              pParam->wordNumStr[distinctWords] = word->number;
-            }
-          }
+          pipeline_append(pWorker, pNewWord, strlen(pNewWord) + 1);
         }
       }
+    }
+    else
+    {
+      pipeline_append(pWorker, words[i], strlen(words[i]) + 1);
       
-      linecount++;
+      if ((pNewWord = word_filter_search_replace(words[i],
+                pWorker->pParser, pParam)))
+      {
+        pipeline_append(pWorker, pNewWord, strlen(pNewWord) + 1);
+      }
     }
-    
-    fclose(pFile);
-    
   }
+}
+
+/* Insert the words of one line into the vocabulary. The words are numbered
+ in the order they are first seen, as the records come in the order of the
+ input. */
+static void vocabulary_consume(char *pRecord, size_t len, void *pArg)
+{
+  struct VocabularyPass *pPass;
+  struct Parameters *pParam;
+  struct Elem *word;
+  char *pWord;
+  int distinctWords;
   
-  if (!pParam->linecount)
+  pPass = (struct VocabularyPass *) pArg;
+  pParam = pPass->pParam;
+  
+  distinctWords = 0;
+  
+  for (pWord = pRecord; pWord < pRecord + len; pWord += strlen(pWord) + 1)
   {
-    pParam->linecount = linecount;
+    word = cached_add_elem(pWord, &pPass->cache, pParam->ppWordTable, 
+                pParam->wordTableSize, pParam->wordTableSeed, pParam);
+    distinctWords++;
+    
+    if (word->count == 1)
+    {
+      pPass->number++;
+      word->number = pPass->number;
+    }
+    
+    /* If word is repeated..its support will not increment more than
+     once in one log line. */
+    if (is_word_repeated(pParam->wordNumStr, word->number, distinctWords))
+    {
+      distinctWords--;
+      word->count--;
+    }
+    else
+    {
+      pParam->wordNumStr[distinctWords] = word->number;
+    }
   }
+}
+
+/* Same as vocabulary_consume(), but called by several threads at once, which
+ insert into the same table. A word is counted once per line, the words of the
+ line already counted are kept in pSeen, which is local to the thread. A
+ record holds at most a word and its rewritten form for every word of the
+ line. */
+static void vocabulary_consume_shared(char *pRecord, size_t len, void *pArg)
+{
+  struct VocabularyPass *pPass;
+  struct Parameters *pParam;
+  struct Elem *word;
+  struct Elem *pSeen[2 * MAXWORDS];
+  char *pWord;
+  int distinctWords, i;
   
-  if (!pParam->support)
+  pPass = (struct VocabularyPass *) pArg;
+  pParam = pPass->pParam;
+  
+  distinctWords = 0;
+  
+  for (pWord = pRecord; pWord < pRecord + len; pWord += strlen(pWord) + 1)
   {
-    pParam->support = linecount * pParam->pctSupport / 100;
+    word = add_elem_shared(pWord, pParam->ppWordTable, pParam->wordTableSize, 
+                pParam->wordTableSeed, pParam);
+    
+    for (i = 0; i < distinctWords; i++)
+    {
+      if (pSeen[i] == word)
+      {
+        break;
+      }
+    }
+    
+    if (i < distinctWords)
+    {
+      continue;
+    }
+    
+    pSeen[distinctWords++] = word;
+    __atomic_fetch_add(&word->count, 1, __ATOMIC_RELAXED);
   }
-  
-  return number;
 }
-
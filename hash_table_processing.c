@@ -31,13 +31,65 @@
 #include "utility.h"
 #include "output.h"
 
+static struct Elem *insert_elem(char *pKey, tableindex_t hash, 
+        struct Elem **ppTable, struct Parameters *pParam);
+static struct WordCacheSlot *word_cache_slot(struct WordCache *pCache,
+        char *pKey, tableindex_t hash, unsigned long *pPrefix, size_t *pLen);
+static int word_cache_match(struct WordCacheSlot *pSlot, char *pKey,
+        tableindex_t hash, unsigned long prefix, size_t len);
+static void word_cache_check(struct WordCache *pCache);
+
 struct Elem *add_elem(char *pKey, struct Elem **ppTable, tableindex_t tablesize, 
         tableindex_t seed, struct Parameters *pParam)
 {
+  return insert_elem(pKey, str2hash(pKey, tablesize, seed), ppTable, pParam);
+}
+
+/* Same as add_elem(), but the word is looked up in pCache first. A word found
+ in the cache is not moved to the front of its chain. */
+struct Elem *cached_add_elem(char *pKey, struct WordCache *pCache, 
+        struct Elem **ppTable, tableindex_t tablesize, tableindex_t seed, 
+        struct Parameters *pParam)
+{
+  struct WordCacheSlot *pSlot;
+  struct Elem *ptr;
   tableindex_t hash;
-  struct Elem *ptr, *pPrev;
+  unsigned long prefix;
+  size_t len;
   
   hash = str2hash(pKey, tablesize, seed);
+  pCache->lookups++;
+  
+  if (pCache->bOff)
+  {
+    return insert_elem(pKey, hash, ppTable, pParam);
+  }
+  
+  word_cache_check(pCache);
+  pSlot = word_cache_slot(pCache, pKey, hash, &prefix, &len);
+  
+  if (word_cache_match(pSlot, pKey, hash, prefix, len))
+  {
+    pCache->hits++;
+    pSlot->pElem->count++;
+    return pSlot->pElem;
+  }
+  
+  ptr = insert_elem(pKey, hash, ppTable, pParam);
+  
+  pSlot->hash = hash;
+  pSlot->prefix = prefix;
+  pSlot->len = len;
+  pSlot->pElem = ptr;
+  
+  return ptr;
+}
+
+/* The body of add_elem(), hash is the slot of pKey. */
+static struct Elem *insert_elem(char *pKey, tableindex_t hash, 
+        struct Elem **ppTable, struct Parameters *pParam)
+{
+  struct Elem *ptr, *pPrev;
   
   if (ppTable[hash])
   {
@@ -144,3 +196,247 @@ struct Elem *find_elem(char *key, struct Elem **table, tableindex_t tablesize,
   
   return ptr;
 }
+
+/* Same as find_elem(), but the table is not modified, so it can be called by
+ several threads at the same time. */
+struct Elem *lookup_elem(char *key, struct Elem **table, tableindex_t tablesize,
+             tableindex_t seed)
+{
+  struct Elem *ptr;
+  
+  for (ptr = table[str2hash(key, tablesize, seed)]; ptr; ptr = ptr->pNext)
+  {
+    if (!strcmp(key, ptr->pKey))
+    {
+      break;
+    }
+  }
+  
+  return ptr;
+}
+
+/* Same as lookup_elem() for pKeys[0...num - 1], the results are stored into
+ ppResult. The keys are looked up in pCache first, the others in groups of
+ LOOKUP_GROUP, in stages: the slots of the group are hashed and prefetched,
+ then the first elements of their chains, then the keys of these elements,
+ and then the chains are searched. Thus the cache misses of a group overlap,
+ instead of each lookup waiting for the misses of the previous one. */
+void lookup_elems(char (*pKeys)[MAXWORDLEN], int num, struct Elem **ppResult,
+        struct WordCache *pCache, struct Elem **table, tableindex_t tablesize,
+        tableindex_t seed)
+{
+  tableindex_t hash[LOOKUP_GROUP];
+  struct WordCacheSlot *pSlots[LOOKUP_GROUP];
+  unsigned long prefix[LOOKUP_GROUP];
+  size_t len[LOOKUP_GROUP];
+  struct WordCacheSlot *pSlot, slotOff;
+  struct Elem *ptr;
+  int first, groupNum, i;
+  
+  pCache->lookups += num;
+  word_cache_check(pCache);
+  
+  for (first = 0; first < num; first += LOOKUP_GROUP)
+  {
+    groupNum = num - first < LOOKUP_GROUP ? num - first : LOOKUP_GROUP;
+    
+    /* A key found in the cache gets a null slot pointer, and a key looked up
+     while the cache is off gets a pointer to slotOff. */
+    for (i = 0; i < groupNum; i++)
+    {
+      hash[i] = str2hash(pKeys[first + i], tablesize, seed);
+      
+      if (pCache->bOff)
+      {
+        pSlots[i] = &slotOff;
+        __builtin_prefetch(table + hash[i]);
+        continue;
+      }
+      
+      pSlot = word_cache_slot(pCache, pKeys[first + i], hash[i], prefix + i,
+                  len + i);
+      
+      if (word_cache_match(pSlot, pKeys[first + i], hash[i], prefix[i], 
+                 len[i]))
+      {
+        pCache->hits++;
+        ppResult[first + i] = pSlot->pElem;
+        pSlots[i] = 0;
+        continue;
+      }
+      
+      pSlots[i] = pSlot;
+      __builtin_prefetch(table + hash[i]);
+    }
+    
+    for (i = 0; i < groupNum; i++)
+    {
+      if (pSlots[i])
+      {
+        ptr = table[hash[i]];
+        ppResult[first + i] = ptr;
+        if (ptr)
+        {
+          __builtin_prefetch(ptr);
+        }
+      }
+    }
+    
+    for (i = 0; i < groupNum; i++)
+    {
+      if (pSlots[i] && (ptr = ppResult[first + i]))
+      {
+        __builtin_prefetch(ptr->pKey);
+      }
+    }
+    
+    for (i = 0; i < groupNum; i++)
+    {
+      if (!pSlots[i])
+      {
+        continue;
+      }
+      
+      for (ptr = ppResult[first + i]; ptr; ptr = ptr->pNext)
+      {
+        if (!strcmp(pKeys[first + i], ptr->pKey))
+        {
+          break;
+        }
+      }
+      ppResult[first + i] = ptr;
+      
+      if (ptr)
+      {
+        pSlots[i]->hash = hash[i];
+        pSlots[i]->prefix = prefix[i];
+        pSlots[i]->len = len[i];
+        pSlots[i]->pElem = ptr;
+      }
+    }
+  }
+}
+
+void word_cache_init(struct WordCache *pCache)
+{
+  int i;
+  
+  for (i = 0; i < WORD_CACHE_SIZE; i++)
+  {
+    pCache->slots[i].pElem = 0;
+  }
+  pCache->lookups = 0;
+  pCache->hits = 0;
+  pCache->bChecked = 0;
+  pCache->bOff = 0;
+}
+
+/* Add the counters of pCache to the counters of the pass, and reset them. */
+void word_cache_flush(struct WordCache *pCache, struct Parameters *pParam)
+{
+  __atomic_fetch_add(&pParam->progress.cacheLookups, pCache->lookups,
+             __ATOMIC_RELAXED);
+  __atomic_fetch_add(&pParam->progress.cacheHits, pCache->hits,
+             __ATOMIC_RELAXED);
+  pCache->lookups = 0;
+  pCache->hits = 0;
+}
+
+/* Returns the cache slot of pKey, which is in table slot hash, and stores
+ the length and the prefix of pKey into *pLen and *pPrefix. */
+static struct WordCacheSlot *word_cache_slot(struct WordCache *pCache,
+        char *pKey, tableindex_t hash, unsigned long *pPrefix, size_t *pLen)
+{
+  size_t len;
+  
+  len = strlen(pKey);
+  *pPrefix = 0;
+  memcpy(pPrefix, pKey, len < sizeof(unsigned long) ? len : 
+      sizeof(unsigned long));
+  *pLen = len;
+  
+  return pCache->slots + ((hash ^ len) & (WORD_CACHE_SIZE - 1));
+}
+
+/* Turns pCache off once, after WORD_CACHE_PROBE lookups, if too few of them
+ hit. */
+static void word_cache_check(struct WordCache *pCache)
+{
+  if (!pCache->bChecked && pCache->lookups >= WORD_CACHE_PROBE)
+  {
+    pCache->bChecked = 1;
+    pCache->bOff = pCache->hits * WORD_CACHE_MIN_HIT_DIV < pCache->lookups;
+  }
+}
+
+static int word_cache_match(struct WordCacheSlot *pSlot, char *pKey,
+        tableindex_t hash, unsigned long prefix, size_t len)
+{
+  return pSlot->pElem && pSlot->hash == hash && pSlot->len == len &&
+      pSlot->prefix == prefix && (len <= sizeof(unsigned long) ||
+      !strcmp(pSlot->pElem->pKey, pKey));
+}
+
+/* Same as add_elem(), but several threads can insert into the same table at
+ the same time, and the count is not incremented (the caller increments it
+ atomically). A new element is pushed to the front of its chain with a
+ compare-and-swap of the chain head; if another thread has pushed elements in
+ the meantime, only these are searched again. Elements are not moved or
+ removed while the table is shared, so the chains can be walked without
+ locks. */
+struct Elem *add_elem_shared(char *pKey, struct Elem **ppTable, 
+        tableindex_t tablesize, tableindex_t seed, struct Parameters *pParam)
+{
+  tableindex_t hash;
+  struct Elem *ptr, *pHead, *pStop, *pNew;
+  
+  hash = str2hash(pKey, tablesize, seed);
+  pHead = __atomic_load_n(&ppTable[hash], __ATOMIC_ACQUIRE);
+  pStop = 0;
+  pNew = 0;
+  
+  for (;;)
+  {
+    for (ptr = pHead; ptr != pStop; ptr = ptr->pNext)
+    {
+      if (!strcmp(pKey, ptr->pKey))
+      {
+        if (pNew)
+        {
+          free((void *) pNew->pKey);
+          free((void *) pNew);
+        }
+        return ptr;
+      }
+    }
+    
+    if (!pNew)
+    {
+      pNew = (struct Elem *) malloc(sizeof(struct Elem));
+      if (!pNew)
+      {
+        log_msg(MALLOC_ERR_6007, LOG_ERR, pParam);
+        exit(1);
+      }
+      
+      pNew->pKey = (char *) malloc(strlen(pKey) + 1);
+      if (!pNew->pKey)
+      {
+        log_msg(MALLOC_ERR_6007, LOG_ERR, pParam);
+        exit(1);
+      }
+      
+      strcpy(pNew->pKey, pKey);
+      pNew->count = 0;
+    }
+    
+    pNew->pNext = pHead;
+    pStop = pHead;
+    
+    if (__atomic_compare_exchange_n(&ppTable[hash], &pHead, pNew, 0,
+                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+      return pNew;
+    }
+  }
+}
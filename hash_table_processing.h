@@ -32,8 +32,20 @@ extern "C" {
 
 struct Elem *add_elem(char *pKey, struct Elem **ppTable, tableindex_t tablesize, 
         tableindex_t seed, struct Parameters *pParam);
+struct Elem *add_elem_shared(char *pKey, struct Elem **ppTable, 
+        tableindex_t tablesize, tableindex_t seed, struct Parameters *pParam);
 struct Elem *find_elem(char *key, struct Elem **table, tableindex_t tablesize,
              tableindex_t seed);
+struct Elem *lookup_elem(char *key, struct Elem **table, tableindex_t tablesize,
+             tableindex_t seed);
+struct Elem *cached_add_elem(char *pKey, struct WordCache *pCache, 
+        struct Elem **ppTable, tableindex_t tablesize, tableindex_t seed, 
+        struct Parameters *pParam);
+void lookup_elems(char (*pKeys)[MAXWORDLEN], int num, struct Elem **ppResult,
+        struct WordCache *pCache, struct Elem **table, tableindex_t tablesize,
+        tableindex_t seed);
+void word_cache_init(struct WordCache *pCache);
+void word_cache_flush(struct WordCache *pCache, struct Parameters *pParam);
 
 #ifdef __cplusplus
 }
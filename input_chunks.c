@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * File:   input_chunks.c
+ *
+ * Content: Splitting of the input files into byte ranges, and reading the
+ * lines of one range, for the passes that process the input in parallel.
+ *
+ * Created on October 19, 2026, 10:20 PM
+ */
+
+#include "common_header.h"
+#include "input_chunks.h"
+
+#include <string.h>    /* for strlen(), strerror(), etc. */
+#include <errno.h>     /* for errno */
+
+#include "output.h"
+#include "progress.h"
+
+/* A chunk reader returns exactly the same pieces as read_line() on the whole
+ file: a chunk starts at the first line that begins at or after its begin
+ offset, and reads until the first line that begins at or after its end
+ offset. Lines longer than MAXLINELEN - 1 bytes are split into pieces by
+ fgets() counting from the start of the line, so they are split the same way
+ regardless of which chunk reads them. */
+
+static int open_next_file(struct ChunkReader *pReader,
+        struct Parameters *pParam);
+static void publish_progress(struct ChunkReader *pReader, 
+        struct Parameters *pParam);
+
+/* Split the input files into chunks, in the order of the input. The chunk
+ size is chosen from the total size of the input files, so that every thread
+ gets several chunks, and the work-stealing workers of parallel_for() can even
+ out files of very different size. A regular file larger than the chunk size
+ is split into byte ranges of equal size, consecutive smaller files are
+ batched into one chunk, other files (and empty files) are one chunk each.
+ The number of chunks is stored into *pChunkNum. */
+struct InputChunk *plan_input_chunks(unsigned long *pChunkNum,
+        struct Parameters *pParam)
+{
+  struct InputFile *pFilePtr;
+  struct InputChunk *pChunks, *pBatch;
+  unsigned long chunkNum, pieces, i;
+  long long size, total, chunkSize, pieceSize, batchSize, begin;
+  
+  total = 0;
+  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  {
+    total += (long long) pFilePtr->fileSize;
+  }
+  
+  chunkSize = total / (pParam->threadNum * INPUT_CHUNKS_PER_THREAD);
+  if (chunkSize < INPUT_CHUNK_MIN)
+  {
+    chunkSize = INPUT_CHUNK_MIN;
+  }
+  if (chunkSize > INPUT_CHUNK_MAX)
+  {
+    chunkSize = INPUT_CHUNK_MAX;
+  }
+  
+  /* Without batching, this is the number of chunks. */
+  chunkNum = 0;
+  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  {
+    size = (long long) pFilePtr->fileSize;
+    chunkNum += size ? (unsigned long) ((size + chunkSize - 1) / chunkSize) : 1;
+  }
+  
+  pChunks = (struct InputChunk *) malloc((chunkNum + 1) * 
+                       sizeof(struct InputChunk));
+  if (!pChunks)
+  {
+    log_msg(MALLOC_ERR_6034, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  i = 0;
+  pBatch = 0;
+  batchSize = 0;
+  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  {
+    size = (long long) pFilePtr->fileSize;
+    
+    if (size && size < chunkSize)
+    {
+      if (pBatch && batchSize + size <= chunkSize)
+      {
+        pBatch->fileNum++;
+        batchSize += size;
+        continue;
+      }
+      
+      pBatch = pChunks + i;
+      batchSize = size;
+    }
+    else
+    {
+      pBatch = 0;
+    }
+    
+    if (size < chunkSize)
+    {
+      pChunks[i].pFile = pFilePtr;
+      pChunks[i].begin = 0;
+      pChunks[i].end = -1;
+      pChunks[i].fileNum = 1;
+      i++;
+      continue;
+    }
+    
+    pieces = (unsigned long) ((size + chunkSize - 1) / chunkSize);
+    pieceSize = (size + (long long) pieces - 1) / (long long) pieces;
+    
+    for (begin = 0; begin < size; begin += pieceSize)
+    {
+      pChunks[i].pFile = pFilePtr;
+      pChunks[i].begin = begin;
+      /* The last chunk reads to the end of the file, in case it has grown
+       since it was checked. */
+      pChunks[i].end = begin + pieceSize < size ? begin + pieceSize : -1;
+      pChunks[i].fileNum = 1;
+      i++;
+    }
+  }
+  
+  *pChunkNum = i;
+  return pChunks;
+}
+
+/* Open the file of pChunk, and position the reader at the first line of the
+ chunk. Returns 0 if no file can be opened. That is reported only by the
+ first chunk of a file. */
+int chunk_reader_open(struct ChunkReader *pReader, struct InputChunk *pChunk,
+        struct Parameters *pParam)
+{
+  char logStr[MAXLOGMSGLEN];
+  int c;
+  
+  pReader->pFile = 0;
+  pReader->end = pChunk->end;
+  pReader->pNextFile = pChunk->pFile;
+  pReader->filesLeft = pChunk->fileNum;
+  pReader->lines = 0;
+  pReader->bytes = 0;
+  
+  if (pChunk->begin == 0)
+  {
+    return open_next_file(pReader, pParam);
+  }
+  
+  pReader->pos = pChunk->begin;
+  pReader->bLineOpen = 0;
+  pReader->filesLeft = 0;
+  
+  if (!(pReader->pFile = fopen(pChunk->pFile->pName, "r")))
+  {
+    return 0;
+  }
+  
+  /* The line that contains byte begin - 1 belongs to the previous chunk,
+   unless that byte ends it. */
+  if (fseeko(pReader->pFile, (off_t) (pChunk->begin - 1), SEEK_SET))
+  {
+    sprintf(logStr, "Can't seek in input file %s: %s", pChunk->pFile->pName,
+        strerror(errno));
+    log_msg(logStr, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  pReader->pos = pChunk->begin - 1;
+  while ((c = getc(pReader->pFile)) != EOF)
+  {
+    pReader->pos++;
+    if (c == '\n')
+    {
+      break;
+    }
+  }
+  
+  return 1;
+}
+
+/* Close the current file, and open the next file of the chunk that can be
+ opened. Returns 0 if there is none. */
+static int open_next_file(struct ChunkReader *pReader,
+        struct Parameters *pParam)
+{
+  char logStr[MAXLOGMSGLEN];
+  struct InputFile *pFilePtr;
+  
+  chunk_reader_close(pReader);
+  
+  while (pReader->filesLeft)
+  {
+    pFilePtr = pReader->pNextFile;
+    pReader->pNextFile = pFilePtr->pNext;
+    pReader->filesLeft--;
+    
+    if ((pReader->pFile = fopen(pFilePtr->pName, "r")))
+    {
+      pReader->pos = 0;
+      pReader->bLineOpen = 0;
+      return 1;
+    }
+    
+    sprintf(logStr, "Can't open input file %s", pFilePtr->pName);
+    log_msg(logStr, LOG_ERR, pParam);
+  }
+  
+  return 0;
+}
+
+/* Read the next line of the chunk into line, like read_line(). Returns 0 when
+ the chunk is over, and on every call after that. The lines and bytes are
+ added to the progress counters in batches, the last one when the chunk is
+ over, so that the workers don't write the shared counters for every line. */
+int chunk_reader_read_line(struct ChunkReader *pReader, char *line,
+        struct Parameters *pParam)
+{
+  int len;
+  
+  if (!pReader->pFile || 
+      (pReader->end >= 0 && pReader->pos >= pReader->end && 
+       !pReader->bLineOpen))
+  {
+    publish_progress(pReader, pParam);
+    return 0;
+  }
+  
+  /* At the end of a file, a batch goes on with its next file. */
+  while (!fgets(line, MAXLINELEN, pReader->pFile))
+  {
+    if (!open_next_file(pReader, pParam))
+    {
+      publish_progress(pReader, pParam);
+      return 0;
+    }
+  }
+  
+  len = (int) strlen(line);
+  
+  if (len && line[len - 1] == '\n')
+  {
+    pReader->pos += len;
+    pReader->bLineOpen = 0;
+    line[len - 1] = 0;
+  }
+  else if (len == MAXLINELEN - 1)
+  {
+    pReader->pos += len;
+    pReader->bLineOpen = 1;
+  }
+  else
+  {
+    /* A short piece without newline is either the end of the file, or
+     contains a '\0' byte, which strlen() does not count. fgets() has still
+     read the rest of the piece into line. */
+    len = (int) ((long long) ftello(pReader->pFile) - pReader->pos);
+    pReader->pos += len;
+    pReader->bLineOpen = !(len && line[len - 1] == '\n');
+  }
+  
+  pReader->lines++;
+  pReader->bytes += len;
+  if (pReader->bytes >= PROGRESS_PUBLISH_BYTES)
+  {
+    publish_progress(pReader, pParam);
+  }
+  
+  return 1;
+}
+
+static void publish_progress(struct ChunkReader *pReader, 
+        struct Parameters *pParam)
+{
+  if (pReader->lines)
+  {
+    progress_add(&pParam->progress.lines, pReader->lines);
+    progress_add(&pParam->progress.bytes, pReader->bytes);
+    pReader->lines = 0;
+    pReader->bytes = 0;
+  }
+}
+
+void chunk_reader_close(struct ChunkReader *pReader)
+{
+  if (pReader->pFile)
+  {
+    fclose(pReader->pFile);
+    pReader->pFile = 0;
+  }
+}
+
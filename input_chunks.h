@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * File:   input_chunks.h
+ *
+ * Content: Declarations of global functions in input_chunks.c .
+ *
+ * Created on October 19, 2026, 10:20 PM
+ */
+
+#ifndef INPUT_CHUNKS_H
+#define INPUT_CHUNKS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct InputChunk *plan_input_chunks(unsigned long *pChunkNum,
+        struct Parameters *pParam);
+int chunk_reader_open(struct ChunkReader *pReader, struct InputChunk *pChunk,
+        struct Parameters *pParam);
+int chunk_reader_read_line(struct ChunkReader *pReader, char *line,
+        struct Parameters *pParam);
+void chunk_reader_close(struct ChunkReader *pReader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INPUT_CHUNKS_H */
+
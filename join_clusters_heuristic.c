@@ -32,29 +32,61 @@
 #include "hash_table_processing.h"
 #include "utility.h"
 #include "line_processing.h"
+#include "thread_pool.h"
+
+/* Scratch storage of one thread for calculating word weights.
+ 
+ The weights of all constants of a cluster are calculated together. The words
+ whose dependencies are summed (every constant for function_1, every unique
+ constant for function_2) are stored in wordNumStr[1...wordNumStr[0]]. For
+ each of them, the matrix entries of the cluster's constants are gathered into
+ pRow[], and added to pSum[], so the inner loop runs over contiguous memory.
+ 
+ pSeen[] is indexed by word number, and records the last cluster (stamp) in
+ which the word was met, so unique words are found without comparing them to
+ each other. */
+struct JoinScratch {
+  wordnumber_t wordNumStr[MAXWORDS + 1];
+  wordnumber_t pRow[MAXWORDS + 1];
+  double pSum[MAXWORDS + 1];
+  unsigned long *pSeen;
+  unsigned long stamp;
+};
+
+/* Argument of check_cluster_body(). The token markers of the cluster
+ ppClusters[i] start at pMarkers + pMarkerStart[i], one for each constant. If
+ this cluster has token, its marker[0] is set to 1. The corresponding
+ constants's marker slots will also be set to 1. */
+struct JoinJob {
+  struct Cluster **ppClusters;
+  unsigned long *pMarkerStart;
+  char *pMarkers;
+  struct JoinScratch *pScratch;
+  struct Parameters *pParam;
+};
 
 static void set_token(struct Parameters *pParam);
 static void join_cluster(struct Parameters *pParam);
+static void check_cluster_body(unsigned long index, int worker, void *pArg);
 static void check_cluster_for_join_cluster(struct Cluster* pCluster,
-                  struct Parameters *pParam);
-static double cal_word_weight(struct Cluster *pCluster, int serial,
-             struct Parameters *pParam);
-static double cal_word_weight_function_1(struct Cluster *pCluster, int serial,
-                  struct Parameters *pParam);
-static double cal_word_weight_function_2(struct Cluster *pCluster, int serial,
-                  struct Parameters *pParam);
-static double cal_word_dep(struct Elem *word1, struct Elem *word2,
-          struct Parameters *pParam);
-static double cal_word_dep_number_version(wordnumber_t word1num, 
-        wordnumber_t word2num, struct Parameters *pParam);
+        char *pMarker, struct JoinScratch *pScratch,
+        struct Parameters *pParam);
+static void cal_word_weights(struct Cluster *pCluster, 
+        struct JoinScratch *pScratch, struct Parameters *pParam);
 static void get_unique_frequent_words_out_of_cluster(struct Cluster *pCluster,
-                        struct Parameters *pParam);
-static void join_cluster_with_token(struct Cluster *pCluster,
+                        struct JoinScratch *pScratch);
+static void sum_word_deps(struct Cluster *pCluster, 
+        struct JoinScratch *pScratch, struct Parameters *pParam);
+static void join_cluster_with_token(struct Cluster *pCluster, char *pMarker,
                struct Parameters *pParam);
+static struct ClusterWithToken **find_joined_slot(wordnumber_t *pKey,
+        int constants, unsigned long hash, struct Parameters *pParam);
+static void grow_joined_table(struct Parameters *pParam);
 static struct ClusterWithToken *create_cluster_with_token_instance(
-  struct Cluster *pCluster, struct Elem *pElem, struct Parameters *pParam);
+  struct Cluster *pCluster, wordnumber_t *pKey, unsigned long hash,
+  struct Parameters *pParam);
 static void adjust_cluster_with_token_instance(struct Cluster *pCluster,
-                    struct Elem *pElem, struct Parameters *pParam);
+        char *pMarker, struct ClusterWithToken *ptr, struct Parameters *pParam);
 static int check_if_token_key_is_exist(struct ClusterWithToken *ptr, int serial,
                 struct Elem *pElem);
 
@@ -107,308 +139,430 @@ static void set_token(struct Parameters *pParam)
   }
 }
 
+/* Word weights only read the word dependency matrix, thus the clusters are
+ checked in parallel ('--threads' option), and each cluster's token markers
+ are staged in its own slots. Joining changes the joined cluster table and
+ pClusterWithTokenFamily[], so it is done afterwards by one thread, in the
+ same order as the clusters are stored, which keeps the output deterministic. */
 static void join_cluster(struct Parameters *pParam)
 {
   int i;
   struct Cluster *pCluster;
   struct ClusterWithToken *pClusterWithToken;
+  struct JoinJob job;
+  unsigned long clusterNum, markerNum, j;
+  char *pMarker;
   
+  clusterNum = 0;
+  markerNum = 0;
   for (i = 1; i <= pParam->biggestConstants; i++)
   {
-    pCluster = pParam->pClusterFamily[i];
-    
-    while (pCluster)
+    for (pCluster = pParam->pClusterFamily[i]; pCluster; 
+        pCluster = pCluster->pNext)
+    {
+      clusterNum++;
+      markerNum += pCluster->constants + 1;
+    }
+  }
+  
+  job.ppClusters = (struct Cluster **) malloc((clusterNum + 1) * 
+                        sizeof(struct Cluster *));
+  job.pMarkerStart = (unsigned long *) malloc((clusterNum + 1) * 
+                        sizeof(unsigned long));
+  job.pMarkers = (char *) malloc(markerNum + 1);
+  job.pScratch = (struct JoinScratch *) malloc(pParam->threadNum * 
+                         sizeof(struct JoinScratch));
+  if (!job.ppClusters || !job.pMarkerStart || !job.pMarkers || !job.pScratch)
+  {
+    log_msg(MALLOC_ERR_6029, LOG_ERR, pParam);
+    exit(1);
+  }
+  job.pParam = pParam;
+  
+  for (i = 0; i < pParam->threadNum; i++)
+  {
+    job.pScratch[i].stamp = 0;
+    job.pScratch[i].pSeen = (unsigned long *) calloc(
+        pParam->wordDepMatrixBreadth, sizeof(unsigned long));
+    if (!job.pScratch[i].pSeen)
+    {
+      log_msg(MALLOC_ERR_6029, LOG_ERR, pParam);
+      exit(1);
+    }
+  }
+  
+  clusterNum = 0;
+  markerNum = 0;
+  for (i = 1; i <= pParam->biggestConstants; i++)
+  {
+    for (pCluster = pParam->pClusterFamily[i]; pCluster; 
+        pCluster = pCluster->pNext)
+    {
+      job.ppClusters[clusterNum] = pCluster;
+      job.pMarkerStart[clusterNum] = markerNum;
+      clusterNum++;
+      markerNum += pCluster->constants + 1;
+    }
+  }
+  
+  parallel_for(clusterNum, check_cluster_body, &job, pParam);
+  
+  pParam->joinedTableSize = DEF_JOINED_TABLE_SIZE;
+  pParam->ppJoinedTable = (struct ClusterWithToken **) calloc(
+      pParam->joinedTableSize, sizeof(struct ClusterWithToken *));
+  if (!pParam->ppJoinedTable)
+  {
+    log_msg(MALLOC_ERR_6029, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  for (j = 0; j < clusterNum; j++)
+  {
+    pMarker = job.pMarkers + job.pMarkerStart[j];
+    if (pMarker[0] == 1)
     {
-      check_cluster_for_join_cluster(pCluster, pParam);
-      pCluster = pCluster->pNext;
+      job.ppClusters[j]->bIsJoined = 1;
+      join_cluster_with_token(job.ppClusters[j], pMarker, pParam);
     }
   }
   
-  //additional work. Equal the counters in Elem and ClusterWithToken
+  free((void *) job.ppClusters);
+  free((void *) job.pMarkerStart);
+  free((void *) job.pMarkers);
+  for (i = 0; i < pParam->threadNum; i++)
+  {
+    free((void *) job.pScratch[i].pSeen);
+  }
+  free((void *) job.pScratch);
+  
+  //additional work. Equal the counters in elem and ClusterWithToken
   for (i = 1; i <= pParam->biggestConstants; i++)
   {
     pClusterWithToken = pParam->pClusterWithTokenFamily[i];
     
     while (pClusterWithToken)
     {
-      pClusterWithToken->pElem->count = pClusterWithToken->count;
+      pClusterWithToken->elem.count = pClusterWithToken->count;
       pClusterWithToken = pClusterWithToken->pNext;
     }
   }
 }
 
+static void check_cluster_body(unsigned long index, int worker, void *pArg)
+{
+  struct JoinJob *pJob;
+  
+  pJob = (struct JoinJob *) pArg;
+  check_cluster_for_join_cluster(pJob->ppClusters[index], 
+                   pJob->pMarkers + pJob->pMarkerStart[index],
+                   &pJob->pScratch[worker], pJob->pParam);
+}
+
 static void check_cluster_for_join_cluster(struct Cluster* pCluster,
-                  struct Parameters *pParam)
+        char *pMarker, struct JoinScratch *pScratch,
+        struct Parameters *pParam)
 {
   int i;
   
   for (i = 0; i <= pCluster->constants; i++)
   {
-    pParam->tokenMarker[i] = 0;
+    pMarker[i] = 0;
   }
   
+  cal_word_weights(pCluster, pScratch, pParam);
+  
   for (i = 1; i <= pCluster->constants ; i++)
   {
-    if (cal_word_weight(pCluster, i, pParam) < pParam->wordWeightThreshold)
+    if (pScratch->pSum[i] < pParam->wordWeightThreshold)
     {
-      /* tokenMarker[0] means this cluster has token. We should keep on
+      /* pMarker[0] means this cluster has token. We should keep on
        to see which constant(s) is/are token(s). */
-      pParam->tokenMarker[0] = 1;
+      pMarker[0] = 1;
       
-      pParam->tokenMarker[i] = 1;
+      pMarker[i] = 1;
     }
   }
-  
-  if (pParam->tokenMarker[0] == 1)
-  {
-    pCluster->bIsJoined = 1;
-    join_cluster_with_token(pCluster, pParam);
-  }
 }
 
-static double cal_word_weight(struct Cluster *pCluster, int serial,
-             struct Parameters *pParam)
+/* Calculate the word weight of every constant of the cluster into
+ pScratch->pSum[1...constants].
+ 
+ Function_1: the average dependency of the constant on every constant.
+ Function_2: the average dependency of the constant on every other unique
+ constant, that is, its dependency on itself (which is 1) is not counted. If
+ the cluster has only one unique constant, the weight is 1. */
+static void cal_word_weights(struct Cluster *pCluster, 
+        struct JoinScratch *pScratch, struct Parameters *pParam)
 {
+  int i, uniqueNum;
+  
   switch (pParam->wordWeightFunction)
   {
     case 1:
-      return cal_word_weight_function_1(pCluster, serial, pParam);
+      for (i = 1; i <= pCluster->constants; i++)
+      {
+        pScratch->wordNumStr[i] = pCluster->ppWord[i]->number;
+      }
+      pScratch->wordNumStr[0] = pCluster->constants;
+      
+      sum_word_deps(pCluster, pScratch, pParam);
+      
+      for (i = 1; i <= pCluster->constants; i++)
+      {
+        pScratch->pSum[i] = pScratch->pSum[i] / pCluster->constants;
+      }
       break;
     case 2:
-      return cal_word_weight_function_2(pCluster, serial, pParam);
+      get_unique_frequent_words_out_of_cluster(pCluster, pScratch);
+      uniqueNum = (int) pScratch->wordNumStr[0];
+      
+      if (uniqueNum == 1)
+      {
+        for (i = 1; i <= pCluster->constants; i++)
+        {
+          pScratch->pSum[i] = 1;
+        }
+        break;
+      }
+      
+      sum_word_deps(pCluster, pScratch, pParam);
+      
+      for (i = 1; i <= pCluster->constants; i++)
+      {
+        pScratch->pSum[i] = (double) (pScratch->pSum[i] - 1) / 
+            (uniqueNum - 1);
+      }
       break;
     default:
-      log_msg("failed calculate word weight. Funciton: cal_word_weight()",
+      log_msg("failed calculate word weight. Funciton: cal_word_weights()",
           LOG_ERR, pParam);
       exit(1);
       break;
   }
-  
-  return 0;
 }
 
-static double cal_word_weight_function_1(struct Cluster *pCluster, int serial,
-                  struct Parameters *pParam)
+/* Unique constants are stored in wordNumStr[1...wordNumStr[0]], in the order
+ they first appear in the cluster. */
+static void get_unique_frequent_words_out_of_cluster(struct Cluster *pCluster,
+                        struct JoinScratch *pScratch)
 {
-  double sum;
   int i;
-  double result;
+  int distinctConstants;
+  wordnumber_t number;
   
-  sum = 0;
+  distinctConstants = 0;
+  pScratch->stamp++;
   
   for (i = 1; i <= pCluster->constants; i++)
   {
-    sum += cal_word_dep(pCluster->ppWord[i], pCluster->ppWord[serial],
-              pParam);
+    number = pCluster->ppWord[i]->number;
+    if (pScratch->pSeen[number] != pScratch->stamp)
+    {
+      pScratch->pSeen[number] = pScratch->stamp;
+      pScratch->wordNumStr[++distinctConstants] = number;
+    }
   }
-  
-  result = sum / pCluster->constants;
-  
-  return result;
+  pScratch->wordNumStr[0] = distinctConstants;
 }
 
-static double cal_word_weight_function_2(struct Cluster *pCluster, int serial,
-                  struct Parameters *pParam)
+/* For every constant w of the cluster, pSum[w's position] is set to the sum of
+ dependency(u, w) for u in wordNumStr[1...wordNumStr[0]], where
+ 
+ dependency(u, w) = (times w appears with u) / (times u appears),
+ 
+ both read from the word dependency matrix. The terms are added in the order
+ of wordNumStr[], so the sums are the same as adding them one by one. */
+static void sum_word_deps(struct Cluster *pCluster, 
+        struct JoinScratch *pScratch, struct Parameters *pParam)
 {
-  double sum;
-  int i;
-  double result;
-  
-  sum = 0;
+  wordnumber_t *pMatrixRow;
+  wordnumber_t *pRow;
+  double *pSum;
+  double uTotal;
+  int i, j, constants;
   
-  if (pCluster != pParam->pCurrentCluster)
-  {
-    //get all unique frequent words
-    get_unique_frequent_words_out_of_cluster(pCluster, pParam);
-  }
-  
-  if (pParam->wordNumStr[0] < 1)
-  {
-    i = 0; //debugpoint;
-  }
+  pRow = pScratch->pRow;
+  pSum = pScratch->pSum;
+  constants = pCluster->constants;
   
-  if (pParam->wordNumStr[0] == 1)
+  for (i = 1; i <= constants; i++)
   {
-    i = 0; //debug breakpoint
-    return 1;
+    pSum[i] = 0;
   }
   
-  for (i = 1; i <= pParam->wordNumStr[0]; i++)
+  for (j = 1; j <= (int) pScratch->wordNumStr[0]; j++)
   {
-    sum += cal_word_dep_number_version(pParam->wordNumStr[i],
-                       pCluster->ppWord[serial]->number, pParam);
-  }
-  
-  result = (double) (sum - 1) / (pParam->wordNumStr[0] - 1);
-  
-  return result;
-}
-
-static double cal_word_dep(struct Elem *word1, struct Elem *word2,
-          struct Parameters *pParam)
-{
-  double dependency;
-  
-  //how many times word1 appears in log files.
-  wordnumber_t word1Total;
-  
-  //how many times word2 appears with word1.
-  wordnumber_t word2NumInWord1;
-  
-  
-  word1Total = pParam->wordDepMatrix[word1->number *
-                     pParam->wordDepMatrixBreadth +
-                     word1->number];
-  
-  word2NumInWord1 = pParam->wordDepMatrix[word1->number *
-                      pParam->wordDepMatrixBreadth +
-                      word2->number];
-  
-  dependency = (double) word2NumInWord1 / word1Total;
-  
-  return dependency;
-}
-
-static void get_unique_frequent_words_out_of_cluster(struct Cluster *pCluster,
-                        struct Parameters *pParam)
-{
-  int i;
-  int distinctConstants;
-  
-  distinctConstants = 0;
-  
-  for (i = 1; i <= pCluster->constants; i++)
-  {
-    distinctConstants++;
-    if (is_word_repeated(pParam->wordNumStr, pCluster->ppWord[i]->number,
-               distinctConstants))
+    pMatrixRow = pParam->wordDepMatrix + 
+        pScratch->wordNumStr[j] * pParam->wordDepMatrixBreadth;
+    uTotal = (double) pMatrixRow[pScratch->wordNumStr[j]];
+    
+    /* Gather the row segment of this cluster's constants. */
+    for (i = 1; i <= constants; i++)
     {
-      distinctConstants--;
+      pRow[i] = pMatrixRow[pCluster->ppWord[i]->number];
     }
-    else
+    
+    for (i = 1; i <= constants; i++)
     {
-      pParam->wordNumStr[i] = pCluster->ppWord[i]->number;
+      pSum[i] += (double) pRow[i] / uTotal;
     }
   }
-  pParam->wordNumStr[0] = distinctConstants;
-  
-  pParam->pCurrentCluster = pCluster;
-}
-
-/* Redundant function. Parameters are words, instead of the {struct Elem}
- pointer. */
-static double cal_word_dep_number_version(wordnumber_t word1num, 
-        wordnumber_t word2num, struct Parameters *pParam)
-{
-  double dependency;
-  
-  //how many times word1 appears in log files.
-  wordnumber_t word1Total;
-  
-  //how many times word2 appears with word1.
-  wordnumber_t word2NumInWord1;
-  
-  
-  word1Total = pParam->wordDepMatrix[word1num * pParam->wordDepMatrixBreadth +
-                     word1num];
-  
-  word2NumInWord1 = pParam->wordDepMatrix[word1num *
-                      pParam->wordDepMatrixBreadth +
-                      word2num];
-  
-  dependency = (double) word2NumInWord1 / word1Total;
-  
-  return dependency;
 }
 
-static void join_cluster_with_token(struct Cluster *pCluster,
+/* The joined cluster is identified by the word numbers of its constants, where
+ every token is 0 (frequent words are numbered from 1). The joined clusters are
+ kept in their own table, so joining does not build string keys, and does not
+ depend on the size of the cluster hash table. */
+static void join_cluster_with_token(struct Cluster *pCluster, char *pMarker,
                struct Parameters *pParam)
 {
-  char key[MAXKEYLEN];
-  int i, len;
-  struct Elem *pElem;
+  wordnumber_t key[MAXWORDS + 1];
+  struct ClusterWithToken **ppSlot, *ptr;
+  unsigned long hash;
+  int i;
   
   pParam->joinedClusterInputNum++;
   
-  *key = 0;
+  hash = (unsigned long) pCluster->constants;
   
   for (i = 1; i <= pCluster->constants; i++)
   {
-    if (pParam->tokenMarker[i] == 0)
+    if (pMarker[i] == 0)
     {
-      strcat(key, pCluster->ppWord[i]->pKey);
+      key[i] = pCluster->ppWord[i]->number;
     }
     else
     {
-      strcat(key, pParam->token);
+      key[i] = 0;
     }
-    len = (int) strlen(key);
-    key[len] = CLUSTERSEP;
-    key[len + 1] = 0;
+    hash = (hash ^ (unsigned long) key[i]) * JOINED_HASH_PRIME;
   }
+  hash ^= hash >> 29;
   
-  pElem = add_elem(key, pParam->ppClusterTable, pParam->clusterTableSize,
-           pParam->clusterTableSeed, pParam);
+  ppSlot = find_joined_slot(key, pCluster->constants, hash, pParam);
+  ptr = *ppSlot;
   
-  if (pElem->count == 1)
+  if (ptr == 0)
   {
     pParam->joinedClusterOutputNum++;
     //create cluster_with_token instance
-    create_cluster_with_token_instance(pCluster, pElem, pParam);
+    ptr = create_cluster_with_token_instance(pCluster, key, hash, pParam);
+    *ppSlot = ptr;
+    
+    if (pParam->joinedClusterOutputNum * 2 > pParam->joinedTableSize)
+    {
+      grow_joined_table(pParam);
+    }
   }
   
-  
   //adjust this instance
-  adjust_cluster_with_token_instance(pCluster, pElem, pParam);
+  adjust_cluster_with_token_instance(pCluster, pMarker, ptr, pParam);
 }
 
-static struct ClusterWithToken *create_cluster_with_token_instance(
-  struct Cluster *pCluster, struct Elem *pElem, struct Parameters *pParam)
+/* Returns the slot of the joined cluster with key pKey[1...constants] in
+ pParam->ppJoinedTable, or the empty slot where it should be inserted. The table
+ is never full, so linear probing always ends. */
+static struct ClusterWithToken **find_joined_slot(wordnumber_t *pKey,
+        int constants, unsigned long hash, struct Parameters *pParam)
 {
   struct ClusterWithToken *ptr;
-  int i;
+  tableindex_t mask, slot;
   
-  ptr = (struct ClusterWithToken *) malloc(sizeof(struct ClusterWithToken));
-  if (!ptr)
+  mask = pParam->joinedTableSize - 1;
+  
+  for (slot = hash & mask; (ptr = pParam->ppJoinedTable[slot]);
+      slot = (slot + 1) & mask)
   {
-    log_msg(MALLOC_ERR_6010, LOG_ERR, pParam);
-    exit(1);
+    if (ptr->hash == hash && ptr->constants == constants &&
+        !memcmp(ptr->pKey + 1, pKey + 1, constants * sizeof(wordnumber_t)))
+    {
+      break;
+    }
   }
   
-  ptr->ppWord = (struct Elem **) malloc((pCluster->constants + 1) * 
-          sizeof(struct Elem *));
-  if (!ptr->ppWord)
+  return pParam->ppJoinedTable + slot;
+}
+
+static void grow_joined_table(struct Parameters *pParam)
+{
+  struct ClusterWithToken **ppOld, *ptr;
+  tableindex_t oldSize, mask, slot, i;
+  
+  ppOld = pParam->ppJoinedTable;
+  oldSize = pParam->joinedTableSize;
+  
+  pParam->joinedTableSize = oldSize * 2;
+  pParam->ppJoinedTable = (struct ClusterWithToken **) calloc(
+      pParam->joinedTableSize, sizeof(struct ClusterWithToken *));
+  if (!pParam->ppJoinedTable)
   {
-    log_msg(MALLOC_ERR_6010, LOG_ERR, pParam);
+    log_msg(MALLOC_ERR_6030, LOG_ERR, pParam);
     exit(1);
   }
   
-  ptr->ppToken = (struct Token **) malloc((pCluster->constants + 1) * 
-          sizeof(struct Token *));
-  if (!ptr->ppToken)
+  mask = pParam->joinedTableSize - 1;
+  
+  for (i = 0; i < oldSize; i++)
   {
-    log_msg(MALLOC_ERR_6010, LOG_ERR, pParam);
-    exit(1);
+    if ((ptr = ppOld[i]))
+    {
+      for (slot = ptr->hash & mask; pParam->ppJoinedTable[slot];
+          slot = (slot + 1) & mask);
+      pParam->ppJoinedTable[slot] = ptr;
+    }
   }
   
-	ptr->fullWildcard = (int *) malloc(2 * (pCluster->constants + 1) * 
-          sizeof(int));
-  if (!ptr->fullWildcard)
+  free((void *) ppOld);
+}
+
+/* The struct and its arrays are allocated in one block, and released with one
+ free(). */
+static struct ClusterWithToken *create_cluster_with_token_instance(
+  struct Cluster *pCluster, wordnumber_t *pKey, unsigned long hash,
+  struct Parameters *pParam)
+{
+  struct ClusterWithToken *ptr;
+  char *pBlock;
+  int i, slots;
+  
+  slots = pCluster->constants + 1;
+  
+  pBlock = (char *) malloc(sizeof(struct ClusterWithToken) +
+          slots * (sizeof(struct Elem *) + sizeof(struct TokenSet) +
+          sizeof(wordnumber_t) + 2 * sizeof(int)));
+  if (!pBlock)
   {
     log_msg(MALLOC_ERR_6010, LOG_ERR, pParam);
     exit(1);
   }
-	
+  
+  ptr = (struct ClusterWithToken *) pBlock;
+  pBlock += sizeof(struct ClusterWithToken);
+  ptr->ppWord = (struct Elem **) pBlock;
+  pBlock += slots * sizeof(struct Elem *);
+  ptr->pTokens = (struct TokenSet *) pBlock;
+  pBlock += slots * sizeof(struct TokenSet);
+  ptr->pKey = (wordnumber_t *) pBlock;
+  pBlock += slots * sizeof(wordnumber_t);
+  ptr->fullWildcard = (int *) pBlock;
+  
   //Initialization..
   ptr->ppWord[0] = 0; //reserved..
-  ptr->ppToken[0] = 0; //reserved..
+  ptr->pKey[0] = 0; //reserved..
+  
+  for (i = 0; i <= pCluster->constants; i++)
+  {
+    ptr->pTokens[i].ppWord = 0;
+    ptr->pTokens[i].num = 0;
+    ptr->pTokens[i].size = 0;
+  }
   
   for (i = 1; i <= pCluster->constants; i++)
   {
     ptr->ppWord[i] = pCluster->ppWord[i];
+    ptr->pKey[i] = pKey[i];
     ptr->fullWildcard[i * 2] = pCluster->fullWildcard[i * 2];
     ptr->fullWildcard[i * 2 + 1] = pCluster->fullWildcard[i * 2 + 1];
-    ptr->ppToken[i] = 0;
   }
   
   ptr->fullWildcard[0] = pCluster->fullWildcard[0];
@@ -416,38 +570,28 @@ static struct ClusterWithToken *create_cluster_with_token_instance(
   
   ptr->constants = pCluster->constants;
   ptr->count = 0;
-  ptr->bIsJoined = pCluster->bIsJoined;
-  ptr->pLastNode = pCluster->pLastNode;
+  ptr->hash = hash;
   
-  //Build bidirectional link.
-  //Type converted to (struct Cluster *) here. Should not cause a probelm.
-  pElem->pCluster = (struct Cluster *) ptr;
-  ptr->pElem = pElem;
+  ptr->elem.pKey = 0;
+  ptr->elem.count = 0;
+  ptr->elem.number = 0;
+  ptr->elem.pCluster = 0;
+  ptr->elem.pNext = 0;
   
   //Find a organized palce to store the ptrs.
-  if (pParam->pClusterWithTokenFamily[ptr->constants])
-  {
-    ptr->pNext = pParam->pClusterWithTokenFamily[ptr->constants];
-    pParam->pClusterWithTokenFamily[ptr->constants] = ptr;
-  }
-  else
-  {
-    ptr->pNext = 0;
-    pParam->pClusterWithTokenFamily[ptr->constants] = ptr;
-  }
+  ptr->pNext = pParam->pClusterWithTokenFamily[ptr->constants];
+  pParam->pClusterWithTokenFamily[ptr->constants] = ptr;
   
   return ptr;
 }
 
 static void adjust_cluster_with_token_instance(struct Cluster *pCluster,
-                    struct Elem *pElem, struct Parameters *pParam)
+        char *pMarker, struct ClusterWithToken *ptr, struct Parameters *pParam)
 {
-  struct ClusterWithToken *ptr;
-  struct Token *ptrToken;
+  struct TokenSet *pTokenSet;
+  struct Elem **ppWord;
   int i;
   
-  ptr = (struct ClusterWithToken *) pElem->pCluster;
-  
   ptr->count += pCluster->count;
   
   for (i = 0; i <= ptr->constants; i++)
@@ -465,34 +609,30 @@ static void adjust_cluster_with_token_instance(struct Cluster *pCluster,
   
   for (i = 1; i <= ptr->constants; i++)
   {
-    if (pParam->tokenMarker[i] == 1)
+    if (pMarker[i] == 1)
     {
-      //debug here..20160224
-      
       if (check_if_token_key_is_exist(ptr, i, pCluster->ppWord[i]))
       {
         //Repeated word will not be added as a new token.
         continue;
       }
       
-      ptrToken = (struct Token *) malloc(sizeof(struct Token));
-      if (!ptrToken)
-      {
-        log_msg(MALLOC_ERR_6011, LOG_ERR, pParam);
-        exit(1);
-      }
-      ptrToken->pWord = pCluster->ppWord[i];
+      pTokenSet = ptr->pTokens + i;
       
-      if (ptr->ppToken[i])
+      if (pTokenSet->num == pTokenSet->size)
       {
-        ptrToken->pNext = ptr->ppToken[i];
-        ptr->ppToken[i] = ptrToken;
-      }
-      else
-      {
-        ptrToken->pNext = 0;
-        ptr->ppToken[i] = ptrToken;
+        pTokenSet->size = pTokenSet->size ? pTokenSet->size * 2 : 4;
+        ppWord = (struct Elem **) realloc((void *) pTokenSet->ppWord,
+                          pTokenSet->size * sizeof(struct Elem *));
+        if (!ppWord)
+        {
+          log_msg(MALLOC_ERR_6011, LOG_ERR, pParam);
+          exit(1);
+        }
+        pTokenSet->ppWord = ppWord;
       }
+      
+      pTokenSet->ppWord[pTokenSet->num++] = pCluster->ppWord[i];
     }
   }
   
@@ -501,17 +641,17 @@ static void adjust_cluster_with_token_instance(struct Cluster *pCluster,
 static int check_if_token_key_is_exist(struct ClusterWithToken *ptr, int serial,
                 struct Elem *pElem)
 {
-  struct Token *pToken;
+  struct TokenSet *pTokenSet;
+  int i;
   
-  pToken = ptr->ppToken[serial];
-  while (pToken)
+  pTokenSet = ptr->pTokens + serial;
+  for (i = 0; i < pTokenSet->num; i++)
   {
-    if (pToken->pWord == pElem)
+    if (pTokenSet->ppWord[i] == pElem)
     {
       return 1;
     }
-    pToken = pToken->pNext;
   }
   
   return 0;
-}
\ No newline at end of file
+}
@@ -27,78 +27,66 @@
 #include "common_header.h"
 #include "line_processing.h"
 
-#include <regex.h>     /* for regcomp() and regexec() */
-#include <time.h>      /* for time() and ctime() */
 #include <string.h>    /* for strcmp(), strcpy(), etc. */
 
 #include "utility.h"
 #include "output.h"
+#include "regex_backend.h"
 
-static int find_words_debug_0_1(char *line, char (*words)[MAXWORDLEN],
-             struct Parameters *pParam);
-static int find_words_debug_2(char *line, char (*words)[MAXWORDLEN],
-             struct Parameters *pParam);
-static int find_words_debug_3(char *line, char (*words)[MAXWORDLEN],
+static char *convert_line_with_template(char *line, int linelen,
+             regmatch_t *match, struct LineParser *pParser,
              struct Parameters *pParam);
 
-/* The three sub functions can be integrated into one function. However, for
- the sake of performance and code readability, they are divided. When making
- changes to one function, don't forget to also change the corresponding lines
- in the other two functions. Sorry for this inconvenient design. It will be
- fixed in the following updates (considering to integrate all these 
- possibilities, regardless of readability. Or some other better upcoming 
- solutions). */
-/* The words in one log line will be copied to char (*words)[MAXWORDLEN] for 
- later process. Returns the number of words in one log line. */
-int find_words(char *line, char (*words)[MAXWORDLEN], struct Parameters *pParam)
+/* Allocates the working storage of a thread for processing lines. */
+void line_parser_init(struct LineParser *pParser, struct Parameters *pParam)
 {
-  switch (pParam->debug)
+  regex_match_init(pParser, pParam);
+  
+  pParser->pWordFilterCache = 0;
+  *pParser->tmpStr = 0;
+  pParser->pTemplateBuffer = 0;
+  
+  if (pParam->templateBufferSize)
   {
-    case 0:
-    case 1:
-      return find_words_debug_0_1(line, words, pParam);
-      break;
-    case 2:
-      return find_words_debug_2(line, words, pParam);
-      break;
-    case 3:
-      return find_words_debug_3(line, words, pParam);
-      break;
-    default:
-      break;
+    pParser->pTemplateBuffer = (char *) malloc(pParam->templateBufferSize);
+    if (!pParser->pTemplateBuffer)
+    {
+      log_msg(MALLOC_ERR_6023, LOG_ERR, pParam);
+      exit(1);
+    }
   }
-  
-  return 0;
 }
 
-int is_word_repeated(wordnumber_t *storage, wordnumber_t wordNumber, int serial)
+void line_parser_free(struct LineParser *pParser)
 {
-  int i;
+  tableindex_t i;
   
-  for (i = 1; i < serial; i++)
+  regex_match_free(pParser);
+  
+  free((void *) pParser->pTemplateBuffer);
+  pParser->pTemplateBuffer = 0;
+  
+  if (pParser->pWordFilterCache)
   {
-    if (storage[i] == wordNumber)
+    for (i = 0; i < DEF_WFILTER_CACHE_SIZE; i++)
     {
-      return 1;
+      free((void *) pParser->pWordFilterCache[i].pKey);
     }
+    free((void *) pParser->pWordFilterCache);
+    pParser->pWordFilterCache = 0;
   }
-  
-  return 0;
 }
 
-/* When making changes to this function, don't forget to also change the 
- corresponding lines in the other two brother functions. They are:
- find_words_debug_0_1(), find_words_debug_2(), find_words_debug_3(). 
- For the sake of computing performance, sorry for this inconvenience. It will
- be fixed with better solution in the following updates. */
-static int find_words_debug_0_1(char *line, char (*words)[MAXWORDLEN],
-             struct Parameters *pParam)
+/* The words in one log line will be copied to char (*words)[MAXWORDLEN] for 
+ later process. Returns the number of words in one log line.
+ Progress reporting ('--debug' level 2 and 3) is done out of band by a
+ reporter thread (see progress.c), so there is no per-line cost for it here. */
+int find_words(char *line, char (*words)[MAXWORDLEN], 
+        struct LineParser *pParser, struct Parameters *pParam)
 {
   regmatch_t match[MAXPARANEXPR];
   
-  int i, j, linelen, len;
-  struct TemplElem *ptr;
-  char *buffer = NULL;
+  int i, j, linelen;
   
   if (*line == 0)
   {
@@ -118,74 +106,23 @@ static int find_words_debug_0_1(char *line, char (*words)[MAXWORDLEN],
   
   if (pParam->pFilter)
   {
-    if (regexec(&pParam->filter_regex, line, MAXPARANEXPR, match, 0))
+    if (regex_exec(&pParam->filter_regex, line, MAXPARANEXPR, match,
+                   pParser))
     {
       return 0;
     }
     
     if (pParam->pTemplate)
     {
-      
-      len = 0;
-      
-      for (ptr = pParam->pTemplate; ptr; ptr = ptr->pNext)
-      {
-        if (ptr->pStr)
-        {
-          len += ptr->data;
-        }
-        else if (!ptr->data)
-        {
-          len += linelen;
-        }
-        else if (match[ptr->data].rm_so != -1  &&
-             match[ptr->data].rm_eo != -1)
-        {
-          len += match[ptr->data].rm_eo - match[ptr->data].rm_so;
-        }
-      }
-      
-      i = 0;
-      //free((void *) buffer);
-      buffer = (char *) malloc(len + 1);
-      if (!buffer)
-      {
-        log_msg(MALLOC_ERR_6008, LOG_ERR, pParam);
-        exit(1);
-      }
-      
-      for (ptr = pParam->pTemplate; ptr; ptr = ptr->pNext)
-      {
-        
-        if (ptr->pStr)
-        {
-          strncpy(buffer + i, ptr->pStr, ptr->data);
-          i += ptr->data;
-        }
-        else if (!ptr->data)
-        {
-          strncpy(buffer + i, line, linelen);
-          i += linelen;
-        }
-        else if (match[ptr->data].rm_so != -1  &&
-             match[ptr->data].rm_eo != -1)
-        {
-          len = (int) (match[ptr->data].rm_eo -
-                 match[ptr->data].rm_so);
-          strncpy(buffer + i, line + match[ptr->data].rm_so, len);
-          i += len;
-        }
-      }
-      
-      buffer[i] = 0;
-      line = buffer;
+      line = convert_line_with_template(line, linelen, match, pParser,
+                        pParam);
     }
     
   }
   
   for (i = 0; i < MAXWORDS; ++i)
   {
-    if (regexec(&pParam->delim_regex, line, 1, match, 0))
+    if (regex_exec(&pParam->delim_regex, line, 1, match, pParser))
     {  /* This is the last word. */
       for (j = 0; line[j] != 0; j++)
       {
@@ -211,11 +148,6 @@ static int find_words_debug_0_1(char *line, char (*words)[MAXWORDLEN],
     }
   }
   
-  if (pParam->pTemplate)
-  {
-    free((void *) buffer);
-  }
-  
   /* Return the word numbers in the line, including the repeated ones. */
   if (i == MAXWORDS)
   {
@@ -227,337 +159,99 @@ static int find_words_debug_0_1(char *line, char (*words)[MAXWORDLEN],
   }
 }
 
-/* When making changes to this function, don't forget to also change the 
- corresponding lines in the other two brother functions. They are:
- find_words_debug_0_1(), find_words_debug_2(), find_words_debug_3(). 
- For the sake of computing performance, sorry for this inconvenience. It will
- be fixed with better solution in the following updates. */
-static int find_words_debug_2(char *line, char (*words)[MAXWORDLEN],
-             struct Parameters *pParam)
+/* Read one line from the input file, and remove the trailing newline. *pPos
+ is the offset of the line in the file, and is moved past it. Returns the
+ number of bytes read, which the caller counts for progress reporting, or -1
+ at the end of file. A line that contains a '\0' byte is cut there, the same
+ as in chunk_reader_read_line(), but all of its bytes are counted. */
+int read_line(char *line, FILE *pFile, long long *pPos,
+        struct Parameters *pParam)
 {
-  regmatch_t match[MAXPARANEXPR];
-  
-  int i, j, linelen, len;
-  struct TemplElem *ptr;
-  char *buffer = NULL;
+  long long pos;
+  int len;
   
-  //debug2
-  static support_t linecnt = 0;
-  char logStr[MAXLOGMSGLEN];
-  char digit[MAXDIGITBIT];
-  double pct;
-  
-  if (*line == 0)
+  if (!fgets(line, MAXLINELEN, pFile))
   {
-    return 0;
+    return -1;
   }
   
-  linelen = (int) strlen(line);
-  
-  
-  if (pParam->byteOffset >= linelen)  { return 0; }
-  
-  if (pParam->byteOffset)
-  {
-    line += pParam->byteOffset;
-    linelen -= pParam->byteOffset;
-  }
+  len = (int) strlen(line);
   
-  if (pParam->pFilter)
+  if (!(len && line[len - 1] == '\n') && len != MAXLINELEN - 1)
   {
-    if (regexec(&pParam->filter_regex, line, MAXPARANEXPR, match, 0))
+    /* A short piece without newline is either the end of the file, or
+     contains a '\0' byte, which strlen() does not count. fgets() has still
+     read the rest of the piece into line. A pipe has no position, then only
+     the bytes before the '\0' are counted. */
+    pos = (long long) ftello(pFile);
+    if (pos >= 0)
     {
-      return 0;
+      len = (int) (pos - *pPos);
     }
-    
-    if (pParam->pTemplate)
-    {
-      
-      len = 0;
-      
-      for (ptr = pParam->pTemplate; ptr; ptr = ptr->pNext)
-      {
-        if (ptr->pStr)
-        {
-          len += ptr->data;
-        }
-        else if (!ptr->data)
-        {
-          len += linelen;
-        }
-        else if (match[ptr->data].rm_so != -1  &&
-             match[ptr->data].rm_eo != -1)
-        {
-          len += match[ptr->data].rm_eo - match[ptr->data].rm_so;
-        }
-      }
-      
-      i = 0;
-      //free((void *) buffer);
-      buffer = (char *) malloc(len + 1);
-      if (!buffer)
-      {
-        log_msg(MALLOC_ERR_6008, LOG_ERR, pParam);
-        exit(1);
-      }
-      
-      for (ptr = pParam->pTemplate; ptr; ptr = ptr->pNext)
-      {
-        
-        if (ptr->pStr)
-        {
-          strncpy(buffer + i, ptr->pStr, ptr->data);
-          i += ptr->data;
-        }
-        else if (!ptr->data)
-        {
-          strncpy(buffer + i, line, linelen);
-          i += linelen;
-        }
-        else if (match[ptr->data].rm_so != -1  &&
-             match[ptr->data].rm_eo != -1)
-        {
-          len = (int) (match[ptr->data].rm_eo -
-                 match[ptr->data].rm_so);
-          strncpy(buffer + i, line + match[ptr->data].rm_so, len);
-          i += len;
-        }
-      }
-      
-      buffer[i] = 0;
-      line = buffer;
-    }
-    
   }
   
-  for (i = 0; i < MAXWORDS; ++i)
-  {
-    if (regexec(&pParam->delim_regex, line, 1, match, 0))
-    {  /* This is the last word. */
-      for (j = 0; line[j] != 0; j++)
-      {
-        words[i][j] = line[j];
-      }
-      words[i][j] = 0;
-      
-      break;
-    }
-    
-    for (j = 0; j < match[0].rm_so; ++j)
-    {
-      words[i][j] = line[j];
-    }
-    
-    words[i][j] = 0;
-    
-    line += match[0].rm_eo;
-    
-    if (*line == 0)
-    {
-      break;
-    }
-  }
+  *pPos += len;
   
-  if (pParam->pTemplate)
+  if (len && line[len - 1] == '\n')
   {
-    free((void *) buffer);
+    line[len - 1] = 0;
   }
   
-  //debug_2
-  linecnt++;
-  if (linecnt % DEBUG_2_INTERVAL == 0)
+  return len;
+}
+
+int is_word_repeated(wordnumber_t *storage, wordnumber_t wordNumber, int serial)
+{
+  int i;
+  
+  for (i = 1; i < serial; i++)
   {
-    str_format_int_grouped(digit, linecnt);
-    if (pParam->totalLineNum)
-    {
-      pct = (double) linecnt / pParam->totalLineNum;
-      sprintf(logStr, "%.2f%% Finished. - %s lines out of %s", pct * 100,
-          digit, pParam->totalLineNumDigit);
-    }
-    else
+    if (storage[i] == wordNumber)
     {
-      sprintf(logStr, "UNKNOWN%% Finished. - %s lines out of UNKNOWN.",
-          digit);
+      return 1;
     }
-    
-    log_msg(logStr, LOG_DEBUG, pParam);
   }
   
-  /* Return the word numbers in the line, including the repeated ones. */
-  if (i == MAXWORDS)
-  {
-    return i;
-  }
-  else
-  {
-    return i+1;
-  }
+  return 0;
 }
 
-/* When making changes to this function, don't forget to also change the 
- corresponding lines in the other two brother functions. They are:
- find_words_debug_0_1(), find_words_debug_2(), find_words_debug_3(). 
- For the sake of computing performance, sorry for this inconvenience. It will
- be fixed with better solution in the following updates. */
-static int find_words_debug_3(char *line, char (*words)[MAXWORDLEN],
+/* Convert the line according to the compiled template ('--template' option),
+ after '--lfilter' regular expression has matched it. The result is written
+ into the reusable pTemplateBuffer, which is big enough for any line, thus
+ no memory allocation is needed per line. */
+static char *convert_line_with_template(char *line, int linelen,
+             regmatch_t *match, struct LineParser *pParser,
              struct Parameters *pParam)
 {
-  regmatch_t match[MAXPARANEXPR];
-  
-  int i, j, linelen, len;
-  struct TemplElem *ptr;
-  char *buffer = NULL;
-  
-  //debug3
-  static support_t linecnt = 0;
-  char logStr[MAXLOGMSGLEN];
-  char digit[MAXDIGITBIT];
-  double pct;
-  
-  if (*line == 0)
-  {
-    return 0;
-  }
+  struct TemplInstr *pInstr, *pEnd;
+  char *buffer;
+  int len;
   
-  linelen = (int) strlen(line);
-  
-  
-  if (pParam->byteOffset >= linelen)  { return 0; }
+  buffer = pParser->pTemplateBuffer;
+  pEnd = pParam->pTemplateInstr + pParam->templateInstrNum;
   
-  if (pParam->byteOffset)
+  for (pInstr = pParam->pTemplateInstr; pInstr < pEnd; pInstr++)
   {
-    line += pParam->byteOffset;
-    linelen -= pParam->byteOffset;
-  }
-  
-  if (pParam->pFilter)
-  {
-    if (regexec(&pParam->filter_regex, line, MAXPARANEXPR, match, 0))
+    if (pInstr->pStr)
     {
-      return 0;
+      memcpy(buffer, pInstr->pStr, pInstr->data);
+      buffer += pInstr->data;
     }
-    
-    if (pParam->pTemplate)
+    else if (!pInstr->data)
     {
-      
-      len = 0;
-      
-      for (ptr = pParam->pTemplate; ptr; ptr = ptr->pNext)
-      {
-        if (ptr->pStr)
-        {
-          len += ptr->data;
-        }
-        else if (!ptr->data)
-        {
-          len += linelen;
-        }
-        else if (match[ptr->data].rm_so != -1  &&
-             match[ptr->data].rm_eo != -1)
-        {
-          len += match[ptr->data].rm_eo - match[ptr->data].rm_so;
-        }
-      }
-      
-      i = 0;
-      //free((void *) buffer);
-      buffer = (char *) malloc(len + 1);
-      if (!buffer)
-      {
-        log_msg(MALLOC_ERR_6008, LOG_ERR, pParam);
-        exit(1);
-      }
-      
-      for (ptr = pParam->pTemplate; ptr; ptr = ptr->pNext)
-      {
-        
-        if (ptr->pStr)
-        {
-          strncpy(buffer + i, ptr->pStr, ptr->data);
-          i += ptr->data;
-        }
-        else if (!ptr->data)
-        {
-          strncpy(buffer + i, line, linelen);
-          i += linelen;
-        }
-        else if (match[ptr->data].rm_so != -1  &&
-             match[ptr->data].rm_eo != -1)
-        {
-          len = (int) (match[ptr->data].rm_eo -
-                 match[ptr->data].rm_so);
-          strncpy(buffer + i, line + match[ptr->data].rm_so, len);
-          i += len;
-        }
-      }
-      
-      buffer[i] = 0;
-      line = buffer;
+      memcpy(buffer, line, linelen);
+      buffer += linelen;
     }
-    
-  }
-  
-  for (i = 0; i < MAXWORDS; ++i)
-  {
-    if (regexec(&pParam->delim_regex, line, 1, match, 0))
-    {  /* This is the last word. */
-      for (j = 0; line[j] != 0; j++)
-      {
-        words[i][j] = line[j];
-      }
-      words[i][j] = 0;
-      
-      break;
-    }
-    
-    for (j = 0; j < match[0].rm_so; ++j)
+    else if (match[pInstr->data].rm_so != -1  &&
+         match[pInstr->data].rm_eo != -1)
     {
-      words[i][j] = line[j];
+      len = (int) (match[pInstr->data].rm_eo - match[pInstr->data].rm_so);
+      memcpy(buffer, line + match[pInstr->data].rm_so, len);
+      buffer += len;
     }
-    
-    words[i][j] = 0;
-    
-    line += match[0].rm_eo;
-    
-    if (*line == 0)
-    {
-      break;
-    }
-  }
-  
-  if (pParam->pTemplate)
-  {
-    free((void *) buffer);
   }
   
-  //debug_3
-  linecnt++;
-  if (time(0) != pParam->timeStorage && time(0) % DEBUG_3_INTERVAL == 0)
-  {
-    pParam->timeStorage = time(0);
-    str_format_int_grouped(digit, linecnt);
-    if (pParam->totalLineNum)
-    {
-      pct = (double) linecnt / pParam->totalLineNum;
-      sprintf(logStr, "%.2f%% Finished. - %s lines out of %s", pct * 100,
-          digit, pParam->totalLineNumDigit);
-    }
-    else
-    {
-      sprintf(logStr, "UNKNOWN%% Finished. - %s lines out of UNKNOWN.",
-          digit);
-    }
-    
-    log_msg(logStr, LOG_DEBUG, pParam);
-  }
+  *buffer = 0;
   
-  /* Return the word numbers in the line, including the repeated ones. */
-  if (i == MAXWORDS)
-  {
-    return i;
-  }
-  else
-  {
-    return i+1;
-  }
-}
\ No newline at end of file
+  return pParser->pTemplateBuffer;
+}
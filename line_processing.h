@@ -30,7 +30,12 @@
 extern "C" {
 #endif
 
-int find_words(char *line, char (*words)[MAXWORDLEN], struct Parameters *pParam);
+void line_parser_init(struct LineParser *pParser, struct Parameters *pParam);
+void line_parser_free(struct LineParser *pParser);
+int find_words(char *line, char (*words)[MAXWORDLEN], 
+        struct LineParser *pParser, struct Parameters *pParam);
+int read_line(char *line, FILE *pFile, long long *pPos,
+        struct Parameters *pParam);
 int is_word_repeated(wordnumber_t *storage, wordnumber_t wordNumber, int serial);
 
 #ifdef __cplusplus
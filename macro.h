@@ -43,6 +43,9 @@ extern "C" {
 /* Maximum number of words in one line. */
 #define MAXWORDS 512
 
+/* Maximum number of threads ('--threads' option). */
+#define MAXTHREADS 256
+
 /* Maximum log message length. */
 #define MAXLOGMSGLEN 256
 
@@ -66,17 +69,123 @@ extern "C" {
  is below word weight threshold. */
 #define TOKENLEN 10
 
+/* Nodes of the prefix tree('--aggrsup' option) are allocated in blocks of
+ TRIE_POOL_BLOCK nodes while building. */
+#define TRIE_POOL_BLOCK 4096
+
+/* Every node of the prefix tree('--aggrsup' option) has a 64-bit summary of
+ the frequent words below it. A word with number n sets bit (n mod 64). */
+#define TRIE_BLOOM_BIT(n) (1ULL << ((n) & 63))
+
+/* Engines of '--aggrsup' option ('--aggrengine' option). With 
+ AGGR_ENGINE_AUTO, both the prefix tree and the inverted index are built, and
+ each cluster candidate uses the one that is estimated to be cheaper: the
+ inverted index is chosen if its shortest posting list, multiplied by
+ AGGR_INDEX_COST_FACTOR, is smaller than the prefix tree's subtree to search. */
+#define AGGR_ENGINE_AUTO 0
+#define AGGR_ENGINE_TRIE 1
+#define AGGR_ENGINE_INDEX 2
+#define AGGR_INDEX_COST_FACTOR 4
+
+/* Formats of the cluster output ('--outputformat' option). */
+#define OUTPUT_FORMAT_TEXT 0
+#define OUTPUT_FORMAT_JSONL 1
+#define OUTPUT_FORMAT_TSV 2
+#define OUTPUT_FORMAT_BINARY 3
+
+/* lookup_elems() looks up LOOKUP_GROUP keys at a time, prefetching the
+ slots and elements of the whole group before searching the chains. */
+#define LOOKUP_GROUP 16
+
+/* Number of slots in a hot word cache (struct WordCache), a power of 2. */
+#define WORD_CACHE_SIZE 256
+
+/* A hot word cache is turned off if less than 1/WORD_CACHE_MIN_HIT_DIV of its
+ first WORD_CACHE_PROBE lookups hit. */
+#define WORD_CACHE_PROBE (1 << 16)
+#define WORD_CACHE_MIN_HIT_DIV 8
+
+/* Arrays of TABLE_ALLOC_MIN bytes or more are mapped by table_alloc(), in
+ multiples of TABLE_HUGE_PAGE bytes (the size of the huge pages used with
+ '--hugetlb' option), and first touched in slices of
+ TABLE_TOUCH_SLICE bytes in threaded mode. Their pages are interleaved over
+ at most TABLE_MAX_NODES NUMA nodes (a multiple of the bits of a long). */
+#define TABLE_ALLOC_MIN (4 << 20)
+#define TABLE_HUGE_PAGE (2 << 20)
+#define TABLE_TOUCH_SLICE (2 << 20)
+#define TABLE_MAX_NODES 1024
+
+/* Vocabulary tables of the vocabulary pass ('--vocabtable' option). With
+ VOCAB_TABLE_ORDERED, the words are inserted by one thread in the order of the
+ input (see pipeline.c). With VOCAB_TABLE_SHARED, all threads insert into the
+ same table at once. */
+#define VOCAB_TABLE_ORDERED 0
+#define VOCAB_TABLE_SHARED 1
+
+/* The clusters are formatted into a buffer of CLUSTER_WRITER_BUFFER bytes,
+ which is written out when it is full. CLUSTER_BINARY_VERSION is written in
+ the header of the binary output. */
+#define CLUSTER_WRITER_BUFFER (1 << 20)
+#define CLUSTER_BINARY_VERSION 1
+
+/* Initial size of the joined cluster hash table ('--wweight' option). It must
+ be a power of 2, and it is doubled whenever it becomes half full. */
+#define DEF_JOINED_TABLE_SIZE 1024
+
+/* Multiplier of the joined cluster hash function (64-bit FNV prime). */
+#define JOINED_HASH_PRIME 1099511628211UL
+
+/* The input is split into chunks for the parallel passes, aiming at
+ INPUT_CHUNKS_PER_THREAD chunks for every thread. The chunk size is kept
+ between INPUT_CHUNK_MIN and INPUT_CHUNK_MAX bytes. */
+#define INPUT_CHUNKS_PER_THREAD 8
+#define INPUT_CHUNK_MIN (1LL << 20)
+#define INPUT_CHUNK_MAX (64LL << 20)
+
+/* The per-thread sketches of the sketch passes are added up in slices of
+ SKETCH_MERGE_SLICE slots, which are processed in parallel. */
+#define SKETCH_MERGE_SLICE 65536
+
+/* The passes which update the hash tables run as a pipeline: a reader thread
+ reads batches of at most PIPELINE_BATCH_LINES lines (PIPELINE_BATCH_BYTES
+ bytes), tokenizer threads turn them into records, and the calling thread
+ consumes the records. There are PIPELINE_BATCHES_PER_WORKER batches for
+ every tokenizer. A stage waiting for a batch checks PIPELINE_SPIN times
+ before it sleeps. PIPELINE_BATCH_BYTES must be at least MAXLINELEN. */
+#define PIPELINE_BATCH_LINES 1024
+#define PIPELINE_BATCH_BYTES (1 << 18)
+#define PIPELINE_BATCHES_PER_WORKER 4
+#define PIPELINE_SPIN 1000
+
+/* The output of the outlier pass is written out when OUTLIER_BUFFER_SIZE
+ bytes have been collected, if earlier input has already been written.
+ Otherwise a chunk buffers at most about OUTLIER_BUFFER_MAX bytes before it
+ waits for the earlier chunks. */
+#define OUTLIER_BUFFER_SIZE (1 << 20)
+#define OUTLIER_BUFFER_MAX (4 << 20)
+
 /* Word hash table's default size is 100000. */
 #define DEF_WORD_TABLE_SIZE 100000
 
+/* Number of slots in the '--wfilter/--wsearch/--wreplace' memo cache. Every
+ slot remembers one distinct word, whether it was filtered and what it was
+ rewritten to. When two words collide in a slot, the older one is evicted. */
+#define DEF_WFILTER_CACHE_SIZE 65536
+
 /* InitSeed is default to 1. It is used to generate random numbers, which help
  in the string hashing processes. */
 #define DEF_INIT_SEED 1
 
 /* Debug_2_interval defines after how many lines program status will refresh.
- Debug_3_interval is the time interval(seconds) to refresh status. */
+ Debug_3_interval is the time interval(seconds) to refresh status.
+ Progress_poll_msec is how often(milliseconds) the progress reporter thread
+ checks the line counter in debug level 2. A reader adds its lines and bytes
+ to the shared counters after every PROGRESS_PUBLISH_BYTES bytes, and at the
+ end of its input. */
 #define DEBUG_2_INTERVAL 200000
 #define DEBUG_3_INTERVAL 5
+#define PROGRESS_POLL_MSEC 100
+#define PROGRESS_PUBLISH_BYTES (1 << 18)
 
 /* If --syslog option is given, log messages under or equal to
  DEF_SYSLOG_THRESHOLD will be written to Syslog. Setting it to LOG_NOTICE(5),
@@ -98,6 +207,7 @@ typedef unsigned long support_t;
 typedef unsigned long tableindex_t;
 typedef unsigned long linenumber_t;
 typedef unsigned long wordnumber_t;
+typedef unsigned int trieindex_t;
 
 /* ==== Constant strings ==== */
 
@@ -120,14 +230,21 @@ Options:\n\
 --wsearch=<word_search_regexp>\n\
 --wreplace=<word_replace_string>\n\
 --outliers=<outlier_file>\n\
+--outliercompress=<command>\n\
 --aggrsup\n\
+--aggrengine=<aggregation_engine> (auto, trie, index)\n\
 --debug=<debug_level> (1, 2, 3)\n\
 --byteoffset=<byte_offset>\n\
 --csize=<clustersketch_size>\n\
 --initseed=<seed>\n\
 --wtablesize=<wordtable_size>\n\
 --outputmode=<output_mode> (1)\n\
+--outputformat=<output_format> (text, jsonl, tsv, binary)\n\
+--top=<cluster_number>\n\
 --detailtoken\n\
+--threads=<thread_number>\n\
+--vocabtable=<vocabulary_table> (ordered, shared)\n\
+--hugetlb\n\
 --help, -h\n\
 --version\n\
 \n\
@@ -164,6 +281,9 @@ When clustering log file lines from file(s) given with --input option(s),\n\
 process only lines which match the regular expression. For example,\n\
 --lfilter='sshd\\[\\d+\\]:' finds clusters for log file lines that\n\
 contain the string sshd[<pid>]: (i.e., sshd syslog messages).\n\
+Regular expressions (also in --separator, --wfilter and --wsearch options)\n\
+use Perl compatible syntax if logclusterc was built with PCRE2 library, and\n\
+POSIX extended syntax otherwise. The --version option reports the backend.\n\
 \n\
 --template=<line_conversion_template>\n\
 After the regular expression given with --lfilter option has matched a line,\n\
@@ -181,7 +301,8 @@ sshd[123]: this is a test\n\
 (i.e., the timestamp and hostname of the sshd syslog message are ignored).\n\
 Please note that <line_conversion_template> supports not only numeric\n\
 match variables (such as $2 or ${12}), but also named match variables with\n\
-$+{name} syntax (such as $+{ip} or $+{hostname}).\n\
+$+{name} syntax (such as $+{ip} or $+{hostname}). Named match variables\n\
+require PCRE2 backend.\n\
 This option can not be used without --lfilter option.\n\
 \n\
 --syslog=<syslog_facility>\n\
@@ -261,6 +382,11 @@ while --wsearch and --wreplace are ignored without --wfilter.\n\
 If this option is given, an additional pass over input files is made, in order\n\
 to find outliers. All outlier lines are written to the given file.\n\
 \n\
+--outliercompress=<command>\n\
+The outlier lines are piped through the given shell command, and the output of\n\
+the command is written to the outlier file, e.g. '--outliercompress=gzip -c'.\n\
+This option is effective only with '--outliers' option.\n\
+\n\
 --aggrsup\n\
 If this option is given, for each cluster candidate other candidates are\n\
 identified which represent more specific line patterns. After detecting such\n\
@@ -270,12 +396,22 @@ candidates 'Interface eth0 down' (support 10) and 'Interface eth1 down'\n\
 (support 5) are detected as more specific, the support of 'Interface * down'\n\
 will be set to 35 (20+10+5).\n\
 \n\
+--aggrengine=<aggregation_engine> (auto, trie, index)\n\
+The way '--aggrsup' finds more specific candidates. 'trie' walks a prefix\n\
+tree of all candidates. 'index' intersects the lists of candidates containing\n\
+each word of the given candidate, which is much cheaper for candidates with\n\
+rare words. 'auto' builds both, and chooses the cheaper one for each\n\
+candidate. The results are the same. The default value for the option is\n\
+auto. This option is meaningless without '--aggrsup' option.\n\
+\n\
 --debug=<debug_level> (1,2,3)\n\
 Increase logging verbosity by generating debug output. Debug level 1 displays\n\
 a summary after each phase is done. Debug level 2 displays the processing\n\
 status after every 200,000 lines are analysed. Debug level 3 displays the\n\
-processing status every 5 seconds. When analysing large log files bigger than\n\
-1GB, debug level 2 or 3 is sugguested.\n\
+processing status every 5 seconds. The processing status contains the\n\
+percentage of input bytes processed, throughput and estimated time left.\n\
+When analysing large log files bigger than 1GB, debug level 2 or 3 is\n\
+sugguested.\n\
 For the sake of consistency with Perl version, you can also use this option\n\
 without argument, like '--debug', which will set debug level to 1.\n\
 \n\
@@ -311,6 +447,24 @@ complex.\n\
 You can also use this option with out argument, like '--outputmode', which will\n\
 set output mode to 1.\n\
 \n\
+--outputformat=<output_format> (text, jsonl, tsv, binary)\n\
+The format of the clusters written to standard output. 'text' is the default,\n\
+human readable format. 'jsonl' writes one JSON object per cluster, with its\n\
+id, support, pattern, and the wildcard range and words of every constant.\n\
+Bytes that are not valid UTF-8 are written as \\u0080...\\u00ff.\n\
+'tsv' writes a header line, then the id, support, number of constants and\n\
+pattern of every cluster, separated by tabs. 'binary' writes compact records\n\
+with the same content as 'jsonl'; the layout is described in cluster_writer.c.\n\
+The log messages are written to standard error in all formats.\n\
+\n\
+--top=<cluster_number>\n\
+Print only the given number of clusters with the highest support, which are\n\
+the first clusters of the full output. Only these clusters are sorted, which\n\
+is much faster when there are many clusters. With '--outputmode=1', the\n\
+given number of clusters with the highest support are printed for every\n\
+number of constants, sorted by support. The total number of clusters is\n\
+still reported.\n\
+\n\
 --detailtoken\n\
 If Join_Cluster heuristic('--wweight' option) is used, this option can make the\n\
 output more detailed. For the sake of simplicity, by default, if a token has\n\
@@ -324,6 +478,27 @@ With this option, output is\n\
 (Interface) eth0 (up|down)\n\
 This option is meaningless without '--wweight' option.\n\
 \n\
+--threads=<thread_number>\n\
+The number of threads used by the in-memory phases, which process cluster\n\
+candidates independently of each other (e.g., '--aggrsup'). The results do\n\
+not depend on the number of threads. The default value for the option is 1,\n\
+and the biggest value is 256.\n\
+\n\
+--vocabtable=<vocabulary_table> (ordered, shared)\n\
+The way several threads build the vocabulary. With 'ordered', the lines are\n\
+split into words by all threads, and the words are inserted into the\n\
+vocabulary by one thread in the order of the input. With 'shared', all threads\n\
+insert into the vocabulary at the same time, which is faster with many\n\
+threads. The clusters found are the same, but the order of clusters with\n\
+equal support may differ. The default value for the option is ordered. This\n\
+option is meaningless without '--threads' option.\n\
+\n\
+--hugetlb\n\
+Put the large tables (the word and cluster tables and sketches) into the\n\
+huge pages of 2 MB reserved by the administrator ('vm.nr_hugepages'), if there\n\
+are enough of them. Without this option, reserved huge pages are not used, but\n\
+transparent huge pages are requested for the tables.\n\
+\n\
 --help, or -h\n\
 Print this help.\n\
 \n\
@@ -382,6 +557,27 @@ static char *pSyslogFacilityList[] =
 #define MALLOC_ERR_6018 "malloc() failed. Function: print_clusters_default_1()."
 #define MALLOC_ERR_6019 "malloc() failed. Function: print_clusters_if_join_cluster_default_0()."
 #define MALLOC_ERR_6020 "malloc() failed. Function: __print_clusters_if_join_cluster_default_0()."
+#define MALLOC_ERR_6021 "malloc() failed. Function: regex_compile()."
+#define MALLOC_ERR_6022 "malloc() failed. Function: word_filter_search_replace()."
+#define MALLOC_ERR_6023 "malloc() failed. Function: line_parser_init()."
+#define MALLOC_ERR_6024 "malloc() failed. Function: freeze_prefix_trie()."
+#define MALLOC_ERR_6025 "malloc() failed. Function: parallel_for()."
+#define MALLOC_ERR_6026 "malloc() failed. Function: aggregate_candidates()."
+#define MALLOC_ERR_6027 "malloc() failed. Function: build_candidate_index()."
+#define MALLOC_ERR_6028 "malloc() failed. Function: alloc_trie_node()."
+#define MALLOC_ERR_6029 "malloc() failed. Function: join_cluster()."
+#define MALLOC_ERR_6030 "malloc() failed. Function: grow_joined_table()."
+#define MALLOC_ERR_6031 "malloc() failed. Function: writer_open()."
+#define MALLOC_ERR_6032 "malloc() failed. Function: sort_top_elements()."
+#define MALLOC_ERR_6033 "malloc() failed. Function: print_top_clusters_of_slot()."
+#define MALLOC_ERR_6034 "malloc() failed. Function: plan_input_chunks()."
+#define MALLOC_ERR_6035 "malloc() failed. Function: step_4_find_outliers()."
+#define MALLOC_ERR_6036 "malloc() failed. Function: append_outlier()."
+#define MALLOC_ERR_6037 "malloc() failed. Function: sketch_pass_run()."
+#define MALLOC_ERR_6038 "malloc() failed. Function: sketch_pass_merge()."
+#define MALLOC_ERR_6039 "malloc() failed. Function: pipeline_run()."
+#define MALLOC_ERR_6040 "malloc() failed. Function: pipeline_append()."
+#define MALLOC_ERR_6041 "malloc() failed. Function: table_alloc()."
 
 /* ==== Macro function ==== */
 
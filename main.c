@@ -41,12 +41,14 @@
 #include "output.h"
 #include "free_resource.h"
 #include "utility.h"
+#include "progress.h"
 
 int main(int argc, char **argv)
 {
   struct Parameters param;
   char logStr[MAXLOGMSGLEN];
   char digit[MAXDIGITBIT];
+  char digitBytes[MAXDIGITBIT], digitBuildBytes[MAXDIGITBIT];
   wordnumber_t totalWordNum, outlierNum;
   
   /* ######## #### ## Step0 Preparation ## #### ######## */
@@ -92,7 +94,11 @@ int main(int argc, char **argv)
   /* Step0.F Get times of pass over the data set */
   param.dataPassTimes = step_0_cal_total_pass_over_data_set_times(&param);
   
-  /* Step0.G All is ready. Do the work. */
+  /* Step0.G Start progress reporter */
+  /* Only debug level 2 and 3 start the reporter thread. */
+  progress_start(&param);
+  
+  /* Step0.H All is ready. Do the work. */
   log_msg("Starting...", LOG_NOTICE, &param);
   
   /* ######## #### ## Step1 Frequent Words ## #### ######## */
@@ -103,19 +109,16 @@ int main(int argc, char **argv)
    significantly optimizes memory consumption.*/
   if (param.wordSketchSize)
   {
+    progress_begin_pass("word sketch", &param);
     step_1_create_word_sketch(&param);
-    param.totalLineNum = param.linecount * param.dataPassTimes;
-    str_format_int_grouped(param.totalLineNumDigit, param.totalLineNum);
+    progress_end_pass(&param);
   }
   
   /*Step1.B Create vocabulary*/
   /*Tag: One pass over the data set*/
+  progress_begin_pass("vocabulary", &param);
   totalWordNum = step_1_create_vocabulary(&param);
-  if (!param.totalLineNum)
-  {
-    param.totalLineNum = param.linecount * param.dataPassTimes;
-    str_format_int_grouped(param.totalLineNumDigit, param.totalLineNum);
-  }
+  progress_end_pass(&param);
   
   /*Step1.C Finding frequent words*/
   /*It also santizes word table, moving words under support out of table.*/
@@ -133,6 +136,7 @@ int main(int argc, char **argv)
   /*Step1.E Check frequent word numbers*/
   if (!param.freWordNum)
   {
+    progress_stop(&param);
     free_and_clean_step_0(&param);
     free_and_clean_step_1(&param);
     return 0;
@@ -144,21 +148,31 @@ int main(int argc, char **argv)
   /*Tag: Optional, One pass over the data set*/
   if (param.clusterSketchSize)
   {
+    progress_begin_pass("cluster candidate sketch", &param);
     step_2_create_cluster_candidate_sketch(&param);
+    progress_end_pass(&param);
   }
   
   /*Step2.B Finding cluster candidates*/
   /*Tag: One pass over the data set*/
+  progress_begin_pass("cluster candidates", &param);
   step_2_find_cluster_candidates(&param);
+  progress_end_pass(&param);
   
   /*Step2.C Aggregate support*/
   /*Tag: Optional*/
   if (param.bAggrsupFlag)
   {
     step_2_aggregate_supports(&param);
-    str_format_int_grouped(digit, param.trieNodeNum);
-    sprintf(logStr, "%s nodes in the prefix tree.", digit);
-    log_msg(logStr, LOG_NOTICE, &param);
+    if (param.trieNodeNum)
+    {
+      str_format_int_grouped(digit, param.trieNodeNum);
+      str_format_int_grouped(digitBytes, param.trieBytes);
+      str_format_int_grouped(digitBuildBytes, param.trieBuildBytes);
+      sprintf(logStr, "%s nodes in the prefix tree, %s bytes (%s bytes while "
+          "building).", digit, digitBytes, digitBuildBytes);
+      log_msg(logStr, LOG_NOTICE, &param);
+    }
   }
   
   /*Step2.D Debug_1 mode: print cluster candidates*/
@@ -199,8 +213,10 @@ int main(int argc, char **argv)
   if (param.pOutlier)
   {
     log_msg("Finding outliers...", LOG_NOTICE, &param);
+    progress_begin_pass("outliers", &param);
     
     outlierNum = step_4_find_outliers(&param);
+    progress_end_pass(&param);
     
     str_format_int_grouped(digit, outlierNum);
     sprintf(logStr, "%s outliers were outputted into file %s.", digit,
@@ -210,7 +226,10 @@ int main(int argc, char **argv)
   
   /* ######## #### ## Step5 Ending ## #### ######## */
   
-  /*Step5.A Free and clean*/
+  /*Step5.A Stop progress reporter*/
+  progress_stop(&param);
+  
+  /*Step5.B Free and clean*/
   free_and_clean_step_0(&param);
   free_and_clean_step_1(&param);
   free_and_clean_step_2(&param);
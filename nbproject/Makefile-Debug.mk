@@ -36,17 +36,26 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 # Object Files
 OBJECTFILES= \
 	${OBJECTDIR}/aggregate_supports_heuristic.o \
+	${OBJECTDIR}/aggregate_supports_index.o \
 	${OBJECTDIR}/cluster_candidates.o \
+	${OBJECTDIR}/cluster_writer.o \
 	${OBJECTDIR}/clusters.o \
 	${OBJECTDIR}/free_resource.o \
 	${OBJECTDIR}/frequent_words.o \
 	${OBJECTDIR}/hash_table_processing.o \
+	${OBJECTDIR}/input_chunks.o \
 	${OBJECTDIR}/join_clusters_heuristic.o \
 	${OBJECTDIR}/line_processing.o \
 	${OBJECTDIR}/main.o \
 	${OBJECTDIR}/outliers.o \
 	${OBJECTDIR}/output.o \
+	${OBJECTDIR}/pipeline.o \
 	${OBJECTDIR}/preparation.o \
+	${OBJECTDIR}/progress.o \
+	${OBJECTDIR}/regex_backend.o \
+	${OBJECTDIR}/sketch.o \
+	${OBJECTDIR}/table_alloc.o \
+	${OBJECTDIR}/thread_pool.o \
 	${OBJECTDIR}/utility.o \
 	${OBJECTDIR}/word_filter_search_replace.o
 
@@ -65,7 +74,7 @@ FFLAGS=
 ASFLAGS=
 
 # Link Libraries and Options
-LDLIBSOPTIONS=
+LDLIBSOPTIONS=${PCRE2_LIBS} -lpthread
 
 # Build Targets
 .build-conf: ${BUILD_SUBPROJECTS}
@@ -80,11 +89,21 @@ ${OBJECTDIR}/aggregate_supports_heuristic.o: aggregate_supports_heuristic.c
 	${RM} "$@.d"
 	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/aggregate_supports_heuristic.o aggregate_supports_heuristic.c
 
+${OBJECTDIR}/aggregate_supports_index.o: aggregate_supports_index.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/aggregate_supports_index.o aggregate_supports_index.c
+
 ${OBJECTDIR}/cluster_candidates.o: cluster_candidates.c
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
 	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/cluster_candidates.o cluster_candidates.c
 
+${OBJECTDIR}/cluster_writer.o: cluster_writer.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/cluster_writer.o cluster_writer.c
+
 ${OBJECTDIR}/clusters.o: clusters.c
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -105,6 +124,11 @@ ${OBJECTDIR}/hash_table_processing.o: hash_table_processing.c
 	${RM} "$@.d"
 	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/hash_table_processing.o hash_table_processing.c
 
+${OBJECTDIR}/input_chunks.o: input_chunks.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/input_chunks.o input_chunks.c
+
 ${OBJECTDIR}/join_clusters_heuristic.o: join_clusters_heuristic.c
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -130,11 +154,41 @@ ${OBJECTDIR}/output.o: output.c
 	${RM} "$@.d"
 	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/output.o output.c
 
+${OBJECTDIR}/pipeline.o: pipeline.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/pipeline.o pipeline.c
+
 ${OBJECTDIR}/preparation.o: preparation.c
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
 	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/preparation.o preparation.c
 
+${OBJECTDIR}/progress.o: progress.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/progress.o progress.c
+
+${OBJECTDIR}/regex_backend.o: regex_backend.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/regex_backend.o regex_backend.c
+
+${OBJECTDIR}/sketch.o: sketch.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/sketch.o sketch.c
+
+${OBJECTDIR}/table_alloc.o: table_alloc.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/table_alloc.o table_alloc.c
+
+${OBJECTDIR}/thread_pool.o: thread_pool.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/thread_pool.o thread_pool.c
+
 ${OBJECTDIR}/utility.o: utility.c
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
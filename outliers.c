@@ -23,88 +23,526 @@
  * Created on November 30, 2016, 10:48 PM
  */
 
+
 #include "common_header.h"
 #include "outliers.h"
 
 #include <string.h>    /* for strcmp(), strcpy(), etc. */
+#include <errno.h>     /* for errno */
+#include <unistd.h>    /* for write(), fork(), etc. */
+#include <fcntl.h>     /* for open() */
+#include <signal.h>    /* for signal() */
+#include <sys/wait.h>  /* for waitpid() */
+#include <pthread.h>
 
 #include "output.h"
 #include "line_processing.h"
 #include "hash_table_processing.h"
+#include "word_filter_search_replace.h"
+#include "input_chunks.h"
+#include "thread_pool.h"
 
-wordnumber_t step_4_find_outliers(struct Parameters *pParam)
-{
-  FILE *pOutliers;
-  FILE *pFile;
-  struct InputFile *pFilePtr;
-  char logStr[MAXLOGMSGLEN];
+/* The input is split into chunks (see input_chunks.c), which the workers take
+ in the order of the input. Each chunk collects its outlier lines into its own
+ buffer, and the buffers are written out in the order of the chunks as soon as
+ all earlier chunks have been written, so the outlier file keeps the order of
+ the input. The oldest unwritten chunk (the head) writes its lines out as it
+ goes. Any other chunk that has buffered OUTLIER_BUFFER_MAX bytes waits until
+ it becomes the head, and a worker does not start a chunk that is more than
+ 2 * threadNum chunks ahead of the head, which bounds the buffered memory. */
+
+/* Scratch storage of one worker. pParser points to parser, or to the parser
+ in pParam for worker 0. The words are allocated separately, because they
+ are too big for the stack of a worker thread. */
+struct OutlierScratch {
+  struct LineParser parser;
+  struct LineParser *pParser;
+  char (*pWords)[MAXWORDLEN];
   char line[MAXLINELEN];
   char key[MAXKEYLEN];
-  char words[MAXWORDS][MAXWORDLEN];
-  int len, wordcount, i;
-  struct Elem *pWord, *pElem;
+  struct WordCache cache;
+};
+
+/* Outlier lines of one chunk. The head is checked again when checkAt bytes
+ have been buffered. bHead is set when the chunk has become the head, bDone
+ when the chunk is finished. */
+struct OutlierBuffer {
+  char *pData;
+  size_t used;
+  size_t size;
+  size_t checkAt;
+  wordnumber_t outlierNum;
+  char bHead;
+  char bDone;
+};
+
+/* The outliers of chunk pChunks[i] are collected into pBuffers[i]. nextChunk
+ is the next chunk to be taken by a worker, all chunks before head have been
+ written. head and the bDone flags are protected by mutex, and cond is
+ signalled when head moves. */
+struct OutlierJob {
+  struct InputChunk *pChunks;
+  unsigned long chunkNum;
+  unsigned long nextChunk;
+  unsigned long head;
+  unsigned long aheadMax;
+  struct OutlierBuffer *pBuffers;
+  struct OutlierScratch *pScratch;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int fd;
+  struct Parameters *pParam;
+};
+
+static int open_outlier_file(pid_t *pPid, struct Parameters *pParam);
+static void close_outlier_file(int fd, pid_t pid, struct Parameters *pParam);
+static void write_outliers(int fd, const char *pData, size_t len,
+        struct Parameters *pParam);
+static void find_outliers_body(unsigned long index, int worker, void *pArg);
+static void find_chunk_outliers(struct OutlierJob *pJob, unsigned long index,
+        int worker);
+static void flush_chunk_outliers(struct OutlierJob *pJob,
+        unsigned long index);
+static void finish_chunk_outliers(struct OutlierJob *pJob,
+        unsigned long index);
+static void release_outliers(struct OutlierBuffer *pBuffer);
+static int is_outlier(char *line, struct OutlierScratch *pScratch,
+        struct Parameters *pParam);
+static void append_outlier(struct OutlierBuffer *pBuffer, char *line,
+        struct Parameters *pParam);
+
+wordnumber_t step_4_find_outliers(struct Parameters *pParam)
+{
+  struct OutlierJob job;
+  struct InputChunk *pChunks;
+  unsigned long chunkNum, i;
   wordnumber_t outlierNum;
+  pid_t pid;
+  int w;
   
   outlierNum = 0;
   
-  if (!(pOutliers = fopen(pParam->pOutlier, "w")))
+  job.fd = open_outlier_file(&pid, pParam);
+  
+  pChunks = plan_input_chunks(&chunkNum, pParam);
+  
+  job.pChunks = pChunks;
+  job.chunkNum = chunkNum;
+  job.nextChunk = 0;
+  job.head = 0;
+  job.aheadMax = 2 * (unsigned long) pParam->threadNum;
+  job.pParam = pParam;
+  job.pBuffers = (struct OutlierBuffer *) malloc((chunkNum + 1) * 
+                        sizeof(struct OutlierBuffer));
+  job.pScratch = (struct OutlierScratch *) malloc(pParam->threadNum * 
+                         sizeof(struct OutlierScratch));
+  if (!job.pBuffers || !job.pScratch)
+  {
+    log_msg(MALLOC_ERR_6035, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  for (w = 0; w < pParam->threadNum; w++)
+  {
+    job.pScratch[w].pWords = (char (*)[MAXWORDLEN]) malloc(MAXWORDS * 
+                                 MAXWORDLEN);
+    if (!job.pScratch[w].pWords)
+    {
+      log_msg(MALLOC_ERR_6035, LOG_ERR, pParam);
+      exit(1);
+    }
+    word_cache_init(&job.pScratch[w].cache);
+    
+    if (w == 0)
+    {
+      job.pScratch[w].pParser = &pParam->lineParser;
+    }
+    else
+    {
+      line_parser_init(&job.pScratch[w].parser, pParam);
+      job.pScratch[w].pParser = &job.pScratch[w].parser;
+    }
+  }
+  
+  for (i = 0; i < chunkNum; i++)
+  {
+    job.pBuffers[i].pData = 0;
+    job.pBuffers[i].used = 0;
+    job.pBuffers[i].size = 0;
+    job.pBuffers[i].checkAt = OUTLIER_BUFFER_SIZE;
+    job.pBuffers[i].outlierNum = 0;
+    job.pBuffers[i].bHead = 0;
+    job.pBuffers[i].bDone = 0;
+  }
+  
+  pthread_mutex_init(&job.mutex, 0);
+  pthread_cond_init(&job.cond, 0);
+  
+  /* Every worker takes chunks until there are none left. */
+  parallel_for((unsigned long) pParam->threadNum, find_outliers_body, &job,
+          pParam);
+  
+  pthread_cond_destroy(&job.cond);
+  pthread_mutex_destroy(&job.mutex);
+  
+  close_outlier_file(job.fd, pid, pParam);
+  
+  for (i = 0; i < chunkNum; i++)
+  {
+    outlierNum += job.pBuffers[i].outlierNum;
+  }
+  for (w = 0; w < pParam->threadNum; w++)
+  {
+    word_cache_flush(&job.pScratch[w].cache, pParam);
+    free((void *) job.pScratch[w].pWords);
+    if (w)
+    {
+      line_parser_free(&job.pScratch[w].parser);
+    }
+  }
+  free((void *) job.pBuffers);
+  free((void *) job.pScratch);
+  free((void *) pChunks);
+  
+  return outlierNum;
+}
+
+/* Open the outlier file for writing. If '--outliercompress' option is given,
+ the command is started with its output redirected into the outlier file, and
+ the returned descriptor is the input of the command, its process ID is
+ stored into *pPid. Otherwise *pPid is set to 0. */
+static int open_outlier_file(pid_t *pPid, struct Parameters *pParam)
+{
+  char logStr[MAXLOGMSGLEN];
+  int fd, pipeFd[2];
+  
+  *pPid = 0;
+  
+  if ((fd = open(pParam->pOutlier, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
   {
     sprintf(logStr, "Can't open outliers file %s", pParam->pOutlier);
     log_msg(logStr, LOG_ERR, pParam);
     exit(1);
   }
   
-  for (pFilePtr = pParam->pInputFiles; pFilePtr; pFilePtr = pFilePtr->pNext)
+  if (!pParam->pOutlierCompress)
+  {
+    return fd;
+  }
+  
+  if (pipe(pipeFd) || (*pPid = fork()) < 0)
+  {
+    sprintf(logStr, "Can't start outliers compress command '%s': %s",
+        pParam->pOutlierCompress, strerror(errno));
+    log_msg(logStr, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  if (*pPid == 0)
+  {
+    dup2(pipeFd[0], 0);
+    dup2(fd, 1);
+    close(pipeFd[0]);
+    close(pipeFd[1]);
+    close(fd);
+    execl("/bin/sh", "sh", "-c", pParam->pOutlierCompress, (char *) 0);
+    _exit(127);
+  }
+  
+  close(pipeFd[0]);
+  close(fd);
+  
+  /* If the command exits early, the write error is reported, instead of
+   being killed by SIGPIPE. */
+  signal(SIGPIPE, SIG_IGN);
+  
+  return pipeFd[1];
+}
+
+static void close_outlier_file(int fd, pid_t pid, struct Parameters *pParam)
+{
+  char logStr[MAXLOGMSGLEN];
+  int status;
+  
+  if (close(fd))
+  {
+    sprintf(logStr, "Can't write outliers file %s: %s", pParam->pOutlier,
+        strerror(errno));
+    log_msg(logStr, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  if (!pid)
   {
-    if (!(pFile = fopen(pFilePtr->pName, "r")))
+    return;
+  }
+  
+  while (waitpid(pid, &status, 0) < 0)
+  {
+    if (errno != EINTR)
     {
-      sprintf(logStr, "Can't open input file %s", pFilePtr->pName);
-      log_msg(logStr, LOG_ERR, pParam);
-      continue;
+      status = -1;
+      break;
     }
-    
-    while (fgets(line, MAXLINELEN, pFile))
+  }
+  
+  if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status))
+  {
+    sprintf(logStr, "Outliers compress command '%s' failed",
+        pParam->pOutlierCompress);
+    log_msg(logStr, LOG_ERR, pParam);
+    exit(1);
+  }
+}
+
+static void write_outliers(int fd, const char *pData, size_t len,
+        struct Parameters *pParam)
+{
+  char logStr[MAXLOGMSGLEN];
+  ssize_t written;
+  
+  while (len)
+  {
+    written = write(fd, pData, len);
+    if (written < 0)
     {
-      len = (int) strlen(line);
-      if (line[len - 1] == '\n')
+      if (errno == EINTR)
       {
-        line[len - 1] = 0;
-      }
-      
-      wordcount = find_words(line, words, pParam);
-      
-      *key = 0;
-      
-      for (i = 0; i < wordcount; i++)
-      {
-        pWord = find_elem(words[i], pParam->ppWordTable,
-                  pParam->wordTableSize, pParam->wordTableSeed);
-        if (words[i][0] != 0 && pWord)
-        {
-          strcat(key, words[i]);
-          len = (int) strlen(key);
-          key[len] = CLUSTERSEP;
-          key[len + 1] = 0;
-        }
+        continue;
       }
-      
-      if (*key == 0 && wordcount)
+      sprintf(logStr, "Can't write outliers file %s: %s", pParam->pOutlier,
+          strerror(errno));
+      log_msg(logStr, LOG_ERR, pParam);
+      exit(1);
+    }
+    pData += written;
+    len -= (size_t) written;
+  }
+}
+
+static void find_outliers_body(unsigned long index, int worker, void *pArg)
+{
+  struct OutlierJob *pJob;
+  unsigned long chunk;
+  
+  pJob = (struct OutlierJob *) pArg;
+  
+  while ((chunk = __atomic_fetch_add(&pJob->nextChunk, 1, __ATOMIC_RELAXED)) 
+      < pJob->chunkNum)
+  {
+    find_chunk_outliers(pJob, chunk, worker);
+  }
+}
+
+static void find_chunk_outliers(struct OutlierJob *pJob, unsigned long index,
+        int worker)
+{
+  struct OutlierScratch *pScratch;
+  struct OutlierBuffer *pBuffer;
+  struct ChunkReader reader;
+  
+  pScratch = pJob->pScratch + worker;
+  pBuffer = pJob->pBuffers + index;
+  
+  /* The chunks are taken in order, so the head is always being processed by
+   some worker, and the wait ends. */
+  pthread_mutex_lock(&pJob->mutex);
+  while (index >= pJob->head + pJob->aheadMax)
+  {
+    pthread_cond_wait(&pJob->cond, &pJob->mutex);
+  }
+  pthread_mutex_unlock(&pJob->mutex);
+  
+  if (chunk_reader_open(&reader, pJob->pChunks + index, pJob->pParam))
+  {
+    while (chunk_reader_read_line(&reader, pScratch->line, pJob->pParam))
+    {
+      if (!is_outlier(pScratch->line, pScratch, pJob->pParam))
       {
-        fprintf(pOutliers, "%s\n", line);
-        outlierNum++;
         continue;
       }
       
-      pElem = find_elem(key, pParam->ppClusterTable, pParam->clusterTableSize,
-                pParam->clusterTableSeed);
+      append_outlier(pBuffer, pScratch->line, pJob->pParam);
+      pBuffer->outlierNum++;
       
-      if (!pElem || (pElem->count < pParam->support))
+      if (pBuffer->used >= pBuffer->checkAt)
       {
-        fprintf(pOutliers, "%s\n", line);
-        outlierNum++;
+        flush_chunk_outliers(pJob, index);
       }
     }
+    
+    chunk_reader_close(&reader);
   }
   
-  return outlierNum;
-}
\ No newline at end of file
+  finish_chunk_outliers(pJob, index);
+}
+
+/* Write out the buffered lines of chunk index if it is the head. If it is
+ not, the lines stay in the buffer, unless there are OUTLIER_BUFFER_MAX bytes
+ of them already, in which case the chunk waits until it becomes the head. */
+static void flush_chunk_outliers(struct OutlierJob *pJob, unsigned long index)
+{
+  struct OutlierBuffer *pBuffer;
+  
+  pBuffer = pJob->pBuffers + index;
+  
+  if (!pBuffer->bHead)
+  {
+    pthread_mutex_lock(&pJob->mutex);
+    if (pJob->head != index && pBuffer->used < OUTLIER_BUFFER_MAX)
+    {
+      pthread_mutex_unlock(&pJob->mutex);
+      pBuffer->checkAt = pBuffer->used + OUTLIER_BUFFER_SIZE;
+      return;
+    }
+    while (pJob->head != index)
+    {
+      pthread_cond_wait(&pJob->cond, &pJob->mutex);
+    }
+    pthread_mutex_unlock(&pJob->mutex);
+    pBuffer->bHead = 1;
+  }
+  
+  write_outliers(pJob->fd, pBuffer->pData, pBuffer->used, pJob->pParam);
+  pBuffer->used = 0;
+  pBuffer->checkAt = OUTLIER_BUFFER_SIZE;
+}
+
+/* Mark chunk index finished. If it is the head, its lines and the lines of
+ the finished chunks after it are written out, and the head moves to the
+ first chunk that is not finished yet. The head is moved only after the
+ lines of the previous chunk are written, thus the chunk that becomes the
+ head can start writing at once. */
+static void finish_chunk_outliers(struct OutlierJob *pJob, unsigned long index)
+{
+  struct OutlierBuffer *pBuffer;
+  
+  pBuffer = pJob->pBuffers + index;
+  
+  if (!pBuffer->bHead)
+  {
+    pthread_mutex_lock(&pJob->mutex);
+    pBuffer->bDone = 1;
+    if (pJob->head != index)
+    {
+      pthread_mutex_unlock(&pJob->mutex);
+      return;
+    }
+    pthread_mutex_unlock(&pJob->mutex);
+  }
+  
+  for (;;)
+  {
+    write_outliers(pJob->fd, pBuffer->pData, pBuffer->used, pJob->pParam);
+    release_outliers(pBuffer);
+    
+    pthread_mutex_lock(&pJob->mutex);
+    index = ++pJob->head;
+    pthread_cond_broadcast(&pJob->cond);
+    if (index == pJob->chunkNum || !pJob->pBuffers[index].bDone)
+    {
+      pthread_mutex_unlock(&pJob->mutex);
+      return;
+    }
+    pthread_mutex_unlock(&pJob->mutex);
+    
+    pBuffer = pJob->pBuffers + index;
+  }
+}
+
+static void release_outliers(struct OutlierBuffer *pBuffer)
+{
+  free((void *) pBuffer->pData);
+  pBuffer->pData = 0;
+  pBuffer->used = 0;
+  pBuffer->size = 0;
+}
+
+/* The hash tables are only read here, thus lookup_elems() and lookup_elem()
+ are used instead of find_elem(), which reorders them. */
+static int is_outlier(char *line, struct OutlierScratch *pScratch,
+        struct Parameters *pParam)
+{
+  char *key, *pNewWord;
+  char (*words)[MAXWORDLEN];
+  int len, wordcount, i;
+  struct Elem *pWord, *pElem;
+  struct Elem *pFound[MAXWORDS];
+  
+  key = pScratch->key;
+  words = pScratch->pWords;
+  
+  wordcount = find_words(line, words, pScratch->pParser, pParam);
+  
+  *key = 0;
+  
+  lookup_elems(words, wordcount, pFound, &pScratch->cache, 
+         pParam->ppWordTable, pParam->wordTableSize, pParam->wordTableSeed);
+  
+  for (i = 0; i < wordcount; i++)
+  {
+    pWord = pFound[i];
+    if (words[i][0] != 0 && pWord)
+    {
+      strcat(key, words[i]);
+      len = (int) strlen(key);
+      key[len] = CLUSTERSEP;
+      key[len + 1] = 0;
+    }
+    else if (pParam->pWordFilter &&
+        (pNewWord = word_filter_search_replace(words[i], pScratch->pParser,
+                             pParam)))
+    {
+      /* Same as in the cluster candidate pass, a word that is not
+       frequent itself can still be represented by its rewritten form. */
+      pWord = lookup_elem(pNewWord, pParam->ppWordTable,
+                pParam->wordTableSize, pParam->wordTableSeed);
+      if (words[i][0] != 0 && pWord)
+      {
+        strcat(key, pNewWord);
+        len = (int) strlen(key);
+        key[len] = CLUSTERSEP;
+        key[len + 1] = 0;
+      }
+    }
+  }
+  
+  if (*key == 0 && wordcount)
+  {
+    return 1;
+  }
+  
+  pElem = lookup_elem(key, pParam->ppClusterTable, pParam->clusterTableSize,
+            pParam->clusterTableSeed);
+  
+  return !pElem || (pElem->count < pParam->support);
+}
+
+static void append_outlier(struct OutlierBuffer *pBuffer, char *line,
+        struct Parameters *pParam)
+{
+  size_t len;
+  char *pData;
+  
+  len = strlen(line);
+  
+  if (pBuffer->used + len + 1 > pBuffer->size)
+  {
+    pBuffer->size = pBuffer->size ? pBuffer->size * 2 : OUTLIER_BUFFER_SIZE;
+    while (pBuffer->used + len + 1 > pBuffer->size)
+    {
+      pBuffer->size *= 2;
+    }
+    pData = (char *) realloc((void *) pBuffer->pData, pBuffer->size);
+    if (!pData)
+    {
+      log_msg(MALLOC_ERR_6036, LOG_ERR, pParam);
+      exit(1);
+    }
+    pBuffer->pData = pData;
+  }
+  
+  memcpy(pBuffer->pData + pBuffer->used, line, len);
+  pBuffer->used += len;
+  pBuffer->pData[pBuffer->used++] = '\n';
+}
@@ -29,31 +29,42 @@
 #include <string.h>    /* for strcmp(), strcpy(), etc. */
 
 #include "utility.h"
+#include "cluster_writer.h"
 
-static void print_clusters_default_config(struct Parameters *pParam);
-static void print_clusters_constant_config(struct Parameters *pParam);
+static void print_clusters_default_config(struct ClusterWriter *pWriter,
+        struct Parameters *pParam);
+static void print_clusters_constant_config(struct ClusterWriter *pWriter,
+        struct Parameters *pParam);
 
 static void print_clusters_if_join_cluster_default_0(
-  struct Parameters *pParam);
-static void print_clusters_default_0(struct Parameters *pParam);
+  struct ClusterWriter *pWriter, struct Parameters *pParam);
+static void print_clusters_default_0(struct ClusterWriter *pWriter,
+        struct Parameters *pParam);
 
 static void print_clusters_if_join_cluster_constant_1(
-  struct Parameters *pParam);
-static void print_clusters_constant_1(struct Parameters *pParam);
+  struct ClusterWriter *pWriter, struct Parameters *pParam);
+static void print_clusters_constant_1(struct ClusterWriter *pWriter,
+        struct Parameters *pParam);
 
-static void print_cluster(struct Cluster* pCluster);
-static void print_cluster_with_token(struct ClusterWithToken *pClusterWithToken,
-                struct Parameters *pParam);
+static void print_top_clusters_of_slot(struct ClusterWriter *pWriter,
+        int constants, struct Parameters *pParam);
+
+static void print_element(struct ClusterWriter *pWriter, struct Elem *pElem);
+static void print_cluster(struct ClusterWriter *pWriter,
+        struct Cluster* pCluster);
+static void print_cluster_with_token(struct ClusterWriter *pWriter,
+        struct ClusterWithToken *pClusterWithToken);
 
 /* Log message operator. It refines a message into timestamped format, and
  forwards it to user terminal. It also forwards the message to Syslog. */
 void log_msg(char *message, int logLv, struct Parameters* pParam)
 {
   time_t t;
-  char *timestamp;
+  char timestamp[32];
   
+  /* ctime_r(), since the progress reporter thread also logs messages. */
   t = time(0);
-  timestamp = ctime(&t);
+  ctime_r(&t, timestamp);
   timestamp[strlen(timestamp) - 1] = 0;
   fprintf(stderr, "%s: %s\n", timestamp, message);
   
@@ -103,37 +114,42 @@ void print_cluster_to_string(struct Cluster *pCluster,
   //return clusterDescription;
 }
 
+/* The clusters are written to standard output through a buffered writer, in
+ the format of '--outputformat' option. */
 void step_3_print_clusters(struct Parameters *pParam)
 {
-  printf("\n");
+  struct ClusterWriter writer;
+  
+  writer_open(&writer, fileno(stdout), pParam);
   
   switch (pParam->outputMode)
   {
     case 0:
       //Default printing configuration. Clusters are sorted by support.
-      print_clusters_default_config(pParam);
+      print_clusters_default_config(&writer, pParam);
       break;
     case 1:
       /* Alternative printing configuration. Clusters are sorted by the number 
        of constants. */  
-      print_clusters_constant_config(pParam);
+      print_clusters_constant_config(&writer, pParam);
       break;
     default:
       break;
   }
   
-  printf("\n");
+  writer_close(&writer);
 }
 
 //clusters are arranged according to their support value
-static void print_clusters_default_config(struct Parameters *pParam)
+static void print_clusters_default_config(struct ClusterWriter *pWriter,
+        struct Parameters *pParam)
 {
   char logStr[MAXLOGMSGLEN];
   char digit[MAXDIGITBIT];
   
   if (pParam->wordWeightThreshold)
   {
-    print_clusters_if_join_cluster_default_0(pParam);
+    print_clusters_if_join_cluster_default_0(pWriter, pParam);
     
     str_format_int_grouped(digit, pParam->clusterNum -
                  pParam->joinedClusterInputNum +
@@ -141,7 +157,7 @@ static void print_clusters_default_config(struct Parameters *pParam)
   }
   else
   {
-    print_clusters_default_0(pParam);
+    print_clusters_default_0(pWriter, pParam);
     
     str_format_int_grouped(digit, pParam->clusterNum);
   }
@@ -151,14 +167,15 @@ static void print_clusters_default_config(struct Parameters *pParam)
 }
 
 //clusters are arranged according to the number of constants (frequent words)
-static void print_clusters_constant_config(struct Parameters *pParam)
+static void print_clusters_constant_config(struct ClusterWriter *pWriter,
+        struct Parameters *pParam)
 {
   char logStr[MAXLOGMSGLEN];
   char digit[MAXDIGITBIT];
   
   if (pParam->wordWeightThreshold)
   {
-    print_clusters_if_join_cluster_constant_1(pParam);
+    print_clusters_if_join_cluster_constant_1(pWriter, pParam);
     
     str_format_int_grouped(digit, pParam->clusterNum -
                  pParam->joinedClusterInputNum +
@@ -166,7 +183,7 @@ static void print_clusters_constant_config(struct Parameters *pParam)
   }
   else
   {
-    print_clusters_constant_1(pParam);
+    print_clusters_constant_1(pWriter, pParam);
     
     str_format_int_grouped(digit, pParam->clusterNum);
   }
@@ -181,13 +198,13 @@ static void print_clusters_constant_config(struct Parameters *pParam)
  For the sake of computing performance, sorry for this inconvenience. It will
  be fixed with better solution in the following updates. */
 static void print_clusters_if_join_cluster_default_0(
-  struct Parameters *pParam)
+  struct ClusterWriter *pWriter, struct Parameters *pParam)
 {
   int i, j, k;
   struct Cluster *pCluster;
-  struct ClusterWithToken *pClusterWithToken, *ptr;
+  struct ClusterWithToken *pClusterWithToken;
   struct Elem **ppSortedArray;
-  wordnumber_t toBeSortedNum;
+  wordnumber_t toBeSortedNum, printNum;
   
   toBeSortedNum = (pParam->clusterNum - pParam->joinedClusterInputNum) +
   pParam->joinedClusterOutputNum;
@@ -216,28 +233,28 @@ static void print_clusters_if_join_cluster_default_0(
     pClusterWithToken = pParam->pClusterWithTokenFamily[i];
     while (pClusterWithToken)
     {
-      ppSortedArray[j] = pClusterWithToken->pElem;
+      ppSortedArray[j] = &pClusterWithToken->elem;
       j++;
       pClusterWithToken = pClusterWithToken->pNext;
     }
   }
   
-  sort_elements(ppSortedArray, toBeSortedNum, pParam);
+  /* With '--top' option, only the clusters that will be printed are
+   sorted. */
+  if (pParam->topNum)
+  {
+    printNum = sort_top_elements(ppSortedArray, toBeSortedNum, pParam->topNum,
+                   pParam);
+  }
+  else
+  {
+    sort_elements(ppSortedArray, toBeSortedNum, pParam);
+    printNum = toBeSortedNum;
+  }
   
-  for (k = 0; k < toBeSortedNum; k++)
+  for (k = 0; k < printNum; k++)
   {
-    /* For clusters in pClusterFamily[], only print those who were not
-     marked as bIsJoined. Those who were joined, will be printed later, by
-     accessing pClusterWithTokenFamily[]. */
-    if (ppSortedArray[k]->pCluster->bIsJoined == 1)
-    {
-      ptr = (struct ClusterWithToken *) ppSortedArray[k]->pCluster;
-      print_cluster_with_token(ptr, pParam);
-    }
-    else
-    {
-      print_cluster(ppSortedArray[k]->pCluster);
-    }
+    print_element(pWriter, ppSortedArray[k]);
   }
   
   free((void *) ppSortedArray);
@@ -335,11 +352,13 @@ static void print_clusters_if_join_cluster_default_0(
  brother function print_clusters_if_join_cluster_default_0(). 
  For the sake of computing performance, sorry for this inconvenience. It will
  be fixed with better solution in the following updates. */
-static void print_clusters_default_0(struct Parameters *pParam)
+static void print_clusters_default_0(struct ClusterWriter *pWriter,
+        struct Parameters *pParam)
 {
   int i, j, k;
   struct Cluster *pCluster;
   struct Elem **ppSortedArray;
+  wordnumber_t printNum;
   
   ppSortedArray = (struct Elem **) malloc(sizeof(struct Elem *) *
                       pParam->clusterNum);
@@ -361,11 +380,20 @@ static void print_clusters_default_0(struct Parameters *pParam)
     }
   }
   
-  sort_elements(ppSortedArray, pParam->clusterNum, pParam);
+  if (pParam->topNum)
+  {
+    printNum = sort_top_elements(ppSortedArray, pParam->clusterNum,
+                   pParam->topNum, pParam);
+  }
+  else
+  {
+    sort_elements(ppSortedArray, pParam->clusterNum, pParam);
+    printNum = pParam->clusterNum;
+  }
   
-  for (k = 0; k < pParam->clusterNum; k++)
+  for (k = 0; k < printNum; k++)
   {
-    print_cluster(ppSortedArray[k]->pCluster);
+    print_cluster(pWriter, ppSortedArray[k]->pCluster);
   }
   
   free((void *) ppSortedArray);
@@ -376,7 +404,7 @@ static void print_clusters_default_0(struct Parameters *pParam)
  For the sake of computing performance, sorry for this inconvenience. It will
  be fixed with better solution in the following updates. */
 static void print_clusters_if_join_cluster_constant_1(
-  struct Parameters *pParam)
+  struct ClusterWriter *pWriter, struct Parameters *pParam)
 {
   int i;
   struct Cluster *pCluster;
@@ -384,6 +412,12 @@ static void print_clusters_if_join_cluster_constant_1(
   
   for (i = 1; i <= pParam->biggestConstants; i++)
   {
+    if (pParam->topNum)
+    {
+      print_top_clusters_of_slot(pWriter, i, pParam);
+      continue;
+    }
+    
     /* For clusters in pClusterFamily[], only print those who were not
      marked as bIsJoined. Those who were joined, will be printed later, by
      accessing pClusterWithTokenFamily[]. */
@@ -392,7 +426,7 @@ static void print_clusters_if_join_cluster_constant_1(
     {
       if (pCluster->bIsJoined == 0)
       {
-        print_cluster(pCluster);
+        print_cluster(pWriter, pCluster);
         
       }
       pCluster = pCluster->pNext;
@@ -401,7 +435,7 @@ static void print_clusters_if_join_cluster_constant_1(
     pClusterWithToken = pParam->pClusterWithTokenFamily[i];
     while (pClusterWithToken)
     {
-      print_cluster_with_token(pClusterWithToken, pParam);
+      print_cluster_with_token(pWriter, pClusterWithToken);
       pClusterWithToken = pClusterWithToken->pNext;
     }
     
@@ -459,123 +493,118 @@ static void print_clusters_if_join_cluster_constant_1(
  brother function print_clusters_if_join_cluster_constant_1(). 
  For the sake of computing performance, sorry for this inconvenience. It will
  be fixed with better solution in the following updates. */
-static void print_clusters_constant_1(struct Parameters *pParam)
+static void print_clusters_constant_1(struct ClusterWriter *pWriter,
+        struct Parameters *pParam)
 {
   int i;
   struct Cluster *pCluster;
   
   for (i = 1; i <= pParam->biggestConstants; i++)
   {
+    if (pParam->topNum)
+    {
+      print_top_clusters_of_slot(pWriter, i, pParam);
+      continue;
+    }
+    
     pCluster = pParam->pClusterFamily[i];
     while (pCluster)
     {
-      print_cluster(pCluster);
+      print_cluster(pWriter, pCluster);
       pCluster = pCluster->pNext;
     }
   }
 }
 
-static void print_cluster(struct Cluster* pCluster)
+/* '--top' option with '--outputmode=1': prints the clusters with the highest
+ support among those with the given number of constants, sorted by support.
+ Joined clusters('--wweight' option) replace the clusters they were made of,
+ same as in the other printing functions. */
+static void print_top_clusters_of_slot(struct ClusterWriter *pWriter,
+        int constants, struct Parameters *pParam)
 {
-  char digit[MAXDIGITBIT];
-  int i;
+  struct Cluster *pCluster;
+  struct ClusterWithToken *pClusterWithToken;
+  struct Elem **ppSortedArray;
+  wordnumber_t toBeSortedNum, printNum, k;
   
-  for (i = 1; i <= pCluster->constants; i++)
+  toBeSortedNum = 0;
+  for (pCluster = pParam->pClusterFamily[constants]; pCluster;
+      pCluster = pCluster->pNext)
   {
-    if (pCluster->fullWildcard[i * 2 + 1])
-    {
-      printf("*{%d,%d} ", pCluster->fullWildcard[i * 2],
-           pCluster->fullWildcard[i * 2 + 1]);
-    }
-    printf("%s ", pCluster->ppWord[i]->pKey);
+    toBeSortedNum += (pCluster->bIsJoined == 0);
   }
-  
-  if (pCluster->fullWildcard[1])
+  for (pClusterWithToken = pParam->pClusterWithTokenFamily[constants];
+      pClusterWithToken; pClusterWithToken = pClusterWithToken->pNext)
   {
-    printf("*{%d,%d}", pCluster->fullWildcard[0],
-         pCluster->fullWildcard[1]);
+    toBeSortedNum++;
   }
   
-  printf("\n");
+  if (toBeSortedNum == 0)
+  {
+    return;
+  }
   
-  str_format_int_grouped(digit, pCluster->count);
-  printf("Support : %s\n\n", digit);
-}
-
-static void print_cluster_with_token(struct ClusterWithToken *pClusterWithToken,
-                struct Parameters *pParam)
-{
-  char digit[MAXDIGITBIT];
-  struct Token *pToken;
-  int i;
+  ppSortedArray = (struct Elem **) malloc(sizeof(struct Elem *) * 
+          toBeSortedNum);
+  if (!ppSortedArray)
+  {
+    log_msg(MALLOC_ERR_6033, LOG_ERR, pParam);
+    exit(1);
+  }
   
-  for (i = 1; i <= pClusterWithToken->constants; i++)
+  k = 0;
+  for (pCluster = pParam->pClusterFamily[constants]; pCluster;
+      pCluster = pCluster->pNext)
   {
-    if (pClusterWithToken->fullWildcard[i * 2 + 1])
-    {
-      printf("*{%d,%d} ", pClusterWithToken->fullWildcard[i * 2],
-           pClusterWithToken->fullWildcard[i * 2 + 1]);
-    }
-    
-    if (pClusterWithToken->ppToken[i] != 0)
+    if (pCluster->bIsJoined == 0)
     {
-      if (pParam->bDetailedTokenFlag == 0)
-      {
-        /* This solution will not mark a token, if it is the only word.
-         */
-        if (pClusterWithToken->ppToken[i]->pNext != 0)
-        {
-          printf("(");
-          pToken = pClusterWithToken->ppToken[i];
-          while (pToken)
-          {
-            printf("%s", pToken->pWord->pKey);
-            if (pToken->pNext)
-            {
-              printf("|");
-            }
-            pToken = pToken->pNext;
-          }
-          printf(") ");
-        }
-        else
-        {
-          printf("%s ", pClusterWithToken->ppToken[i]->pWord->pKey);
-        }
-      }
-      else
-      {
-        /* This solution marks a token with (), no matter how many words
-         it contains. */
-        printf("(");
-        pToken = pClusterWithToken->ppToken[i];
-        while (pToken)
-        {
-          printf("%s", pToken->pWord->pKey);
-          if (pToken->pNext)
-          {
-            printf("|");
-          }
-          pToken = pToken->pNext;
-        }
-        printf(") ");
-      }
-      
-    }
-    else
-    {
-      printf("%s ", pClusterWithToken->ppWord[i]->pKey);
+      ppSortedArray[k++] = pCluster->pElem;
     }
   }
-  
-  if (pClusterWithToken->fullWildcard[1])
+  for (pClusterWithToken = pParam->pClusterWithTokenFamily[constants];
+      pClusterWithToken; pClusterWithToken = pClusterWithToken->pNext)
   {
-    printf("*{%d,%d}", pClusterWithToken->fullWildcard[0],
-         pClusterWithToken->fullWildcard[1]);
+    ppSortedArray[k++] = &pClusterWithToken->elem;
   }
   
-  printf("\n");
+  printNum = sort_top_elements(ppSortedArray, toBeSortedNum, pParam->topNum,
+                 pParam);
+  
+  for (k = 0; k < printNum; k++)
+  {
+    print_element(pWriter, ppSortedArray[k]);
+  }
   
-  str_format_int_grouped(digit, pClusterWithToken->count);
-  printf("Support : %s\n\n", digit);
+  free((void *) ppSortedArray);
+}
+
+/* Prints the cluster of an element from the sorted cluster array. A joined
+ cluster('--wweight' option) is sorted by its elem, which has no cluster, and
+ which is the first member of {struct ClusterWithToken}. */
+static void print_element(struct ClusterWriter *pWriter, struct Elem *pElem)
+{
+  if (pElem->pCluster == 0)
+  {
+    print_cluster_with_token(pWriter, (struct ClusterWithToken *) pElem);
+  }
+  else
+  {
+    print_cluster(pWriter, pElem->pCluster);
+  }
+}
+
+static void print_cluster(struct ClusterWriter *pWriter,
+        struct Cluster* pCluster)
+{
+  writer_write_cluster(pWriter, pCluster->constants, pCluster->fullWildcard,
+             pCluster->ppWord, 0, pCluster->count);
+}
+
+static void print_cluster_with_token(struct ClusterWriter *pWriter,
+        struct ClusterWithToken *pClusterWithToken)
+{
+  writer_write_cluster(pWriter, pClusterWithToken->constants,
+             pClusterWithToken->fullWildcard, pClusterWithToken->ppWord,
+             pClusterWithToken->pTokens, pClusterWithToken->count);
 }
\ No newline at end of file
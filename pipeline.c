@@ -0,0 +1,710 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * File:   pipeline.c
+ *
+ * Content: A pipeline of reader, tokenizer and consumer stages, which is used
+ * by the passes over the data set that update the hash tables.
+ *
+ * Created on October 19, 2026, 11:50 PM
+ */
+
+#include "common_header.h"
+#include "pipeline.h"
+
+#include <string.h>    /* for strlen(), memcpy(), etc. */
+#include <pthread.h>
+
+#include "output.h"
+#include "line_processing.h"
+#include "hash_table_processing.h"
+#include "input_chunks.h"
+#include "thread_pool.h"
+#include "progress.h"
+
+/* The reader thread reads the input files into batches of lines, and hands
+ batch k to tokenizer k % tokenizerNum. A tokenizer turns every line of the
+ batch into a record, which holds what the consumer needs to update the
+ tables (e.g. the words to be inserted). The calling thread takes the batches
+ from the tokenizers in the same round-robin order, thus it sees the records
+ in the order of the input, and the tables are built exactly as by a single
+ thread. Consumed batches go back to the reader.
+ 
+ The stages are connected with single-producer single-consumer rings of
+ batch pointers. There is a fixed number of batches, and every ring can hold
+ all of them plus an end marker (0), so a ring is never full, and only an
+ empty ring is waited for. The number of batches bounds the memory used, and
+ holds the reader back when the other stages are slower. A stage waiting for
+ an empty ring spins for a short while, and then sleeps until a batch is
+ pushed, so that stages waiting for a slow disk don't take the processors.
+ 
+ The reader, the tokenizers and the consumer together use '--threads'
+ threads. With two threads, the only tokenizer reads its batches by itself.
+ With one thread, the stages are run one after the other by the calling
+ thread, without the rings.
+ 
+ pipeline_run_shared() is for consumers that can update a shared table from
+ several threads at once. The input chunks (see input_chunks.c) are then
+ processed by parallel_for(), every worker reading, tokenizing and consuming
+ batches of its own, in no particular order. */
+
+/* A batch of lines, terminated by '\0', and the records of these lines. Every
+ record is its length (size_t) followed by its data, padded to the alignment
+ of size_t. */
+struct PipelineBatch {
+  char *pLines;
+  size_t linesUsed;
+  int lineNum;
+  char *pRecords;
+  size_t recordsUsed;
+  size_t recordsSize;
+};
+
+/* tail is advanced only by the producer, head only by the consumer. The
+ consumer sleeps on cond when the ring is empty, then bSleeping is set. */
+struct PipelineRing {
+  struct PipelineBatch **ppSlots;
+  unsigned long mask;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int bSleeping;
+  unsigned long tail __attribute__ ((aligned (64)));
+  unsigned long head __attribute__ ((aligned (64)));
+};
+
+struct PipelineTokenizer {
+  struct PipelineWorker worker;
+  struct PipelineRing *pIn;
+  struct PipelineRing *pOut;
+  struct Pipeline *pPipeline;
+  pthread_t thread;
+};
+
+/* pRings holds the input and output ring of every tokenizer, followed by the
+ ring of free batches. A tokenizer without input ring reads its batches.
+ pFilePtr, pFile and filePos are the position of the reader. pChunks is only
+ used by pipeline_run_shared(), where pTokenizers and pBatches hold the worker
+ and the batch of every thread. */
+struct Pipeline {
+  pipeline_tokenize_t pTokenize;
+  pipeline_consume_t pConsume;
+  void *pArg;
+  struct PipelineTokenizer *pTokenizers;
+  int tokenizerNum;
+  struct PipelineRing *pRings;
+  struct PipelineRing *pFree;
+  struct PipelineBatch *pBatches;
+  int batchNum;
+  struct InputFile *pFilePtr;
+  FILE *pFile;
+  long long filePos;
+  struct InputChunk *pChunks;
+  support_t linecount;
+  struct Parameters *pParam;
+};
+
+static void pipeline_init(struct Pipeline *pPipe, pipeline_tokenize_t pTokenize,
+        pipeline_consume_t pConsume, void *pArg, int tokenizerNum,
+        int batchNum, struct Parameters *pParam);
+static void pipeline_free(struct Pipeline *pPipe);
+static int fill_batch(struct Pipeline *pPipe, struct PipelineBatch *pBatch);
+static int fill_chunk_batch(struct ChunkReader *pReader,
+        struct PipelineBatch *pBatch, struct Parameters *pParam);
+static void shared_chunk_body(unsigned long index, int worker, void *pArg);
+static void tokenize_batch(struct Pipeline *pPipe,
+        struct PipelineWorker *pWorker, struct PipelineBatch *pBatch);
+static void consume_batch(struct Pipeline *pPipe, struct PipelineBatch *pBatch);
+static void *pipeline_reader(void *pArg);
+static void *pipeline_tokenizer(void *pArg);
+static void *pipeline_reading_tokenizer(void *pArg);
+static void ring_push(struct PipelineRing *pRing, struct PipelineBatch *pBatch);
+static struct PipelineBatch *ring_pop(struct PipelineRing *pRing);
+static void reserve_records(struct PipelineWorker *pWorker, size_t len);
+
+/* Run a pass over the data set: pTokenize is called for every line, and
+ pConsume for every record, with pArg. Returns the number of lines. */
+support_t pipeline_run(pipeline_tokenize_t pTokenize,
+        pipeline_consume_t pConsume, void *pArg, struct Parameters *pParam)
+{
+  struct Pipeline pipe;
+  struct PipelineTokenizer *pTok;
+  struct PipelineBatch *pBatch;
+  pthread_t reader;
+  unsigned long capacity, k;
+  int bThreaded, bReader, tokenizerNum, ringNum, i;
+  
+  bThreaded = pParam->threadNum > 1;
+  bReader = pParam->threadNum > 2;
+  
+  /* The reader and the consumer do little work compared to the tokenizers,
+   which get the rest of the threads. */
+  tokenizerNum = bReader ? pParam->threadNum - 2 : 1;
+  pipeline_init(&pipe, pTokenize, pConsume, pArg, tokenizerNum, bThreaded ?
+          tokenizerNum * PIPELINE_BATCHES_PER_WORKER + 2 : 1, pParam);
+  
+  if (!bThreaded)
+  {
+    while (fill_batch(&pipe, pipe.pBatches))
+    {
+      tokenize_batch(&pipe, &pipe.pTokenizers[0].worker, pipe.pBatches);
+      consume_batch(&pipe, pipe.pBatches);
+    }
+  }
+  else
+  {
+    ringNum = 2 * pipe.tokenizerNum + 1;
+    for (capacity = 1; capacity < (unsigned long) pipe.batchNum + 1; 
+        capacity *= 2);
+    
+    if (posix_memalign((void **) &pipe.pRings, 64, 
+              ringNum * sizeof(struct PipelineRing)))
+    {
+      log_msg(MALLOC_ERR_6039, LOG_ERR, pParam);
+      exit(1);
+    }
+    
+    for (i = 0; i < ringNum; i++)
+    {
+      pipe.pRings[i].ppSlots = (struct PipelineBatch **) malloc(capacity * 
+                                 sizeof(struct PipelineBatch *));
+      if (!pipe.pRings[i].ppSlots)
+      {
+        log_msg(MALLOC_ERR_6039, LOG_ERR, pParam);
+        exit(1);
+      }
+      pipe.pRings[i].mask = capacity - 1;
+      pipe.pRings[i].head = 0;
+      pipe.pRings[i].tail = 0;
+      pipe.pRings[i].bSleeping = 0;
+      pthread_mutex_init(&pipe.pRings[i].mutex, 0);
+      pthread_cond_init(&pipe.pRings[i].cond, 0);
+    }
+    
+    pipe.pFree = pipe.pRings + 2 * pipe.tokenizerNum;
+    for (i = 0; i < pipe.batchNum; i++)
+    {
+      ring_push(pipe.pFree, pipe.pBatches + i);
+    }
+    
+    for (i = 0; i < pipe.tokenizerNum; i++)
+    {
+      pTok = pipe.pTokenizers + i;
+      pTok->pIn = bReader ? pipe.pRings + 2 * i : 0;
+      pTok->pOut = pipe.pRings + 2 * i + 1;
+      if (pthread_create(&pTok->thread, 0, bReader ? pipeline_tokenizer :
+                pipeline_reading_tokenizer, pTok))
+      {
+        log_msg("pthread_create() failed. Function: pipeline_run().", 
+            LOG_ERR, pParam);
+        exit(1);
+      }
+    }
+    
+    if (bReader && pthread_create(&reader, 0, pipeline_reader, &pipe))
+    {
+      log_msg("pthread_create() failed. Function: pipeline_run().", LOG_ERR,
+          pParam);
+      exit(1);
+    }
+    
+    /* The consumer. Batch k comes from tokenizer k % tokenizerNum, the
+     first end marker means that there are no more batches. */
+    for (k = 0; ; k++)
+    {
+      pBatch = ring_pop(pipe.pTokenizers[k % pipe.tokenizerNum].pOut);
+      if (!pBatch)
+      {
+        break;
+      }
+      consume_batch(&pipe, pBatch);
+      ring_push(pipe.pFree, pBatch);
+    }
+    
+    if (bReader)
+    {
+      pthread_join(reader, 0);
+    }
+    for (i = 0; i < pipe.tokenizerNum; i++)
+    {
+      pthread_join(pipe.pTokenizers[i].thread, 0);
+    }
+    
+    for (i = 0; i < ringNum; i++)
+    {
+      pthread_mutex_destroy(&pipe.pRings[i].mutex);
+      pthread_cond_destroy(&pipe.pRings[i].cond);
+      free((void *) pipe.pRings[i].ppSlots);
+    }
+    free((void *) pipe.pRings);
+  }
+  
+  pipeline_free(&pipe);
+  
+  return pipe.linecount;
+}
+
+/* Run a pass like pipeline_run(), but the input chunks are processed in
+ parallel, and every thread consumes the records it has tokenized. Thus
+ pConsume is called by several threads at once, and in no particular order.
+ Returns the number of lines. */
+support_t pipeline_run_shared(pipeline_tokenize_t pTokenize,
+        pipeline_consume_t pConsume, void *pArg, struct Parameters *pParam)
+{
+  struct Pipeline pipe;
+  unsigned long chunkNum;
+  
+  pipeline_init(&pipe, pTokenize, pConsume, pArg, pParam->threadNum,
+          pParam->threadNum, pParam);
+  pipe.pChunks = plan_input_chunks(&chunkNum, pParam);
+  
+  parallel_for(chunkNum, shared_chunk_body, &pipe, pParam);
+  
+  free((void *) pipe.pChunks);
+  pipeline_free(&pipe);
+  
+  return pipe.linecount;
+}
+
+/* Allocate the batches, and the workers of the tokenizers. Worker 0 uses the
+ line parser in pParam. */
+static void pipeline_init(struct Pipeline *pPipe, pipeline_tokenize_t pTokenize,
+        pipeline_consume_t pConsume, void *pArg, int tokenizerNum,
+        int batchNum, struct Parameters *pParam)
+{
+  struct PipelineTokenizer *pTok;
+  int i;
+  
+  pPipe->pTokenize = pTokenize;
+  pPipe->pConsume = pConsume;
+  pPipe->pArg = pArg;
+  pPipe->pParam = pParam;
+  pPipe->pFilePtr = pParam->pInputFiles;
+  pPipe->pFile = 0;
+  pPipe->filePos = 0;
+  pPipe->pChunks = 0;
+  pPipe->linecount = 0;
+  pPipe->tokenizerNum = tokenizerNum;
+  pPipe->batchNum = batchNum;
+  
+  pPipe->pBatches = (struct PipelineBatch *) malloc(batchNum * 
+                           sizeof(struct PipelineBatch));
+  pPipe->pTokenizers = (struct PipelineTokenizer *) malloc(tokenizerNum * 
+                              sizeof(struct PipelineTokenizer));
+  if (!pPipe->pBatches || !pPipe->pTokenizers)
+  {
+    log_msg(MALLOC_ERR_6039, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  for (i = 0; i < batchNum; i++)
+  {
+    pPipe->pBatches[i].pLines = (char *) malloc(PIPELINE_BATCH_BYTES);
+    if (!pPipe->pBatches[i].pLines)
+    {
+      log_msg(MALLOC_ERR_6039, LOG_ERR, pParam);
+      exit(1);
+    }
+    pPipe->pBatches[i].pRecords = 0;
+    pPipe->pBatches[i].recordsSize = 0;
+  }
+  
+  for (i = 0; i < tokenizerNum; i++)
+  {
+    pTok = pPipe->pTokenizers + i;
+    pTok->pPipeline = pPipe;
+    pTok->worker.pParam = pParam;
+    pTok->worker.bRecordOpen = 0;
+    word_cache_init(&pTok->worker.cache);
+    pTok->worker.pWords = (char (*)[MAXWORDLEN]) malloc(MAXWORDS * 
+                                MAXWORDLEN);
+    if (!pTok->worker.pWords)
+    {
+      log_msg(MALLOC_ERR_6039, LOG_ERR, pParam);
+      exit(1);
+    }
+    
+    if (i == 0)
+    {
+      pTok->worker.pParser = &pParam->lineParser;
+    }
+    else
+    {
+      line_parser_init(&pTok->worker.parser, pParam);
+      pTok->worker.pParser = &pTok->worker.parser;
+    }
+  }
+}
+
+static void pipeline_free(struct Pipeline *pPipe)
+{
+  int i;
+  
+  for (i = 0; i < pPipe->batchNum; i++)
+  {
+    free((void *) pPipe->pBatches[i].pLines);
+    free((void *) pPipe->pBatches[i].pRecords);
+  }
+  for (i = 0; i < pPipe->tokenizerNum; i++)
+  {
+    word_cache_flush(&pPipe->pTokenizers[i].worker.cache, pPipe->pParam);
+    free((void *) pPipe->pTokenizers[i].worker.pWords);
+    if (i)
+    {
+      line_parser_free(&pPipe->pTokenizers[i].worker.parser);
+    }
+  }
+  free((void *) pPipe->pBatches);
+  free((void *) pPipe->pTokenizers);
+}
+
+/* Append len bytes to the current record of the line, which is opened by
+ the first append. */
+void pipeline_append(struct PipelineWorker *pWorker, const void *pData,
+        size_t len)
+{
+  struct PipelineBatch *pBatch;
+  
+  pBatch = pWorker->pBatch;
+  
+  if (!pWorker->bRecordOpen)
+  {
+    reserve_records(pWorker, sizeof(size_t));
+    pWorker->recordStart = pBatch->recordsUsed;
+    pBatch->recordsUsed += sizeof(size_t);
+    pWorker->bRecordOpen = 1;
+  }
+  
+  reserve_records(pWorker, len);
+  memcpy(pBatch->pRecords + pBatch->recordsUsed, pData, len);
+  pBatch->recordsUsed += len;
+}
+
+/* Close the current record, and hand it to the consumer. If nothing has been
+ appended, there is no record. */
+void pipeline_commit(struct PipelineWorker *pWorker)
+{
+  struct PipelineBatch *pBatch;
+  size_t len;
+  
+  if (!pWorker->bRecordOpen)
+  {
+    return;
+  }
+  
+  pBatch = pWorker->pBatch;
+  len = pBatch->recordsUsed - pWorker->recordStart - sizeof(size_t);
+  memcpy(pBatch->pRecords + pWorker->recordStart, &len, sizeof(size_t));
+  
+  reserve_records(pWorker, sizeof(size_t));
+  pBatch->recordsUsed = (pBatch->recordsUsed + sizeof(size_t) - 1) / 
+      sizeof(size_t) * sizeof(size_t);
+  pWorker->bRecordOpen = 0;
+}
+
+/* Read the next lines of the input into pBatch. Returns the number of lines,
+ which is 0 at the end of the input. The lines and bytes of the batch are
+ added to the progress counters at once. */
+static int fill_batch(struct Pipeline *pPipe, struct PipelineBatch *pBatch)
+{
+  char logStr[MAXLOGMSGLEN];
+  char *line;
+  unsigned long long bytes;
+  int len;
+  
+  bytes = 0;
+  pBatch->linesUsed = 0;
+  pBatch->lineNum = 0;
+  
+  while (pBatch->lineNum < PIPELINE_BATCH_LINES && 
+      pBatch->linesUsed + MAXLINELEN <= PIPELINE_BATCH_BYTES)
+  {
+    if (!pPipe->pFile)
+    {
+      if (!pPipe->pFilePtr)
+      {
+        break;
+      }
+      
+      if (!(pPipe->pFile = fopen(pPipe->pFilePtr->pName, "r")))
+      {
+        sprintf(logStr, "Can't open input file %s", pPipe->pFilePtr->pName);
+        log_msg(logStr, LOG_ERR, pPipe->pParam);
+        pPipe->pFilePtr = pPipe->pFilePtr->pNext;
+        continue;
+      }
+      pPipe->filePos = 0;
+    }
+    
+    line = pBatch->pLines + pBatch->linesUsed;
+    if ((len = read_line(line, pPipe->pFile, &pPipe->filePos, 
+                pPipe->pParam)) < 0)
+    {
+      fclose(pPipe->pFile);
+      pPipe->pFile = 0;
+      pPipe->pFilePtr = pPipe->pFilePtr->pNext;
+      continue;
+    }
+    
+    bytes += len;
+    pBatch->linesUsed += strlen(line) + 1;
+    pBatch->lineNum++;
+  }
+  
+  pPipe->linecount += pBatch->lineNum;
+  progress_add(&pPipe->pParam->progress.lines, pBatch->lineNum);
+  progress_add(&pPipe->pParam->progress.bytes, bytes);
+  
+  return pBatch->lineNum;
+}
+
+/* Same as fill_batch(), but the lines are read from one input chunk. */
+static int fill_chunk_batch(struct ChunkReader *pReader,
+        struct PipelineBatch *pBatch, struct Parameters *pParam)
+{
+  char *line;
+  
+  pBatch->linesUsed = 0;
+  pBatch->lineNum = 0;
+  
+  while (pBatch->lineNum < PIPELINE_BATCH_LINES && 
+      pBatch->linesUsed + MAXLINELEN <= PIPELINE_BATCH_BYTES)
+  {
+    line = pBatch->pLines + pBatch->linesUsed;
+    if (!chunk_reader_read_line(pReader, line, pParam))
+    {
+      break;
+    }
+    
+    pBatch->linesUsed += strlen(line) + 1;
+    pBatch->lineNum++;
+  }
+  
+  return pBatch->lineNum;
+}
+
+static void shared_chunk_body(unsigned long index, int worker, void *pArg)
+{
+  struct Pipeline *pPipe;
+  struct PipelineBatch *pBatch;
+  struct ChunkReader reader;
+  support_t linecount;
+  
+  pPipe = (struct Pipeline *) pArg;
+  pBatch = pPipe->pBatches + worker;
+  
+  if (!chunk_reader_open(&reader, pPipe->pChunks + index, pPipe->pParam))
+  {
+    return;
+  }
+  
+  linecount = 0;
+  while (fill_chunk_batch(&reader, pBatch, pPipe->pParam))
+  {
+    tokenize_batch(pPipe, &pPipe->pTokenizers[worker].worker, pBatch);
+    consume_batch(pPipe, pBatch);
+    linecount += pBatch->lineNum;
+  }
+  
+  chunk_reader_close(&reader);
+  
+  __atomic_fetch_add(&pPipe->linecount, linecount, __ATOMIC_RELAXED);
+}
+
+static void tokenize_batch(struct Pipeline *pPipe,
+        struct PipelineWorker *pWorker, struct PipelineBatch *pBatch)
+{
+  char *line;
+  size_t len;
+  int i;
+  
+  pWorker->pBatch = pBatch;
+  pBatch->recordsUsed = 0;
+  
+  line = pBatch->pLines;
+  for (i = 0; i < pBatch->lineNum; i++)
+  {
+    /* The callback may modify the line. */
+    len = strlen(line) + 1;
+    pPipe->pTokenize(line, pWorker, pPipe->pParam);
+    pipeline_commit(pWorker);
+    line += len;
+  }
+}
+
+static void consume_batch(struct Pipeline *pPipe, struct PipelineBatch *pBatch)
+{
+  char *pRecord, *pEnd;
+  size_t len;
+  
+  pRecord = pBatch->pRecords;
+  pEnd = pBatch->pRecords + pBatch->recordsUsed;
+  
+  while (pRecord < pEnd)
+  {
+    memcpy(&len, pRecord, sizeof(size_t));
+    pRecord += sizeof(size_t);
+    pPipe->pConsume(pRecord, len, pPipe->pArg);
+    pRecord += (len + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t);
+  }
+}
+
+static void *pipeline_reader(void *pArg)
+{
+  struct Pipeline *pPipe;
+  struct PipelineBatch *pBatch;
+  unsigned long k;
+  int i;
+  
+  pPipe = (struct Pipeline *) pArg;
+  
+  for (k = 0; ; k++)
+  {
+    pBatch = ring_pop(pPipe->pFree);
+    if (!fill_batch(pPipe, pBatch))
+    {
+      break;
+    }
+    ring_push(pPipe->pTokenizers[k % pPipe->tokenizerNum].pIn, pBatch);
+  }
+  
+  for (i = 0; i < pPipe->tokenizerNum; i++)
+  {
+    ring_push(pPipe->pTokenizers[(k + i) % pPipe->tokenizerNum].pIn, 0);
+  }
+  
+  return 0;
+}
+
+static void *pipeline_tokenizer(void *pArg)
+{
+  struct PipelineTokenizer *pTok;
+  struct PipelineBatch *pBatch;
+  
+  pTok = (struct PipelineTokenizer *) pArg;
+  
+  while ((pBatch = ring_pop(pTok->pIn)))
+  {
+    tokenize_batch(pTok->pPipeline, &pTok->worker, pBatch);
+    ring_push(pTok->pOut, pBatch);
+  }
+  
+  ring_push(pTok->pOut, 0);
+  
+  return 0;
+}
+
+/* The only tokenizer, which also does the work of the reader. */
+static void *pipeline_reading_tokenizer(void *pArg)
+{
+  struct PipelineTokenizer *pTok;
+  struct PipelineBatch *pBatch;
+  
+  pTok = (struct PipelineTokenizer *) pArg;
+  
+  for (;;)
+  {
+    pBatch = ring_pop(pTok->pPipeline->pFree);
+    if (!fill_batch(pTok->pPipeline, pBatch))
+    {
+      break;
+    }
+    tokenize_batch(pTok->pPipeline, &pTok->worker, pBatch);
+    ring_push(pTok->pOut, pBatch);
+  }
+  
+  ring_push(pTok->pOut, 0);
+  
+  return 0;
+}
+
+/* The ring can hold all batches and an end marker, so it is never full. The
+ mutex is taken once per batch, so that a consumer going to sleep can't miss
+ the batch. */
+static void ring_push(struct PipelineRing *pRing, struct PipelineBatch *pBatch)
+{
+  unsigned long tail;
+  
+  tail = pRing->tail;
+  pRing->ppSlots[tail & pRing->mask] = pBatch;
+  
+  pthread_mutex_lock(&pRing->mutex);
+  __atomic_store_n(&pRing->tail, tail + 1, __ATOMIC_RELEASE);
+  if (pRing->bSleeping)
+  {
+    pthread_cond_signal(&pRing->cond);
+  }
+  pthread_mutex_unlock(&pRing->mutex);
+}
+
+static struct PipelineBatch *ring_pop(struct PipelineRing *pRing)
+{
+  struct PipelineBatch *pBatch;
+  int spin;
+  
+  for (spin = 0; __atomic_load_n(&pRing->tail, __ATOMIC_ACQUIRE) == 
+      pRing->head; spin++)
+  {
+    if (spin == PIPELINE_SPIN)
+    {
+      pthread_mutex_lock(&pRing->mutex);
+      while (__atomic_load_n(&pRing->tail, __ATOMIC_ACQUIRE) == pRing->head)
+      {
+        pRing->bSleeping = 1;
+        pthread_cond_wait(&pRing->cond, &pRing->mutex);
+      }
+      pRing->bSleeping = 0;
+      pthread_mutex_unlock(&pRing->mutex);
+      break;
+    }
+  }
+  
+  pBatch = pRing->ppSlots[pRing->head & pRing->mask];
+  pRing->head++;
+  
+  return pBatch;
+}
+
+static void reserve_records(struct PipelineWorker *pWorker, size_t len)
+{
+  struct PipelineBatch *pBatch;
+  char *pRecords;
+  size_t size;
+  
+  pBatch = pWorker->pBatch;
+  
+  if (pBatch->recordsUsed + len <= pBatch->recordsSize)
+  {
+    return;
+  }
+  
+  size = pBatch->recordsSize ? pBatch->recordsSize : PIPELINE_BATCH_BYTES;
+  while (pBatch->recordsUsed + len > size)
+  {
+    size *= 2;
+  }
+  
+  pRecords = (char *) realloc((void *) pBatch->pRecords, size);
+  if (!pRecords)
+  {
+    log_msg(MALLOC_ERR_6040, LOG_ERR, pWorker->pParam);
+    exit(1);
+  }
+  pBatch->pRecords = pRecords;
+  pBatch->recordsSize = size;
+}
+
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * File:   pipeline.h
+ *
+ * Content: Declarations of global functions in pipeline.c .
+ *
+ * Created on October 19, 2026, 11:50 PM
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+support_t pipeline_run(pipeline_tokenize_t pTokenize,
+        pipeline_consume_t pConsume, void *pArg, struct Parameters *pParam);
+support_t pipeline_run_shared(pipeline_tokenize_t pTokenize,
+        pipeline_consume_t pConsume, void *pArg, struct Parameters *pParam);
+void pipeline_append(struct PipelineWorker *pWorker, const void *pData,
+        size_t len);
+void pipeline_commit(struct PipelineWorker *pWorker);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PIPELINE_H */
+
@@ -29,17 +29,20 @@
 #include <getopt.h>    /* for get_opt_long() */
 #include <glob.h>      /* for glob() */
 #include <string.h>    /* for strcmp(), strcpy(), etc. */
-#include <regex.h>     /* for regcomp() and regexec() */
+#include <sys/stat.h>  /* for stat() */
 
 #include "output.h"
 #include "free_resource.h"
 #include "utility.h"
+#include "regex_backend.h"
+#include "line_processing.h"
 
 static void glob_filenames(char *pPattern, struct Parameters *pParam);
 static void build_input_file_chain(char *pFilename, struct Parameters *pParam);
 static void build_template_chain(char *opt, struct Parameters *pParam);
 static int change_syslog_facility_number(struct Parameters *pParam);
 static int validate_parameters_template(struct Parameters *pParam);
+static void compile_template(struct Parameters *pParam);
 
 /* Initialization of parameters */
 int step_0_init_input_parameters(struct Parameters *pParam)
@@ -54,6 +57,7 @@ int step_0_init_input_parameters(struct Parameters *pParam)
   pParam->wordTableSize = DEF_WORD_TABLE_SIZE;
   pParam->bSyslogFlag = 0;
   pParam->bDetailedTokenFlag = 0;
+  pParam->bHugetlbFlag = 0;
   
   pParam->pSyslogFacility = (char *) malloc(strlen(defSyslogFacility) + 1);
   if (!pParam->pSyslogFacility)
@@ -67,14 +71,29 @@ int step_0_init_input_parameters(struct Parameters *pParam)
   pParam->byteOffset = 0;
   pParam->pFilter = 0;
   pParam->pTemplate = 0;
+  pParam->pTemplateInstr = 0;
+  pParam->templateInstrNum = 0;
+  pParam->templateBufferSize = 0;
+  pParam->lineParser.pTemplateBuffer = 0;
+  pParam->lineParser.pWordFilterCache = 0;
+#ifdef HAVE_PCRE2
+  pParam->lineParser.pMatchData = 0;
+#endif
+  pParam->lineParser.pParam = pParam;
   pParam->wordSketchSize = 0;
   pParam->clusterSketchSize = 0;
   pParam->bAggrsupFlag = 0;
+  pParam->aggrEngine = AGGR_ENGINE_AUTO;
+  pParam->outputFormat = OUTPUT_FORMAT_TEXT;
+  pParam->vocabTable = VOCAB_TABLE_ORDERED;
   pParam->wordWeightThreshold = 0;
   pParam->wordWeightFunction = 1;
   pParam->pOutlier = 0;
+  pParam->pOutlierCompress = 0;
   pParam->debug = 0;
   pParam->outputMode = 0;
+  pParam->threadNum = 1;
+  pParam->topNum = 0;
   
   pParam->syslogThreshold = DEF_SYSLOG_THRESHOLD;
   pParam->syslogFacilityNum = LOG_LOCAL2;
@@ -84,9 +103,19 @@ int step_0_init_input_parameters(struct Parameters *pParam)
   pParam->wordSketchSeed = 0;
   pParam->linecount = 0;
   pParam->dataPassTimes = 0;
-  pParam->totalLineNum = 0;
-  *pParam->totalLineNumDigit = 0;
-  pParam->timeStorage = 0;
+  pParam->progress.lines = 0;
+  pParam->progress.bytes = 0;
+  pParam->progress.totalBytes = 0;
+  pParam->progress.pPhase = "";
+  pParam->progress.cacheLookups = 0;
+  pParam->progress.cacheHits = 0;
+  pParam->progress.passNum = 0;
+  pParam->pThreadPool = 0;
+  pParam->progress.passTotal = 0;
+  pParam->progress.passStartLines = 0;
+  pParam->progress.passStartBytes = 0;
+  pParam->progress.bStop = 0;
+  pParam->progress.bRunning = 0;
   pParam->freWordNum = 0;
   pParam->clusterNum = 0;
   pParam->clusterCandiNum = 0;
@@ -106,29 +135,33 @@ int step_0_init_input_parameters(struct Parameters *pParam)
     pParam->pClusterFamily[i] = 0;
   }
   
-  /* The initialzition of regex_t delim_regex is integrated to function
+  /* The initialzition of delim_regex is integrated to function
    validate_parameters(). */
   
-  /* The initialzition of regex_t filter_regex is integrated to function
+  /* The initialzition of filter_regex is integrated to function
    validate_parameters(). */
   
-  pParam->wildcardHash = 0;
-  pParam->prefixSketchSize = 0;
-  pParam->prefixSketchSeed = 0;
+  pParam->wildcardKey = 0;
   pParam->prefixWildcardMin = 0;
   pParam->prefixWildcardMax = 0;
-  pParam->pPrefixRoot = 0;
+  pParam->pTrie = 0;
+  pParam->pTrieNodeBlocks = 0;
+  pParam->trieBuildBytes = 0;
+  pParam->trieBytes = 0;
   pParam->pPrefixRet = 0;
+  pParam->candidateIndex.ppCandidates = 0;
+  pParam->candidateIndex.candidateNum = 0;
+  pParam->candidateIndex.pPostingStart = 0;
+  pParam->candidateIndex.pPostings = 0;
+  pParam->candidateIndex.maxPostingLen = 0;
+  pParam->candidateIndex.pScratch = 0;
   
   /* If "token" is in frequent words, another random string that is not in
    frequent words will replace "token". */
   strcpy(pParam->token, "token");
   
-  for (i = 0; i <= MAXWORDS; i++)
-  {
-    pParam->tokenMarker[i] = 0;
-  }
-  
+  pParam->ppJoinedTable = 0;
+  pParam->joinedTableSize = 0;
   pParam->joinedClusterInputNum = 0;
   pParam->joinedClusterOutputNum = 0;
   
@@ -142,16 +175,14 @@ int step_0_init_input_parameters(struct Parameters *pParam)
     pParam->wordNumStr[i] = 0;
   }
   
-  pParam->pCurrentCluster = 0;
-  
   *pParam->clusterDescription = 0;
   
-  /* The initialzition of regex_t wfilter_regex and wsearch_regex is 
+  /* The initialzition of wfilter_regex and wsearch_regex is 
    integrated to function validate_parameters(). */
   pParam->pWordFilter = 0;
   pParam->pWordSearch = 0;
   pParam->pWordReplace = 0;
-  *pParam->tmpStr = 0;
+  pParam->wordFilterCacheSeed = 0;
   
   return 1;
 }
@@ -165,23 +196,30 @@ int step_0_parse_options(int argc, char **argv, struct Parameters *pParam)
   
   static struct option long_options[] =
   {
+    {"aggrengine",  required_argument, 0,  1014},
     {"aggrsup",   no_argument,     0,   'a'},
     {"byteoffset",  required_argument, 0,   'b'},
     {"csize",     required_argument, 0,   'c'},
     {"debug",     optional_argument, 0,  1007},
     {"detailtoken", no_argument,     0,  1012},
     {"help",    no_argument,     0,   'h'},
+    {"hugetlb",   no_argument,     0,  1019},
     {"initseed",  required_argument, 0,   'i'},
     {"lfilter",   required_argument, 0,   'f'},
     {"input",     required_argument, 0,  1001},
+    {"outliercompress", required_argument, 0,  1017},
     {"outliers",  required_argument, 0,   'o'},
+    {"outputformat", required_argument, 0,  1015},
     {"outputmode",  optional_argument, 0,  1011},
     {"rsupport",  required_argument, 0,  1005},
     {"separator",   required_argument, 0,   'd'},
     {"support",   required_argument, 0,   's'},
     {"syslog",    optional_argument, 0,  1002},
     {"template",  required_argument, 0,   't'},
+    {"threads",   required_argument, 0,  1013},
+    {"top",     required_argument, 0,  1016},
     {"version",   no_argument,     0,  1006},
+    {"vocabtable",  required_argument, 0,  1018},
     {"weightf",   required_argument, 0,  1004},
     {"wfilter",   required_argument, 0,  1008},
     {"wreplace",  required_argument, 0,  1010},
@@ -289,6 +327,8 @@ int step_0_parse_options(int argc, char **argv, struct Parameters *pParam)
       case 1006:
         printf("%s", VERSIONINFO);
         printf("\n");
+        printf("Regular expression backend: %s", regex_backend_name());
+        printf("\n");
         exit(0);
         break;
       case 'h':
@@ -341,6 +381,93 @@ int step_0_parse_options(int argc, char **argv, struct Parameters *pParam)
       case 1012:
         pParam->bDetailedTokenFlag = 1;
         break;
+      case 1013:
+        pParam->threadNum = atoi(optarg);
+        break;
+      case 1014:
+        if (!strcmp(optarg, "trie"))
+        {
+          pParam->aggrEngine = AGGR_ENGINE_TRIE;
+        }
+        else if (!strcmp(optarg, "index"))
+        {
+          pParam->aggrEngine = AGGR_ENGINE_INDEX;
+        }
+        else if (!strcmp(optarg, "auto"))
+        {
+          pParam->aggrEngine = AGGR_ENGINE_AUTO;
+        }
+        else
+        {
+          sprintf(logStr, "Unknown aggregation engine '%.32s' given with "
+              "'--aggrengine' option", optarg);
+          log_msg(logStr, LOG_ERR, pParam);
+          return 0;
+        }
+        break;
+      case 1015:
+        if (!strcmp(optarg, "text"))
+        {
+          pParam->outputFormat = OUTPUT_FORMAT_TEXT;
+        }
+        else if (!strcmp(optarg, "jsonl"))
+        {
+          pParam->outputFormat = OUTPUT_FORMAT_JSONL;
+        }
+        else if (!strcmp(optarg, "tsv"))
+        {
+          pParam->outputFormat = OUTPUT_FORMAT_TSV;
+        }
+        else if (!strcmp(optarg, "binary"))
+        {
+          pParam->outputFormat = OUTPUT_FORMAT_BINARY;
+        }
+        else
+        {
+          sprintf(logStr, "Unknown output format '%.32s' given with "
+              "'--outputformat' option", optarg);
+          log_msg(logStr, LOG_ERR, pParam);
+          return 0;
+        }
+        break;
+      case 1016:
+        if (atol(optarg) <= 0)
+        {
+          log_msg("'--top' option requires a positive number as parameter",
+              LOG_ERR, pParam);
+          return 0;
+        }
+        pParam->topNum = atol(optarg);
+        break;
+      case 1017:
+        pParam->pOutlierCompress = (char *) malloc(strlen(optarg) + 1);
+        if (!pParam->pOutlierCompress)
+        {
+          log_msg(MALLOC_ERR_6006, LOG_ERR, pParam);
+          exit(1);
+        }
+        strcpy(pParam->pOutlierCompress, optarg);
+        break;
+      case 1018:
+        if (!strcmp(optarg, "ordered"))
+        {
+          pParam->vocabTable = VOCAB_TABLE_ORDERED;
+        }
+        else if (!strcmp(optarg, "shared"))
+        {
+          pParam->vocabTable = VOCAB_TABLE_SHARED;
+        }
+        else
+        {
+          sprintf(logStr, "Unknown vocabulary table '%.32s' given with "
+              "'--vocabtable' option", optarg);
+          log_msg(logStr, LOG_ERR, pParam);
+          return 0;
+        }
+        break;
+      case 1019:
+        pParam->bHugetlbFlag = 1;
+        break;
       case '?':
         /* getopt_long already printed an error message. */
         break;
@@ -408,7 +535,7 @@ int step_0_validate_parameters(struct Parameters *pParam)
   
   if (pParam->pDelim)
   {
-    if (regcomp(&pParam->delim_regex, pParam->pDelim, REG_EXTENDED))
+    if (!regex_compile(&pParam->delim_regex, pParam->pDelim, pParam))
     {
       log_msg("Bad regular expression given with '-d' or '--separator' "
           "option", LOG_ERR, pParam);
@@ -417,7 +544,7 @@ int step_0_validate_parameters(struct Parameters *pParam)
   }
   else
   {
-    regcomp(&pParam->delim_regex, DEF_WORD_DELM, REG_EXTENDED);
+    regex_compile(&pParam->delim_regex, DEF_WORD_DELM, pParam);
   }
   
   if (pParam->byteOffset < 0)
@@ -427,8 +554,15 @@ int step_0_validate_parameters(struct Parameters *pParam)
     return 0;
   }
   
-  if (pParam->pFilter && regcomp(&pParam->filter_regex, pParam->pFilter,
-                   REG_EXTENDED))
+  if (pParam->threadNum < 1 || pParam->threadNum > MAXTHREADS)
+  {
+    log_msg("'--threads' option requires a number from 1 to 256 as "
+        "parameter", LOG_ERR, pParam);
+    return 0;
+  }
+  
+  if (pParam->pFilter && !regex_compile(&pParam->filter_regex, 
+                   pParam->pFilter, pParam))
   {
     log_msg("Bad regular expression given with '-f' or '--lfilter' option",
         LOG_ERR, pParam);
@@ -445,16 +579,16 @@ int step_0_validate_parameters(struct Parameters *pParam)
     }
   }
   
-  if (pParam->pWordFilter && regcomp(&pParam->wfilter_regex,
-                     pParam->pWordFilter, REG_EXTENDED))
+  if (pParam->pWordFilter && !regex_compile(&pParam->wfilter_regex,
+                     pParam->pWordFilter, pParam))
   {
     log_msg("Bad regular expression given with '--wfilter' option",
         LOG_ERR, pParam);
     return 0;
   }
   
-  if (pParam->pWordSearch && regcomp(&pParam->wsearch_regex,
-                     pParam->pWordSearch, REG_EXTENDED))
+  if (pParam->pWordSearch && !regex_compile(&pParam->wsearch_regex,
+                     pParam->pWordSearch, pParam))
   {
     log_msg("Bad regular expression given with '--wsearch' option",
         LOG_ERR, pParam);
@@ -517,6 +651,8 @@ int step_0_validate_parameters(struct Parameters *pParam)
     return 0;
   }
   
+  line_parser_init(&pParam->lineParser, pParam);
+  
   return 1;
 }
 
@@ -526,7 +662,7 @@ void step_0_generate_seeds(struct Parameters *pParam)
   pParam->wordSketchSeed = rand();
   pParam->clusterSketchSeed =rand();
   pParam->clusterTableSeed = rand();
-  pParam->prefixSketchSeed =rand();
+  pParam->wordFilterCacheSeed = rand();
 }
 
 int step_0_cal_total_pass_over_data_set_times(struct Parameters *pParam)
@@ -566,7 +702,9 @@ static void glob_filenames(char *pPattern, struct Parameters *pParam)
 static void build_input_file_chain(char *pFilename, struct Parameters *pParam)
 {
   struct InputFile *ptr;
+  struct stat fileStat;
   char logStr[MAXLOGMSGLEN];
+  char digit[MAXDIGITBIT];
   
   if (!pParam->pInputFiles)
   {
@@ -584,8 +722,8 @@ static void build_input_file_chain(char *pFilename, struct Parameters *pParam)
       exit(1);
     }
     strcpy(pParam->pInputFiles->pName, pFilename);
-    pParam->pInputFiles->lineNumber = 0;
     pParam->pInputFiles->pNext = 0;
+    ptr = pParam->pInputFiles;
   }
   else
   {
@@ -604,11 +742,24 @@ static void build_input_file_chain(char *pFilename, struct Parameters *pParam)
       exit(1);
     }
     strcpy(ptr->pName, pFilename);
-    ptr->lineNumber = 0;
     ptr->pNext = 0;
   }
   
-  sprintf(logStr, "File %s is added", pFilename);
+  /* The size is used for progress reporting, and for splitting the input into
+   chunks. If the file can not be stat()-ed, the error will be reported when
+   it is opened. */
+  if (!stat(pFilename, &fileStat) && S_ISREG(fileStat.st_mode))
+  {
+    ptr->fileSize = (unsigned long long) fileStat.st_size;
+  }
+  else
+  {
+    ptr->fileSize = 0;
+  }
+  pParam->progress.totalBytes += ptr->fileSize;
+  
+  str_format_int_grouped(digit, ptr->fileSize);
+  sprintf(logStr, "File %s is added (%s bytes)", pFilename, digit);
   log_msg(logStr, LOG_INFO, pParam);
 }
 
@@ -642,6 +793,8 @@ static void build_template_chain(char *opt, struct Parameters *pParam)
       ptr = pParam->pTemplate;
     }
     
+    ptr->pName = 0;
+    
     if (opt[i] != BACKREFCHAR)
     {
       start = i;
@@ -660,6 +813,36 @@ static void build_template_chain(char *opt, struct Parameters *pParam)
       ptr->pStr[len] = 0;
       ptr->data = len;
     }
+    else if (opt[i + 1] == '+' && opt[i + 2] == '{' && 
+        (addr = strchr(opt + i + 3, '}')))
+    {
+      /* Named match variable $+{name}. It is resolved into a number in
+       validate_parameters_template(). */
+      start = i + 3;
+      len = (int) (addr - opt) - start;
+      ptr->pName = (char *) malloc(len + 1);
+      if (!ptr->pName)
+      {
+        log_msg(MALLOC_ERR_6005, LOG_ERR, pParam);
+        exit(1);
+      }
+      strncpy(ptr->pName, opt + start, len);
+      ptr->pName[len] = 0;
+      ptr->pStr = 0;
+      ptr->data = -1;
+      i = (int) (addr - opt) + 1;
+    }
+    else if (opt[i + 1] == '{')
+    {
+      /* Numeric match variable with braces, e.g. ${12}. */
+      ptr->pStr = 0;
+      ptr->data = (int) strtol(opt + i + 2, &addr, 10);
+      i = (int) (addr - opt);
+      if (opt[i] == '}')
+      {
+        i++;
+      }
+    }
     else
     {
       ptr->pStr = 0;
@@ -774,6 +957,26 @@ static int validate_parameters_template(struct Parameters *pParam)
   
   for (ptr = pParam->pTemplate; ptr; ptr = ptr->pNext)
   {
+    if (ptr->pName)
+    {
+      ptr->data = pParam->pFilter ? 
+          regex_group_number(&pParam->filter_regex, ptr->pName) : -1;
+      if (ptr->data < 0)
+      {
+#ifdef HAVE_PCRE2
+        sprintf(logStr, "'-t' or '--template' option: named match "
+            "variable $+{%.64s} is not defined in '--lfilter' regular "
+            "expression", ptr->pName);
+#else
+        sprintf(logStr, "'-t' or '--template' option: named match "
+            "variable $+{%.64s} requires the PCRE2 regular expression "
+            "backend, this program is built with POSIX regex", ptr->pName);
+#endif
+        log_msg(logStr, LOG_ERR, pParam);
+        return 0;
+      }
+    }
+    
     if (!ptr->pStr && (ptr->data < 0 || ptr->data > MAXPARANEXPR -1))
     {
       sprintf(logStr, "'-t' or '--template' option requires"
@@ -783,5 +986,50 @@ static int validate_parameters_template(struct Parameters *pParam)
       return 0;
     }
   }
+  
+  if (pParam->pTemplate)
+  {
+    compile_template(pParam);
+  }
+  
   return 1;
+}
+
+/* Flatten the template chain into an instruction array, and allocate the
+ buffer for converted lines once. Adjacent literal strings can not occur, since
+ build_template_chain() reads a literal string until the next match variable.
+ A match variable can expand to at most the whole line, which is shorter than
+ MAXLINELEN. */
+static void compile_template(struct Parameters *pParam)
+{
+  struct TemplElem *ptr;
+  int i;
+  size_t bufferSize;
+  
+  i = 0;
+  for (ptr = pParam->pTemplate; ptr; ptr = ptr->pNext)
+  {
+    i++;
+  }
+  
+  pParam->pTemplateInstr = (struct TemplInstr *) 
+      malloc(sizeof(struct TemplInstr) * i);
+  if (!pParam->pTemplateInstr)
+  {
+    log_msg(MALLOC_ERR_6023, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  i = 0;
+  bufferSize = 1;
+  for (ptr = pParam->pTemplate; ptr; ptr = ptr->pNext)
+  {
+    pParam->pTemplateInstr[i].pStr = ptr->pStr;
+    pParam->pTemplateInstr[i].data = ptr->data;
+    bufferSize += ptr->pStr ? ptr->data : MAXLINELEN;
+    i++;
+  }
+  pParam->templateInstrNum = i;
+  
+  pParam->templateBufferSize = bufferSize;
 }
\ No newline at end of file
@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* 
+ * File:   progress.c
+ * 
+ * Content: Progress reporting. A summary is logged after every pass over the
+ * data set. In '--debug=2' and '--debug=3' mode, a background thread samples
+ * the counters which the readers of the input add to, and logs the processing
+ * status with estimated time of arrival, calculated from file sizes.
+ *
+ * Created on October 19, 2026, 2:15 PM
+ */
+
+#include "common_header.h"
+#include "progress.h"
+
+#include <string.h>    /* for strcmp(), strcpy(), etc. */
+#include <time.h>      /* for clock_gettime() */
+#include <pthread.h>
+
+#include "output.h"
+#include "utility.h"
+
+static void *progress_reporter(void *pArg);
+static void log_progress(support_t lines, unsigned long long bytes,
+             struct Parameters *pParam);
+static double seconds_since(struct timespec *pFrom);
+static void format_duration(char *pStr, double seconds);
+
+/* Initialize progress bookkeeping, and start the reporter thread. Only debug
+ level 2 and 3 report the processing status. For other levels the counters
+ are still updated, and only the summary of each pass is logged. */
+void progress_start(struct Parameters *pParam)
+{
+  struct Progress *pProgress;
+  
+  pProgress = &pParam->progress;
+  
+  pthread_mutex_init(&pProgress->mutex, 0);
+  pthread_cond_init(&pProgress->cond, 0);
+  pProgress->bStop = 0;
+  pProgress->passTotal = pParam->dataPassTimes;
+  clock_gettime(CLOCK_MONOTONIC, &pProgress->startTime);
+  pProgress->passStartTime = pProgress->startTime;
+  
+  if (pParam->debug != 2 && pParam->debug != 3)
+  {
+    return;
+  }
+  
+  if (pthread_create(&pProgress->thread, 0, progress_reporter, pParam))
+  {
+    log_msg("Can't start progress reporter thread", LOG_WARNING, pParam);
+    return;
+  }
+  
+  pProgress->bRunning = 1;
+}
+
+/* Phase is the name of the pass over the data set, it is shown in the status
+ messages. */
+void progress_begin_pass(char *pPhase, struct Parameters *pParam)
+{
+  struct Progress *pProgress;
+  
+  pProgress = &pParam->progress;
+  
+  pthread_mutex_lock(&pProgress->mutex);
+  pProgress->pPhase = pPhase;
+  pProgress->passNum++;
+  pProgress->cacheLookups = 0;
+  pProgress->cacheHits = 0;
+  pProgress->passStartLines = __atomic_load_n(&pProgress->lines,
+                        __ATOMIC_RELAXED);
+  pProgress->passStartBytes = __atomic_load_n(&pProgress->bytes,
+                        __ATOMIC_RELAXED);
+  clock_gettime(CLOCK_MONOTONIC, &pProgress->passStartTime);
+  pthread_mutex_unlock(&pProgress->mutex);
+}
+
+/* Log the throughput summary of the pass that has just been finished. */
+void progress_end_pass(struct Parameters *pParam)
+{
+  struct Progress *pProgress;
+  char logStr[MAXLOGMSGLEN];
+  char digit[MAXDIGITBIT];
+  char speed[MAXDIGITBIT];
+  char lookups[MAXDIGITBIT];
+  support_t lines;
+  double megabytes, seconds;
+  
+  pProgress = &pParam->progress;
+  
+  pthread_mutex_lock(&pProgress->mutex);
+  lines = __atomic_load_n(&pProgress->lines, __ATOMIC_RELAXED) -
+      pProgress->passStartLines;
+  megabytes = (double) (__atomic_load_n(&pProgress->bytes, __ATOMIC_RELAXED) -
+              pProgress->passStartBytes) / (1024 * 1024);
+  seconds = seconds_since(&pProgress->passStartTime);
+  pthread_mutex_unlock(&pProgress->mutex);
+  
+  if (seconds <= 0)
+  {
+    seconds = 1e-9;
+  }
+  
+  str_format_int_grouped(digit, lines);
+  str_format_int_grouped(speed, (unsigned long) (lines / seconds));
+  sprintf(logStr, "Pass %d/%d (%s) done: %s lines, %.1f MB in %.2f seconds "
+      "(%s lines/s, %.1f MB/s).", pProgress->passNum, pProgress->passTotal,
+      pProgress->pPhase, digit, megabytes, seconds, speed,
+      megabytes / seconds);
+  log_msg(logStr, LOG_INFO, pParam);
+  
+  if (pParam->debug && pProgress->cacheLookups)
+  {
+    str_format_int_grouped(digit, pProgress->cacheHits);
+    str_format_int_grouped(lookups, pProgress->cacheLookups);
+    sprintf(logStr, "Pass %d/%d (%s): %s of %s word lookups (%.2f%%) hit the "
+        "hot word cache.", pProgress->passNum, pProgress->passTotal,
+        pProgress->pPhase, digit, lookups, 
+        100.0 * pProgress->cacheHits / pProgress->cacheLookups);
+    log_msg(logStr, LOG_DEBUG, pParam);
+  }
+}
+
+void progress_stop(struct Parameters *pParam)
+{
+  struct Progress *pProgress;
+  
+  pProgress = &pParam->progress;
+  
+  if (pProgress->bRunning)
+  {
+    pthread_mutex_lock(&pProgress->mutex);
+    pProgress->bStop = 1;
+    pthread_cond_signal(&pProgress->cond);
+    pthread_mutex_unlock(&pProgress->mutex);
+    
+    pthread_join(pProgress->thread, 0);
+    pProgress->bRunning = 0;
+  }
+  
+  pthread_cond_destroy(&pProgress->cond);
+  pthread_mutex_destroy(&pProgress->mutex);
+}
+
+/* The reporter wakes up every PROGRESS_POLL_MSEC milliseconds in debug level
+ 2, and reports when the line counter has crossed a multiple of 
+ DEBUG_2_INTERVAL. In debug level 3, it wakes up and reports every 
+ DEBUG_3_INTERVAL seconds. */
+static void *progress_reporter(void *pArg)
+{
+  struct Parameters *pParam;
+  struct Progress *pProgress;
+  struct timespec deadline;
+  support_t lines, lastLines;
+  long msec;
+  
+  pParam = (struct Parameters *) pArg;
+  pProgress = &pParam->progress;
+  lastLines = 0;
+  msec = pParam->debug == 2 ? PROGRESS_POLL_MSEC : DEBUG_3_INTERVAL * 1000;
+  
+  pthread_mutex_lock(&pProgress->mutex);
+  
+  while (!pProgress->bStop)
+  {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += msec / 1000;
+    deadline.tv_nsec += (msec % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+    
+    while (!pProgress->bStop &&
+        pthread_cond_timedwait(&pProgress->cond, &pProgress->mutex,
+                   &deadline) == 0)
+    {
+      ;
+    }
+    
+    if (pProgress->bStop)
+    {
+      break;
+    }
+    
+    lines = __atomic_load_n(&pProgress->lines, __ATOMIC_RELAXED);
+    
+    if ((pParam->debug == 2 &&
+        lines / DEBUG_2_INTERVAL != lastLines / DEBUG_2_INTERVAL) ||
+        (pParam->debug == 3 && lines != lastLines))
+    {
+      log_progress(lines, __atomic_load_n(&pProgress->bytes,
+                        __ATOMIC_RELAXED), pParam);
+    }
+    
+    lastLines = lines;
+  }
+  
+  pthread_mutex_unlock(&pProgress->mutex);
+  
+  return 0;
+}
+
+/* Called by the reporter thread, with mutex locked. Percentages are based on
+ bytes, since file sizes are known before the first pass, while line numbers
+ are not. ETA is calculated from the average throughput since the first pass
+ started. */
+static void log_progress(support_t lines, unsigned long long bytes,
+             struct Parameters *pParam)
+{
+  struct Progress *pProgress;
+  char logStr[MAXLOGMSGLEN];
+  char digit[MAXDIGITBIT];
+  char eta[MAXDIGITBIT];
+  unsigned long long totalBytes, passBytes;
+  double passPct, overallPct, seconds;
+  
+  pProgress = &pParam->progress;
+  totalBytes = pProgress->totalBytes * pProgress->passTotal;
+  passBytes = bytes - pProgress->passStartBytes;
+  str_format_int_grouped(digit, lines - pProgress->passStartLines);
+  
+  if (!pProgress->totalBytes)
+  {
+    sprintf(logStr, "[%s] Pass %d/%d, UNKNOWN%% Finished. - %s lines.",
+        pProgress->pPhase, pProgress->passNum, pProgress->passTotal, digit);
+    log_msg(logStr, LOG_DEBUG, pParam);
+    return;
+  }
+  
+  passPct = (double) passBytes / pProgress->totalBytes;
+  overallPct = (double) bytes / totalBytes;
+  if (passPct > 1) { passPct = 1; }
+  if (overallPct > 1) { overallPct = 1; }
+  
+  seconds = seconds_since(&pProgress->startTime);
+  if (bytes && seconds > 0 && bytes < totalBytes)
+  {
+    format_duration(eta, seconds * (totalBytes - bytes) / bytes);
+  }
+  else
+  {
+    strcpy(eta, "UNKNOWN");
+  }
+  
+  sprintf(logStr, "[%s] Pass %d/%d, %.2f%% Finished (%.2f%% overall). - "
+      "%s lines, %.1f MB/s, ETA %s", pProgress->pPhase, pProgress->passNum,
+      pProgress->passTotal, passPct * 100, overallPct * 100, digit,
+      seconds > 0 ? bytes / seconds / (1024 * 1024) : 0, eta);
+  log_msg(logStr, LOG_DEBUG, pParam);
+}
+
+static double seconds_since(struct timespec *pFrom)
+{
+  struct timespec now;
+  
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  
+  return (double) (now.tv_sec - pFrom->tv_sec) +
+      (double) (now.tv_nsec - pFrom->tv_nsec) / 1e9;
+}
+
+/* Format seconds as h:mm:ss. */
+static void format_duration(char *pStr, double seconds)
+{
+  unsigned long s;
+  
+  s = (unsigned long) (seconds + 0.5);
+  sprintf(pStr, "%lu:%02lu:%02lu", s / 3600, s / 60 % 60, s % 60);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* 
+ * File:   progress.h
+ * 
+ * Content: Declarations of global functions in progress.c .
+ *
+ * Created on October 19, 2026, 2:15 PM
+ */
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Counting is done with relaxed atomic additions, so that the hot loop never
+ waits for the reporter thread, and never calls time() by itself. */
+#define progress_add(pCounter, n) \
+    __atomic_fetch_add((pCounter), (n), __ATOMIC_RELAXED)
+
+void progress_start(struct Parameters *pParam);
+void progress_begin_pass(char *pPhase, struct Parameters *pParam);
+void progress_end_pass(struct Parameters *pParam);
+void progress_stop(struct Parameters *pParam);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROGRESS_H */
+
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* 
+ * File:   regex_backend.c
+ * 
+ * Content: Regular expression backends. Every regular expression given in 
+ * command line ('--separator', '--lfilter', '--wfilter' and '--wsearch') is 
+ * compiled and matched through this module.
+ * 
+ * If the program is built with HAVE_PCRE2 defined (see Makefile), PCRE2 is 
+ * used, and the compiled patterns are JIT-compiled when the platform supports 
+ * it. This gives Perl syntax (\d, \s, named groups (?<name>...)) and a much 
+ * faster matching. Otherwise POSIX extended regular expressions are used.
+ * 
+ * Matching results are always reported with regmatch_t, in the same way as 
+ * regexec() does, so that callers do not need to know which backend is used.
+ *
+ * Created on October 19, 2026, 9:02 AM
+ */
+
+#include "common_header.h"
+#include "regex_backend.h"
+
+#include <string.h>    /* for strlen() */
+
+#include "output.h"
+
+#ifdef HAVE_PCRE2
+
+static void report_match_error(int errorCode, struct LineParser *pParser);
+
+int regex_compile(struct Regex *pRegex, char *pPattern,
+        struct Parameters *pParam)
+{
+  int errorCode;
+  PCRE2_SIZE errorOffset;
+  PCRE2_UCHAR errorStr[MAXLOGMSGLEN];
+  char logStr[MAXLOGMSGLEN];
+  
+  pRegex->pCode = pcre2_compile((PCRE2_SPTR) pPattern, PCRE2_ZERO_TERMINATED,
+          0, &errorCode, &errorOffset, 0);
+  if (!pRegex->pCode)
+  {
+    pcre2_get_error_message(errorCode, errorStr, sizeof(errorStr));
+    snprintf(logStr, MAXLOGMSGLEN,
+        "PCRE2: %.100s (at offset %lu of '%.100s')", (char *) errorStr,
+        (unsigned long) errorOffset, pPattern);
+    log_msg(logStr, LOG_ERR, pParam);
+    return 0;
+  }
+  
+  /* JIT compilation is not available on every platform. If it fails, the
+   pattern is still usable with the interpretive pcre2_match(). */
+  pRegex->bJit = (pcre2_jit_compile(pRegex->pCode, PCRE2_JIT_COMPLETE) == 0);
+  
+  return 1;
+}
+
+/* The match results of any regular expression matched by the thread that
+ owns pParser are stored in pParser->pMatchData, which has room for
+ MAXPARANEXPR groups. */
+void regex_match_init(struct LineParser *pParser, struct Parameters *pParam)
+{
+  pParser->pMatchData = pcre2_match_data_create(MAXPARANEXPR, 0);
+  if (!pParser->pMatchData)
+  {
+    log_msg(MALLOC_ERR_6021, LOG_ERR, pParam);
+    exit(1);
+  }
+  pParser->pParam = pParam;
+}
+
+void regex_match_free(struct LineParser *pParser)
+{
+  pcre2_match_data_free(pParser->pMatchData);
+  pParser->pMatchData = 0;
+}
+
+/* Returns 0 if there is a match, otherwise REG_NOMATCH, the same as regexec()
+ does. Unused or unset groups in pMatch[] are set to -1. Any other error (e.g.
+ the match or JIT stack limit was hit) would silently give wrong clusters if
+ it were taken as no match, thus it is reported and the program exits. */
+int regex_exec(struct Regex *pRegex, char *pStr, size_t nmatch, 
+        regmatch_t *pMatch, struct LineParser *pParser)
+{
+  int ret;
+  size_t i, groups;
+  PCRE2_SIZE *pOvector;
+  
+  if (pRegex->bJit)
+  {
+    ret = pcre2_jit_match(pRegex->pCode, (PCRE2_SPTR) pStr, strlen(pStr), 0,
+            0, pParser->pMatchData, 0);
+  }
+  else
+  {
+    ret = pcre2_match(pRegex->pCode, (PCRE2_SPTR) pStr, strlen(pStr), 0, 0,
+            pParser->pMatchData, 0);
+  }
+  
+  if (ret == PCRE2_ERROR_NOMATCH)
+  {
+    return REG_NOMATCH;
+  }
+  
+  if (ret < 0)
+  {
+    report_match_error(ret, pParser);
+  }
+  
+  if (!nmatch)
+  {
+    return 0;
+  }
+  
+  /* ret is 0 if the ovector was too small to hold all groups. */
+  groups = ret ? (size_t) ret :
+  pcre2_get_ovector_count(pParser->pMatchData);
+  pOvector = pcre2_get_ovector_pointer(pParser->pMatchData);
+  
+  for (i = 0; i < nmatch; i++)
+  {
+    if (i < groups && pOvector[2 * i] != PCRE2_UNSET)
+    {
+      pMatch[i].rm_so = (regoff_t) pOvector[2 * i];
+      pMatch[i].rm_eo = (regoff_t) pOvector[2 * i + 1];
+    }
+    else
+    {
+      pMatch[i].rm_so = -1;
+      pMatch[i].rm_eo = -1;
+    }
+  }
+  
+  return 0;
+}
+
+static void report_match_error(int errorCode, struct LineParser *pParser)
+{
+  PCRE2_UCHAR errorStr[MAXLOGMSGLEN];
+  char logStr[MAXLOGMSGLEN];
+  
+  pcre2_get_error_message(errorCode, errorStr, sizeof(errorStr));
+  snprintf(logStr, MAXLOGMSGLEN, "PCRE2: matching failed: %.200s",
+      (char *) errorStr);
+  log_msg(logStr, LOG_ERR, pParser->pParam);
+  exit(1);
+}
+
+/* Returns the number of the named group (?<name>...), or -1 if the pattern
+ has no such group. */
+int regex_group_number(struct Regex *pRegex, char *pName)
+{
+  int ret;
+  
+  ret = pcre2_substring_number_from_name(pRegex->pCode, (PCRE2_SPTR) pName);
+  
+  return ret < 0 ? -1 : ret;
+}
+
+void regex_free(struct Regex *pRegex)
+{
+  pcre2_code_free(pRegex->pCode);
+}
+
+char *regex_backend_name()
+{
+  return "PCRE2 (JIT when available)";
+}
+
+#else
+
+int regex_compile(struct Regex *pRegex, char *pPattern,
+        struct Parameters *pParam)
+{
+  int errorCode;
+  char errorStr[MAXLOGMSGLEN];
+  char logStr[MAXLOGMSGLEN];
+  
+  errorCode = regcomp(&pRegex->posix, pPattern, REG_EXTENDED);
+  if (errorCode)
+  {
+    regerror(errorCode, &pRegex->posix, errorStr, MAXLOGMSGLEN);
+    snprintf(logStr, MAXLOGMSGLEN, "POSIX regex: %.100s ('%.128s')",
+        errorStr, pPattern);
+    log_msg(logStr, LOG_ERR, pParam);
+    return 0;
+  }
+  
+  return 1;
+}
+
+/* regexec() is reentrant, thus no storage is needed per thread. */
+void regex_match_init(struct LineParser *pParser, struct Parameters *pParam)
+{
+  pParser->pParam = pParam;
+}
+
+void regex_match_free(struct LineParser *pParser)
+{
+}
+
+/* Returns 0 if there is a match, otherwise REG_NOMATCH. */
+int regex_exec(struct Regex *pRegex, char *pStr, size_t nmatch, 
+        regmatch_t *pMatch, struct LineParser *pParser)
+{
+  return regexec(&pRegex->posix, pStr, nmatch, pMatch, 0);
+}
+
+/* Named groups are not supported by POSIX regular expressions. */
+int regex_group_number(struct Regex *pRegex, char *pName)
+{
+  return -1;
+}
+
+void regex_free(struct Regex *pRegex)
+{
+  regfree(&pRegex->posix);
+}
+
+char *regex_backend_name()
+{
+  return "POSIX";
+}
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* 
+ * File:   regex_backend.h
+ * 
+ * Content: Declarations of global functions in regex_backend.c .
+ *
+ * Created on October 19, 2026, 9:02 AM
+ */
+
+#ifndef REGEX_BACKEND_H
+#define REGEX_BACKEND_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <regex.h>     /* for regmatch_t */
+  
+int regex_compile(struct Regex *pRegex, char *pPattern,
+        struct Parameters *pParam);
+void regex_match_init(struct LineParser *pParser, struct Parameters *pParam);
+void regex_match_free(struct LineParser *pParser);
+int regex_exec(struct Regex *pRegex, char *pStr, size_t nmatch, 
+        regmatch_t *pMatch, struct LineParser *pParser);
+int regex_group_number(struct Regex *pRegex, char *pName);
+void regex_free(struct Regex *pRegex);
+char *regex_backend_name();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REGEX_BACKEND_H */
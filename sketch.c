@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * File:   sketch.c
+ *
+ * Content: Parallel passes over the data set which build the word sketch and
+ * the cluster sketch ('--wsize' and '--csize' options).
+ *
+ * Created on October 19, 2026, 11:05 PM
+ */
+
+#include "common_header.h"
+#include "sketch.h"
+
+#include "output.h"
+#include "line_processing.h"
+#include "hash_table_processing.h"
+#include "input_chunks.h"
+#include "thread_pool.h"
+#include "table_alloc.h"
+
+/* The input chunks are processed by the workers in any order, each worker
+ counting into its own sketch. Afterwards the sketches are summed up slot by
+ slot, which is done in parallel for slices of SKETCH_MERGE_SLICE slots, and
+ the slots reaching the support threshold are counted in the same loop. */
+
+static void sketch_chunk_body(unsigned long index, int worker, void *pArg);
+static void sketch_merge_body(unsigned long index, int worker, void *pArg);
+static void add_slots(support_t *restrict pDest, 
+        const support_t *restrict pSrc, tableindex_t num);
+static tableindex_t add_and_count_slots(support_t *restrict pDest,
+        const support_t *restrict pSrc, tableindex_t num, support_t support);
+
+/* Read the data set, calling pLine for every line, which counts into the
+ sketch of the worker. pSketch (size slots, zeroed, see table_alloc()) gets the
+ counts of worker 0, the others are added by sketch_pass_merge(). Returns the
+ number of lines. */
+support_t sketch_pass_run(struct SketchPass *pPass, support_t *pSketch,
+        tableindex_t size, sketch_line_t pLine, struct Parameters *pParam)
+{
+  struct SketchWorker *pWorker;
+  support_t linecount;
+  int w;
+  
+  pPass->pSketch = pSketch;
+  pPass->size = size;
+  pPass->pLine = pLine;
+  pPass->pParam = pParam;
+  pPass->pChunks = plan_input_chunks(&pPass->chunkNum, pParam);
+  pPass->pWorkers = (struct SketchWorker *) malloc(pParam->threadNum * 
+                           sizeof(struct SketchWorker));
+  if (!pPass->pWorkers)
+  {
+    log_msg(MALLOC_ERR_6037, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  for (w = 0; w < pParam->threadNum; w++)
+  {
+    pWorker = pPass->pWorkers + w;
+    pWorker->linecount = 0;
+    word_cache_init(&pWorker->cache);
+    pWorker->pWords = (char (*)[MAXWORDLEN]) malloc(MAXWORDS * MAXWORDLEN);
+    
+    if (w == 0)
+    {
+      pWorker->pSketch = pSketch;
+      pWorker->pParser = &pParam->lineParser;
+    }
+    else
+    {
+      pWorker->pSketch = (support_t *) table_alloc(size * sizeof(support_t),
+                             pParam);
+      line_parser_init(&pWorker->parser, pParam);
+      pWorker->pParser = &pWorker->parser;
+    }
+    
+    if (!pWorker->pWords || !pWorker->pSketch)
+    {
+      log_msg(MALLOC_ERR_6037, LOG_ERR, pParam);
+      exit(1);
+    }
+  }
+  
+  parallel_for(pPass->chunkNum, sketch_chunk_body, pPass, pParam);
+  
+  linecount = 0;
+  for (w = 0; w < pParam->threadNum; w++)
+  {
+    pWorker = pPass->pWorkers + w;
+    linecount += pWorker->linecount;
+    word_cache_flush(&pWorker->cache, pParam);
+    free((void *) pWorker->pWords);
+    if (w)
+    {
+      line_parser_free(&pWorker->parser);
+    }
+  }
+  
+  free((void *) pPass->pChunks);
+  
+  return linecount;
+}
+
+/* Add the sketches of the other workers into the result, and release them.
+ Returns the number of slots >= support. */
+tableindex_t sketch_pass_merge(struct SketchPass *pPass, support_t support)
+{
+  struct Parameters *pParam;
+  unsigned long sliceNum, i;
+  tableindex_t oversupport;
+  int w;
+  
+  pParam = pPass->pParam;
+  pPass->support = support;
+  
+  sliceNum = (pPass->size + SKETCH_MERGE_SLICE - 1) / SKETCH_MERGE_SLICE;
+  pPass->pOversupport = (tableindex_t *) malloc((sliceNum + 1) * 
+                          sizeof(tableindex_t));
+  if (!pPass->pOversupport)
+  {
+    log_msg(MALLOC_ERR_6038, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  parallel_for(sliceNum, sketch_merge_body, pPass, pParam);
+  
+  oversupport = 0;
+  for (i = 0; i < sliceNum; i++)
+  {
+    oversupport += pPass->pOversupport[i];
+  }
+  
+  for (w = 1; w < pParam->threadNum; w++)
+  {
+    table_free((void *) pPass->pWorkers[w].pSketch, 
+           pPass->size * sizeof(support_t), pParam);
+  }
+  free((void *) pPass->pWorkers);
+  free((void *) pPass->pOversupport);
+  
+  return oversupport;
+}
+
+static void sketch_chunk_body(unsigned long index, int worker, void *pArg)
+{
+  struct SketchPass *pPass;
+  struct SketchWorker *pWorker;
+  struct ChunkReader reader;
+  
+  pPass = (struct SketchPass *) pArg;
+  pWorker = pPass->pWorkers + worker;
+  
+  if (!chunk_reader_open(&reader, pPass->pChunks + index, pPass->pParam))
+  {
+    return;
+  }
+  
+  while (chunk_reader_read_line(&reader, pWorker->line, pPass->pParam))
+  {
+    pPass->pLine(pWorker, pPass->pParam);
+    pWorker->linecount++;
+  }
+  
+  chunk_reader_close(&reader);
+}
+
+static void sketch_merge_body(unsigned long index, int worker, void *pArg)
+{
+  struct SketchPass *pPass;
+  support_t *pDest;
+  tableindex_t begin, num;
+  int w, last;
+  
+  pPass = (struct SketchPass *) pArg;
+  
+  begin = (tableindex_t) index * SKETCH_MERGE_SLICE;
+  num = pPass->size - begin < SKETCH_MERGE_SLICE ? 
+      pPass->size - begin : SKETCH_MERGE_SLICE;
+  pDest = pPass->pSketch + begin;
+  last = pPass->pParam->threadNum - 1;
+  
+  for (w = 1; w < last; w++)
+  {
+    add_slots(pDest, pPass->pWorkers[w].pSketch + begin, num);
+  }
+  
+  pPass->pOversupport[index] = add_and_count_slots(pDest,
+      last ? pPass->pWorkers[last].pSketch + begin : 0, num, pPass->support);
+}
+
+/* The loops below are kept simple, so that the compiler can vectorize them. */
+static void add_slots(support_t *restrict pDest, 
+        const support_t *restrict pSrc, tableindex_t num)
+{
+  tableindex_t j;
+  
+  for (j = 0; j < num; j++)
+  {
+    pDest[j] += pSrc[j];
+  }
+}
+
+/* If pSrc is 0, the slots of pDest are only counted. */
+static tableindex_t add_and_count_slots(support_t *restrict pDest,
+        const support_t *restrict pSrc, tableindex_t num, support_t support)
+{
+  tableindex_t j, oversupport;
+  
+  oversupport = 0;
+  
+  if (pSrc)
+  {
+    for (j = 0; j < num; j++)
+    {
+      pDest[j] += pSrc[j];
+      oversupport += pDest[j] >= support;
+    }
+  }
+  else
+  {
+    for (j = 0; j < num; j++)
+    {
+      oversupport += pDest[j] >= support;
+    }
+  }
+  
+  return oversupport;
+}
+
@@ -33,6 +33,12 @@ extern "C" {
 #include "macro.h"
 #include <regex.h>
 #include <time.h>
+#include <pthread.h>
+
+#ifdef HAVE_PCRE2
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#endif
 
 /* ==== Struct definitions ==== */
 
@@ -40,14 +46,45 @@ struct Cluster;    //declaration
 
 /* This struct stores input file(s)'s path(s).
  
- lineNumber is the count of lines of this file. It is used for debug purpose,
- helps in the calculation of the mining process status. */
+ fileSize is the size of this file in bytes, gotten with stat() when the file
+ is added. It is used for the calculation of the mining process status. */
 struct InputFile {
   char *pName;
-  linenumber_t lineNumber;
+  unsigned long long fileSize;
   struct InputFile *pNext;
 };
 
+/* A byte range [begin, end) of an input file, which is processed as one unit
+ of a parallel pass. A chunk owns every line that starts inside its range,
+ including the end of the last line, which may run past end. end is -1 if the
+ chunk runs to the end of the file (the size of the file is unknown).
+ 
+ fileNum is 1 for a range of one file. Small files are batched into one chunk,
+ then the chunk reads fileNum whole files, starting from pFile. */
+struct InputChunk {
+  struct InputFile *pFile;
+  long long begin;
+  long long end;
+  int fileNum;
+};
+
+/* Reader of the lines of one InputChunk. pos is the offset of the next byte
+ in the file. bLineOpen is set if the last piece returned did not end a line,
+ then the next piece still belongs to this chunk, even if pos >= end.
+ pNextFile is the next file of a batch to be opened, filesLeft is the number
+ of files still to be opened. lines and bytes have been read, but not yet
+ added to the progress counters. */
+struct ChunkReader {
+  FILE *pFile;
+  long long pos;
+  long long end;
+  int bLineOpen;
+  struct InputFile *pNextFile;
+  int filesLeft;
+  support_t lines;
+  unsigned long long bytes;
+};
+
 /* This struct stores elements that are placed into hash tables. One element can
  be a word or a cluster candidate.
  
@@ -74,13 +111,227 @@ struct Elem {
 };
 
 /* This struct stores information of templates, which is set with option
- '--template'. */
+ '--template'.
+ 
+ A literal string is stored in pStr, and data is its length. A match variable
+ has pStr set to null(0), and data is the number of the match variable. For a
+ named match variable ($+{name}), pName stores the name until it is resolved
+ into a number, after '--lfilter' regular expression has been compiled. */
 struct TemplElem {
   char *pStr;
+  char *pName;
   int data;
   struct TemplElem *pNext;
 };
 
+/* This struct is one instruction of the compiled template. After option
+ parsing, the chain of {struct TemplElem} is flattened into an array of these
+ instructions, so that converting a line does not need to walk a linked list.
+ 
+ A literal string has pStr pointing to the string in {struct TemplElem}, and
+ data is its length. A match variable has pStr set to null(0), and data is the
+ number of the match variable. */
+struct TemplInstr {
+  char *pStr;
+  int data;
+};
+
+/* This struct stores a compiled regular expression. Which members are used
+ depends on the regular expression backend (see regex_backend.c).
+ 
+ With PCRE2, pCode is the compiled pattern, and bJit tells whether it was also
+ JIT-compiled. The storage for the match results belongs to the thread that
+ matches (see {struct LineParser}). Without PCRE2, POSIX extended regular
+ expression is stored in posix. */
+struct Regex {
+#ifdef HAVE_PCRE2
+  pcre2_code *pCode;
+  int bJit;
+#else
+  regex_t posix;
+#endif
+};
+
+/* This struct is a slot of the '--wfilter/--wsearch/--wreplace' memo cache.
+ 
+ pKey is the original word. The buffer is allocated together with the
+ rewritten word, which is stored right after the terminating null of pKey.
+ 
+ pRewritten points to the rewritten word inside the same buffer, if the word
+ is filtered. Otherwise, it shall be null(0). */
+struct WordFilterCacheSlot {
+  char *pKey;
+  char *pRewritten;
+};
+
+/* This struct stores the working storage for splitting lines into words, and
+ for rewriting them. The compiled regular expressions and templates are
+ shared, but every thread that processes lines needs its own LineParser. The
+ main thread uses pParam->lineParser.
+ 
+ pMatchData: with PCRE2, the storage for the match results of any regular
+ expression.
+ 
+ pParam: the parameters, used for reporting matching errors.
+ 
+ pTemplateBuffer: reusable buffer for the line converted with '--template'
+ option. Its size is calculated from the compiled template, so that it can
+ hold the longest possible result.
+ 
+ pWordFilterCache: memo cache of '--wfilter/--wsearch/--wreplace' results,
+ keyed by the original word. It is allocated on first use and kept for all
+ passes over the data set, so the regular expressions are only evaluated once
+ for each distinct word (unless the word is evicted by another word colliding
+ in the same slot).
+ 
+ tmpStr: To avoid modifying original words that is gotten from log lines, we
+ make a copy of it in tmpStr and do modification on this copy. */
+struct LineParser {
+#ifdef HAVE_PCRE2
+  pcre2_match_data *pMatchData;
+#endif
+  struct Parameters *pParam;
+  char *pTemplateBuffer;
+  struct WordFilterCacheSlot *pWordFilterCache;
+  char tmpStr[MAXWORDLEN];
+};
+
+/* This struct is a slot of the hot word cache (see WordCache). hash is the
+ slot of the word in the word table, len is its length, and prefix holds its
+ first sizeof(unsigned long) bytes, padded with zeros. A word not longer than
+ prefix is identified by these alone, a longer one is compared to pElem. */
+struct WordCacheSlot {
+  tableindex_t hash;
+  unsigned long prefix;
+  size_t len;
+  struct Elem *pElem;
+};
+
+/* Direct-mapped cache of recently used words of the word table, which is small
+ enough to stay in the L1 cache. Most words of a log are a few hundred common
+ ones, which are then found without touching the word table. Every thread has
+ its own cache for a pass, the words can not be freed while it is used.
+ lookups and hits are added to the counters of the pass for '--debug' output
+ by word_cache_flush(). If less than 1/WORD_CACHE_MIN_HIT_DIV of the first
+ WORD_CACHE_PROBE lookups hit, the words of the log are too diverse for the
+ cache, and bOff is set to look up all words in the word table. */
+struct WordCache {
+  struct WordCacheSlot slots[WORD_CACHE_SIZE];
+  unsigned long lookups;
+  unsigned long hits;
+  int bChecked;
+  int bOff;
+};
+
+struct SketchWorker;
+struct Parameters;
+
+/* Called for every line of a sketch pass, which is in pWorker->line. It
+ increments the slots of pWorker->pSketch. */
+typedef void (*sketch_line_t)(struct SketchWorker *pWorker,
+        struct Parameters *pParam);
+
+/* Scratch storage of one worker of a sketch pass ('--wsize' and '--csize'
+ options). Every worker counts into its own sketch, so no synchronization is
+ needed; worker 0 counts directly into the result. pParser points to parser,
+ or to the parser in struct Parameters for worker 0. pWords is allocated
+ separately, because it is too big for the stack of a worker thread. */
+struct SketchWorker {
+  struct LineParser parser;
+  struct LineParser *pParser;
+  char (*pWords)[MAXWORDLEN];
+  char line[MAXLINELEN];
+  char key[MAXKEYLEN];
+  support_t *pSketch;
+  support_t linecount;
+  struct WordCache cache;
+};
+
+struct PipelineWorker;
+struct PipelineBatch;
+
+/* Callbacks of a pass pipeline (pipeline.c). The tokenizer callback is called
+ by several threads, it turns a line into a record with pipeline_append() and
+ pipeline_commit(). The consumer callback is called by one thread for every
+ record of len bytes, in the order of the input (by several threads, in no
+ particular order, with pipeline_run_shared()); pArg is the state of the
+ pass. */
+typedef void (*pipeline_tokenize_t)(char *line, struct PipelineWorker *pWorker,
+        struct Parameters *pParam);
+typedef void (*pipeline_consume_t)(char *pRecord, size_t len, void *pArg);
+
+/* Scratch storage of one tokenizer of a pass pipeline. pParser points to
+ parser, or to the parser in struct Parameters for the first tokenizer. The
+ records are appended to pBatch, the open record starts at recordStart.
+ pWords is allocated separately, because it is too big for the stack of a
+ worker thread. */
+struct PipelineWorker {
+  struct LineParser parser;
+  struct LineParser *pParser;
+  char (*pWords)[MAXWORDLEN];
+  char key[MAXKEYLEN];
+  struct Elem *pStorage[MAXWORDS + 1];
+  int wildcard[MAXWORDS + 1];
+  wordnumber_t wordNumStr[MAXWORDS + 1];
+  struct PipelineBatch *pBatch;
+  size_t recordStart;
+  int bRecordOpen;
+  struct WordCache cache;
+  struct Parameters *pParam;
+};
+
+/* A pass over the data set that builds the sketch pSketch of size slots. */
+struct SketchPass {
+  support_t *pSketch;
+  tableindex_t size;
+  sketch_line_t pLine;
+  struct InputChunk *pChunks;
+  unsigned long chunkNum;
+  struct SketchWorker *pWorkers;
+  tableindex_t *pOversupport;
+  support_t support;
+  struct Parameters *pParam;
+};
+
+/* This struct is dedicated to progress reporting.
+ 
+ lines and bytes count the lines(and their bytes) read from input files in all
+ passes over the data set. They are updated with atomic operations by
+ read_line(), and sampled by the reporter thread in '--debug' level 2 and 3
+ (see progress.c).
+ 
+ totalBytes is the sum of input file sizes, i.e. the bytes of one pass.
+ 
+ pPhase is the name of the current pass over the data set, passNum is its
+ serial number (starting from 1), and passTotal is the number of passes.
+ cacheLookups and cacheHits sum up the hot word caches of the current pass.
+ passStartLines/Bytes/Time are the counters and the time when the current pass
+ started, startTime is the time when the first pass started. They are
+ protected by mutex, since the reporter thread reads them.
+ 
+ bStop tells the reporter thread to exit, it is also protected by mutex, and
+ the reporter thread waits on cond between two samples. bRunning is set if the
+ reporter thread has been started. */
+struct Progress {
+  support_t lines;
+  unsigned long long bytes;
+  unsigned long long totalBytes;
+  char *pPhase;
+  unsigned long long cacheLookups;
+  unsigned long long cacheHits;
+  int passNum;
+  int passTotal;
+  support_t passStartLines;
+  unsigned long long passStartBytes;
+  struct timespec passStartTime;
+  struct timespec startTime;
+  char bStop;
+  char bRunning;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+
 /* Word frequency statistics. */
 struct WordFreqStat {
   wordnumber_t ones;
@@ -113,9 +364,9 @@ struct WordFreqStat {
  ppWord is an array that stores each constant's element, which is stored in word
  hash table.
  
- If Aggregate_Supports heuristics is used('--aggrsup' option), pLastNode is the
- address of the cluster candidate's last node in prefix tree. According to this
- address, this cluster candidate's parent and other relatives can be back
+ If Aggregate_Supports heuristics is used('--aggrsup' option), lastNode is the
+ index of the cluster candidate's last node in prefix tree array. According to
+ this index, this cluster candidate's parent and other relatives can be back
  tracked. Prefix tree(aka trie) is build for efficiently looking up for cluster
  candidates that have a common prefix, thus efficiently checking if one cluster
  candidate's support value can be aggregated to another.
@@ -141,60 +392,81 @@ struct Cluster {
   int *fullWildcard;
   struct Elem *pElem;
   struct Elem **ppWord;
-  struct TrieNode *pLastNode;
+  trieindex_t lastNode;
   char bIsJoined;
   struct Cluster *pNext;
 };
 
 /*This struct is dedicated to Join_Clusters heuristics.
  
+ The words joined into one token, in the order they were joined. There is
+ room for size words in ppWord, and num of them are used.
+ 
  More details are in the description of {struct ClusterWithToken}. */
-struct Token {
-  struct Elem *pWord;
-  struct Token *pNext;
+struct TokenSet {
+  struct Elem **ppWord;
+  int num;
+  int size;
 };
 
 /*This struct is dedicated to Join_Clusters heuristics.
  
  If a cluster has token, this cluster's bIsJoined will be marked, and this
- cluster's information stored in {struct Cluster} will be copied into a new
- struct {struct ClusterWithToken}.
+ cluster is joined into a {struct ClusterWithToken} with the other clusters
+ that have the same constants, except the tokens.
  
- Compared to {struct Cluster}, there are only two different attributes: pNext
- and ppToken. The other attributes store the same information as in former
- {struct Cluster}.
+ pKey: the identifier of the joined cluster. It is the sequence of the
+ constants' frequent word numbers, where every token is 0. hash is calculated
+ from pKey, the joined clusters are looked up in pParam->ppJoinedTable.
  
  pNext: We continue to use the same way of storage organization as
  {struct Cluster}, but only uses a different name pClusterWithTokenFamily[].
  pNext stores the address of next {struct ClusterWithToken} that shares the same
  slot in pClusterWithTokenFamily[].
  
- ppToken: For every cluster that has token and thus transfered into
- {struct ClusterWithToken}, we malloc an array according to its constants. Every
- constant has a slot to store tokens, which contain the original words(which are
- frequent words, but are under word weight threshold). When printing clusters in
- pClusterWithTokenFamily[], we can know the original words from ppToken, and
- print strings contain word summary, such like:
+ pTokens: Every constant has a slot to store tokens, which contain the original
+ words(which are frequent words, but are under word weight threshold). When
+ printing clusters in pClusterWithTokenFamily[], we can know the original words
+ from pTokens, and print strings contain word summary, such like:
  
  Interface *{2,3}(A|B|C) *{0,2}  
    
  A, B, and C represent the words that are under word weight threshold, and thus
  joined.
- */
+ 
+ elem: the joined cluster is not in the cluster hash table. elem only carries
+ its count for sorting the clusters before printing, and its pCluster is 0.
+ elem is the first member, so a pointer to elem is also a pointer to the
+ {struct ClusterWithToken}.
+ 
+ The arrays pKey, ppWord, pTokens and fullWildcard are allocated together with
+ the struct, in one block. */
 struct ClusterWithToken {
+  struct Elem elem;
   int constants;
   support_t count;
-  int *fullWildcard;
-  struct Elem *pElem;
+  unsigned long hash;
+  wordnumber_t *pKey;
   struct Elem **ppWord;
-  struct TrieNode  *pLastNode;
-  char bIsJoined;
+  struct TokenSet *pTokens;
+  int *fullWildcard;
   struct ClusterWithToken *pNext;
-  
-  /*The order of elements in this struct matters. In later process, type
-   {struct ClusterWithToken} and type {struct Cluster} will be force
-   transfered to each other.*/
-  struct Token **ppToken;
+};
+
+/* Buffered writer of the cluster output ('--outputformat' option).
+ 
+ pBuffer holds size bytes, of which used bytes are formatted, but not yet
+ written to the file descriptor fd. clusterId is the number of clusters
+ written so far, it is the ID of the last one. */
+struct ClusterWriter {
+  char *pBuffer;
+  size_t used;
+  size_t size;
+  unsigned long clusterId;
+  int fd;
+  char format;
+  char bDetailedTokenFlag;
+  struct Parameters *pParam;
 };
 
 /* This struct is dedicated to Aggregate_Supports heuristics.
@@ -212,23 +484,24 @@ struct ClusterWithToken {
  When node is a wildcard, we store its minimum and maximum value in wildcardMin
  and wildcardMax.
  
- hashValue is for efficiently inserting and looking up. Only if their 
- hashValue-s are equal, we will then use strcmp() or wildcardMin/Max compare to
- see if the node to be inserted is already exist, because strcmp() is an 
- expensive process regarding computing speed.
- 
- When node is a constant, hashValue is calculated by str2hash() function, with a
- hash module size (frequent word number) * 3.
+ key is for efficiently inserting and looking up. When node is a constant, key
+ is the number of the frequent word (1...frequent word number), which is unique
+ for every frequent word, thus no string comparison is needed.
  
- When node is a wildcard, its hashValue is (frequent word number) * 3. Thus, all
- wildcards, regardless of their minimun and maximum, have the same hashValue.
+ When node is a wildcard, its key is (frequent word number) + 1. Thus, all
+ wildcards, regardless of their minimun and maximum, have the same key. We
+ then compare wildcardMin/Max to see if the node to be inserted is already
+ exist.
  
  Nodes in the same horizontal level and with a common parent, are arranged
- from left to right with a descending hashValue. Therefore, when inserting new
- node in prefix tree, we check if it already exist by comparing hashValue, with
+ from left to right with a descending key. Therefore, when inserting new
+ node in prefix tree, we check if it already exist by comparing key, with
  an order from big to small. In other words, wildcards are always in the front
  part of comparison, which takes advantage of the statistics feature of cluster 
  candidates.
+ 
+ These linked nodes are only used for building the prefix tree. Afterwards, the
+ prefix tree is copied into an array of {struct TrieArrayNode}.
  */
 struct TrieNode {
   struct TrieNode *pParent;
@@ -238,7 +511,70 @@ struct TrieNode {
   struct Elem *pWord;
   int wildcardMin;
   int wildcardMax;
-  wordnumber_t hashValue;
+  wordnumber_t key;
+};
+
+/* This struct is dedicated to Aggregate_Supports heuristics.
+ 
+ {struct TrieNode} are not malloc()ed one by one, but taken from blocks of
+ TRIE_POOL_BLOCK nodes. used is the number of nodes taken from this block.
+ The blocks are chained by pNext, and all nodes are released at once by
+ freeing the blocks. */
+struct TrieNodeBlock {
+  struct TrieNodeBlock *pNext;
+  int used;
+  struct TrieNode nodes[TRIE_POOL_BLOCK];
+};
+
+/* This struct is dedicated to Aggregate_Supports heuristics.
+ 
+ It is a node of the prefix tree after building is done. All nodes are stored
+ in one array in breadth-first order, with root at index 0. The children of a
+ node are stored contiguously, from index firstChild, and there are childNum of
+ them. parent is the index of the parent node.
+ 
+ key, pIsEnd, wildcardMin and wildcardMax have the same meanings as in 
+ {struct TrieNode}. A node is a constant if its wildcardMax is 0.
+ 
+ wordBloom and maxConstants summarize the subtree rooted at this node (the node
+ itself included), so that the aggregation can skip subtrees that can not
+ contain the constants it is looking for. wordBloom has TRIE_BLOOM_BIT() set
+ for every constant in the subtree. maxConstants is the biggest number of
+ constants on a path from this node down to a leaf. subtreeSize is the number
+ of nodes in the subtree, it estimates the cost of searching the subtree.
+ subtreeSupport is the summed support of the cluster candidates ending in the
+ subtree. */
+struct TrieArrayNode {
+  wordnumber_t key;
+  struct Cluster *pIsEnd;
+  unsigned long long wordBloom;
+  trieindex_t parent;
+  trieindex_t firstChild;
+  trieindex_t childNum;
+  trieindex_t subtreeSize;
+  support_t subtreeSupport;
+  int maxConstants;
+  int wildcardMin;
+  int wildcardMax;
+};
+
+/* This struct is dedicated to Aggregate_Supports heuristics.
+ 
+ It is an inverted index of cluster candidates, used instead of the prefix tree
+ ('--aggrengine' option). Every candidate has an id, which is its position in
+ ppCandidates. The ids of the candidates containing the frequent word with
+ number n are stored in pPostings[pPostingStart[n]...pPostingStart[n + 1] - 1],
+ in ascending order.
+ 
+ pScratch holds two buffers of maxPostingLen ids for every thread, used when
+ intersecting the posting lists. */
+struct CandidateIndex {
+  struct Cluster **ppCandidates;
+  unsigned long candidateNum;
+  unsigned long *pPostingStart;
+  unsigned int *pPostings;
+  unsigned long maxPostingLen;
+  unsigned int *pScratch;
 };
 
 /* This struct stores parameters. It can be considered as a storage for global
@@ -248,10 +584,15 @@ struct TrieNode {
 struct Parameters {
   /* >>> Below are parameters that can be changed by command line options. */
   char bAggrsupFlag;
+  char aggrEngine;
+  char outputFormat;
+  char vocabTable;
+  char bHugetlbFlag;
   char bDetailedTokenFlag;
   char *pDelim;
   char *pFilter;
   char *pOutlier;
+  char *pOutlierCompress;
   char *pSyslogFacility;
   char *pWordFilter;
   char *pWordReplace;
@@ -261,6 +602,7 @@ struct Parameters {
   int byteOffset;
   int debug;
   int outputMode;
+  int threadNum;
   int wordWeightFunction;
   struct InputFile *pInputFiles;
   struct TemplElem *pTemplate;
@@ -269,6 +611,7 @@ struct Parameters {
   tableindex_t wordSketchSize;
   tableindex_t wordTableSize;
   unsigned int initSeed;
+  wordnumber_t topNum;
   
   /* >>> Below are parameters that are not visible to user. */
   
@@ -289,8 +632,8 @@ struct Parameters {
   /* syslogThreshold is default to LOG_NOTICE(5). */
   int syslogThreshold;
   
-  regex_t delim_regex;
-  regex_t filter_regex;
+  struct Regex delim_regex;
+  struct Regex filter_regex;
   
   /* pClusterFamily[] stores {struct Cluster} according to their constants. */
   struct Cluster *pClusterFamily[MAXWORDS + 1];
@@ -325,15 +668,23 @@ struct Parameters {
   /* pPrefixRet is used for temporary storage. */
   struct TrieNode *pPrefixRet;
   
-  /* pPrefixRoot is the root of the prefix tree. */
-  struct TrieNode *pPrefixRoot;
+  /* Blocks holding the linked nodes while building the prefix tree. */
+  struct TrieNodeBlock *pTrieNodeBlocks;
   
-  tableindex_t prefixSketchSeed;
+  /* pTrie is the prefix tree array, its size is trieNodeNum. */
+  struct TrieArrayNode *pTrie;
   
-  /* prefixSketchSize will be set to (frequent word number) * 3. */
-  wordnumber_t prefixSketchSize;
+  /* Memory used by the prefix tree: trieBuildBytes by the node blocks while
+   building, trieBytes by pTrie[] afterwards. */
+  unsigned long long trieBuildBytes;
+  unsigned long long trieBytes;
   
-  wordnumber_t wildcardHash;
+  /* wildcardKey will be set to (frequent word number) + 1. */
+  wordnumber_t wildcardKey;
+  
+  /* Inverted index of cluster candidates, built if aggrEngine is not
+   AGGR_ENGINE_TRIE. */
+  struct CandidateIndex candidateIndex;
   
   /* >>>>>> Used in Join_Clusters heuristics. */
   
@@ -342,23 +693,15 @@ struct Parameters {
    generated and replace it.*/
   char token[TOKENLEN];
   
-  /* Temporarily mark a cluster's constant as token, for upcoming process's
-   usage. If this cluster has token, tokenMarker[0] is set to 1.
-   The corresponding constants's tokenMarker[] slot will also be set to 1. */
-  char tokenMarker[MAXWORDS + 1];
-  
-  /* When we calculate a cluter's constants' word weight, using function_2,
-   we will get every unique word out of constants. In order to avoid doing
-   this job every time for each constant in the same cluster(the result will
-   be the same), we use this pointer to indicate current cluster that is
-   under processing. We do this getting_unique_words job again only if our
-   target cluster differs from pCurrentCluster. */
-  struct Cluster *pCurrentCluster;
-  
   /* An array storages Clusters that have token. It's similar as
    pClusterFamily[]. */
   struct ClusterWithToken *pClusterWithTokenFamily[MAXWORDS + 1];
   
+  /* Open addressing hash table of the joined clusters. Its size is a power of
+   2, and it is kept at most half full. */
+  struct ClusterWithToken **ppJoinedTable;
+  tableindex_t joinedTableSize;
+  
   /* JoinedClusterInput/OutputNum are used for statistics purpose. They
    record how many clusters have been joined, and how many new clusters the
    joined clusters have generated. */
@@ -394,27 +737,37 @@ struct Parameters {
    this number before starting the data mining task. */
   int dataPassTimes;
   
-  /* Total line number of all input files. */
-  support_t totalLineNum;
-  char totalLineNumDigit[MAXDIGITBIT];  //digit format with comma, e.g. 123,456
+  /* Counters sampled by the progress reporter thread. */
+  struct Progress progress;
+  
+  /* Worker threads of parallel_for(), started on its first call (see
+   thread_pool.c). */
+  struct ThreadPool *pThreadPool;
+  
+  /* >>>>>> Used in '--template' option. */
   
-  time_t timeStorage;
+  /* The template compiled into an array of templateInstrNum instructions. */
+  struct TemplInstr *pTemplateInstr;
+  int templateInstrNum;
+  
+  /* Size of the buffer for the converted line(pTemplateBuffer of
+   {struct LineParser}). */
+  size_t templateBufferSize;
   
   /* >>>>>> Used in '--wfilter/--wsearch/--wreplace'options. */
   
-  regex_t wfilter_regex;
-  regex_t wsearch_regex;
+  struct Regex wfilter_regex;
+  struct Regex wsearch_regex;
+  
+  /* Seed of the memo cache of filtering and rewriting results. */
+  tableindex_t wordFilterCacheSeed;
   
   //char *pWordFilter;
   //char *pWordSearch;
   //char *pWordReplace;
   
-  /* To avoid modifying original words that is gotten from log lines, we use
-   tmpStr to make a copy of it and do modification on this copy.
-   With current functions, it is fine to direct modify original words, but
-   we define and use this tmpStr, in case there are other functions being
-   added in the future that are sensitive to this issue. */
-  char tmpStr[MAXWORDLEN];
+  /* Working storage of the main thread for processing lines. */
+  struct LineParser lineParser;
   
 };
 
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* 
+ * File:   table_alloc.c
+ * 
+ * Content: Allocation of the large arrays which are accessed at random (the
+ * word and cluster tables, the sketches and the word dependency matrix).
+ *
+ * Created on October 19, 2026, 11:55 PM
+ */
+
+#include "common_header.h"
+#include "table_alloc.h"
+
+#include <string.h>    /* for memset(), strerror() */
+#include <errno.h>     /* for errno */
+#include <sys/mman.h>  /* for mmap(), madvise(), etc. */
+#include <sys/syscall.h> /* for SYS_mbind */
+#include <unistd.h>    /* for syscall(), sysconf() */
+
+#include "output.h"
+#include "thread_pool.h"
+
+/* An array of TABLE_ALLOC_MIN bytes or more is mapped on its own, in huge
+ pages where possible (reserved huge pages only with '--hugetlb' option).
+ Random accesses to it then miss the TLB much less often. The arrays are
+ zeroed by the kernel, so there is no zeroing loop. In threaded mode, the
+ pages are interleaved over the NUMA nodes, since every thread reads the whole
+ array, and they are touched first in parallel, in slices of TABLE_TOUCH_SLICE
+ bytes. */
+
+/* Memory policy of mbind(), as in <numaif.h>, which comes with libnuma. */
+#define MPOL_INTERLEAVE_POLICY 3
+
+/* Asks mmap() for huge pages of TABLE_HUGE_PAGE (2 MB) bytes, instead of the
+ default huge page size of the system, as MAP_HUGE_2MB in <linux/mman.h>. */
+#define TABLE_MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+
+struct TouchJob {
+  char *pBase;
+  size_t size;
+  size_t pageSize;
+};
+
+static void *map_table(size_t size, struct Parameters *pParam);
+static void interleave_table(void *ptr, size_t size);
+static void touch_table_body(unsigned long index, int worker, void *pArg);
+
+/* Returns size bytes of zeroed memory, which is released by table_free() with
+ the same size. */
+void *table_alloc(size_t size, struct Parameters *pParam)
+{
+  struct TouchJob job;
+  void *ptr;
+  
+  if (size < TABLE_ALLOC_MIN)
+  {
+    ptr = calloc(size, 1);
+    if (!ptr)
+    {
+      log_msg(MALLOC_ERR_6041, LOG_ERR, pParam);
+      exit(1);
+    }
+    return ptr;
+  }
+  
+  size = (size + TABLE_HUGE_PAGE - 1) & ~((size_t) TABLE_HUGE_PAGE - 1);
+  ptr = map_table(size, pParam);
+  
+  if (pParam->threadNum > 1)
+  {
+    interleave_table(ptr, size);
+    
+    job.pBase = (char *) ptr;
+    job.size = size;
+    job.pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    parallel_for((size + TABLE_TOUCH_SLICE - 1) / TABLE_TOUCH_SLICE, 
+           touch_table_body, &job, pParam);
+  }
+  
+  return ptr;
+}
+
+void table_free(void *ptr, size_t size, struct Parameters *pParam)
+{
+  char logStr[MAXLOGMSGLEN];
+  
+  if (!ptr)
+  {
+    return;
+  }
+  
+  if (size < TABLE_ALLOC_MIN)
+  {
+    free(ptr);
+    return;
+  }
+  
+  size = (size + TABLE_HUGE_PAGE - 1) & ~((size_t) TABLE_HUGE_PAGE - 1);
+  if (munmap(ptr, size))
+  {
+    sprintf(logStr, "munmap() failed: %s. Function: table_free().", 
+        strerror(errno));
+    log_msg(logStr, LOG_ERR, pParam);
+  }
+}
+
+/* With '--hugetlb' option, the reserved huge pages of 2 MB are tried first,
+ which fails at once if there are not enough of them. Otherwise transparent
+ huge pages are requested for a normal mapping. */
+static void *map_table(size_t size, struct Parameters *pParam)
+{
+  void *ptr;
+  
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+  if (pParam->bHugetlbFlag)
+  {
+    ptr = mmap(0, size, PROT_READ | PROT_WRITE, 
+         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | TABLE_MAP_HUGE_2MB, 
+         -1, 0);
+    if (ptr != MAP_FAILED)
+    {
+      return ptr;
+    }
+  }
+#endif
+  
+  ptr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, 
+       -1, 0);
+  if (ptr == MAP_FAILED)
+  {
+    log_msg(MALLOC_ERR_6041, LOG_ERR, pParam);
+    exit(1);
+  }
+
+#ifdef MADV_HUGEPAGE
+  madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+  
+  return ptr;
+}
+
+/* Interleave the pages of the array over the online NUMA nodes. Nothing is
+ done on a single node, or if mbind() is not permitted. */
+static void interleave_table(void *ptr, size_t size)
+{
+#ifdef SYS_mbind
+  unsigned long mask[TABLE_MAX_NODES / (8 * sizeof(unsigned long))];
+  unsigned long first, last, node;
+  char line[MAXLOGMSGLEN];
+  char *pStr, *pEnd;
+  FILE *pFile;
+  int nodeNum;
+  
+  pFile = fopen("/sys/devices/system/node/online", "r");
+  if (!pFile)
+  {
+    return;
+  }
+  pStr = fgets(line, MAXLOGMSGLEN, pFile);
+  fclose(pFile);
+  if (!pStr)
+  {
+    return;
+  }
+  
+  memset(mask, 0, sizeof(mask));
+  nodeNum = 0;
+  
+  /* The list looks like "0-3,5". */
+  for (;;)
+  {
+    first = strtoul(pStr, &pEnd, 10);
+    if (pEnd == pStr)
+    {
+      break;
+    }
+    last = first;
+    if (*pEnd == '-')
+    {
+      pStr = pEnd + 1;
+      last = strtoul(pStr, &pEnd, 10);
+    }
+    
+    for (node = first; node <= last && node < TABLE_MAX_NODES; node++)
+    {
+      mask[node / (8 * sizeof(unsigned long))] |= 
+          1UL << (node % (8 * sizeof(unsigned long)));
+      nodeNum++;
+    }
+    
+    if (*pEnd != ',')
+    {
+      break;
+    }
+    pStr = pEnd + 1;
+  }
+  
+  if (nodeNum > 1)
+  {
+    syscall(SYS_mbind, ptr, size, MPOL_INTERLEAVE_POLICY, mask, 
+        (unsigned long) TABLE_MAX_NODES + 1, 0);
+  }
+#endif
+}
+
+/* Write to every page of one slice, so that its page faults are taken by the
+ thread which touches it. */
+static void touch_table_body(unsigned long index, int worker, void *pArg)
+{
+  struct TouchJob *pJob;
+  char *pPage, *pEnd;
+  
+  pJob = (struct TouchJob *) pArg;
+  pPage = pJob->pBase + (size_t) index * TABLE_TOUCH_SLICE;
+  pEnd = pJob->size - (size_t) index * TABLE_TOUCH_SLICE < TABLE_TOUCH_SLICE ?
+      pJob->pBase + pJob->size : pPage + TABLE_TOUCH_SLICE;
+  
+  for (; pPage < pEnd; pPage += pJob->pageSize)
+  {
+    *pPage = 0;
+  }
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * File:   table_alloc.h
+ *
+ * Content: Declarations of global functions in table_alloc.c .
+ *
+ * Created on October 19, 2026, 11:55 PM
+ */
+
+#ifndef TABLE_ALLOC_H
+#define TABLE_ALLOC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void *table_alloc(size_t size, struct Parameters *pParam);
+void table_free(void *ptr, size_t size, struct Parameters *pParam);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TABLE_ALLOC_H */
+
@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* 
+ * File:   thread_pool.c
+ * 
+ * Content: A work-stealing parallel loop, used by the in-memory phases which
+ * process items independently of each other ('--threads' option). Its
+ * threads are started on the first call and wait on a condition variable
+ * between calls, so a loop does not pay for creating them.
+ *
+ * Created on October 19, 2026, 6:40 PM
+ */
+
+#include "common_header.h"
+#include "thread_pool.h"
+
+#include <pthread.h>
+
+#include "output.h"
+
+/* The range of items a worker still owns, packed into one 64-bit word, so that
+ the owner and the thieves can update it with a single compare-and-swap.
+ The upper half is the first unprocessed item, the lower half is the end. */
+#define RANGE_PACK(begin, end) \
+    (((unsigned long long) (begin) << 32) | (unsigned long long) (end))
+#define RANGE_BEGIN(range) ((unsigned long) ((range) >> 32))
+#define RANGE_END(range) ((unsigned long) ((range) & 0xffffffffULL))
+
+/* Each worker's range sits on its own cache line, since it is written by the
+ owner for every item. */
+struct ParallelWorker {
+  unsigned long long range __attribute__ ((aligned (64)));
+  struct ThreadPool *pPool;
+  pthread_t thread;
+  int id;
+};
+
+/* The current loop, run by workers 0...workerNum - 1. */
+struct ParallelJob {
+  int workerNum;
+  parallel_body_t pBody;
+  void *pArg;
+};
+
+/* Worker 0 is the thread that calls parallel_for(), pWorkers[1...] are the
+ threads of the pool. A new job is announced by incrementing generation, and
+ busyNum counts the threads of the pool that have not finished it yet. The
+ job, generation, busyNum and bExit are protected by mutex. */
+struct ThreadPool {
+  struct ParallelWorker *pWorkers;
+  int workerNum;
+  struct ParallelJob job;
+  unsigned long generation;
+  int busyNum;
+  int bExit;
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+};
+
+static struct ThreadPool *thread_pool_start(struct Parameters *pParam);
+static void *pool_thread(void *pArg);
+static void parallel_worker(struct ParallelWorker *pWorker);
+static int take_item(struct ParallelWorker *pWorker, unsigned long *pIndex);
+static int steal_items(struct ParallelWorker *pThief, 
+        struct ParallelWorker *pVictim);
+
+/* Call pBody for every index in 0...itemNum - 1, using pParam->threadNum
+ workers. The calling thread is worker 0. Items are split evenly at the
+ beginning, and a worker that runs out of items steals half of the remaining
+ items of another worker. The order in which items are processed is not
+ defined, so pBody must not depend on it. Only the main thread may call
+ parallel_for(), and pBody must not call it. */
+void parallel_for(unsigned long itemNum, parallel_body_t pBody, void *pArg,
+        struct Parameters *pParam)
+{
+  struct ThreadPool *pPool;
+  unsigned long i, begin, end;
+  int workerNum, w;
+  
+  workerNum = pParam->threadNum;
+  if ((unsigned long) workerNum > itemNum)
+  {
+    workerNum = (int) itemNum;
+  }
+  
+  if (workerNum <= 1 || itemNum > 0xffffffffUL)
+  {
+    for (i = 0; i < itemNum; i++)
+    {
+      pBody(i, 0, pArg);
+    }
+    return;
+  }
+  
+  if (!pParam->pThreadPool)
+  {
+    pParam->pThreadPool = thread_pool_start(pParam);
+  }
+  pPool = pParam->pThreadPool;
+  
+  for (w = 0; w < workerNum; w++)
+  {
+    begin = itemNum * w / workerNum;
+    end = itemNum * (w + 1) / workerNum;
+    pPool->pWorkers[w].range = RANGE_PACK(begin, end);
+  }
+  
+  pthread_mutex_lock(&pPool->mutex);
+  pPool->job.workerNum = workerNum;
+  pPool->job.pBody = pBody;
+  pPool->job.pArg = pArg;
+  pPool->generation++;
+  pPool->busyNum = workerNum - 1;
+  pthread_cond_broadcast(&pPool->wake);
+  pthread_mutex_unlock(&pPool->mutex);
+  
+  parallel_worker(&pPool->pWorkers[0]);
+  
+  pthread_mutex_lock(&pPool->mutex);
+  while (pPool->busyNum)
+  {
+    pthread_cond_wait(&pPool->done, &pPool->mutex);
+  }
+  pthread_mutex_unlock(&pPool->mutex);
+}
+
+/* Stop the threads of the pool, if it has been started. */
+void thread_pool_free(struct Parameters *pParam)
+{
+  struct ThreadPool *pPool;
+  int w;
+  
+  pPool = pParam->pThreadPool;
+  if (!pPool)
+  {
+    return;
+  }
+  
+  pthread_mutex_lock(&pPool->mutex);
+  pPool->bExit = 1;
+  pthread_cond_broadcast(&pPool->wake);
+  pthread_mutex_unlock(&pPool->mutex);
+  
+  for (w = 1; w < pPool->workerNum; w++)
+  {
+    pthread_join(pPool->pWorkers[w].thread, 0);
+  }
+  
+  pthread_cond_destroy(&pPool->done);
+  pthread_cond_destroy(&pPool->wake);
+  pthread_mutex_destroy(&pPool->mutex);
+  free((void *) pPool->pWorkers);
+  free((void *) pPool);
+  pParam->pThreadPool = 0;
+}
+
+static struct ThreadPool *thread_pool_start(struct Parameters *pParam)
+{
+  struct ThreadPool *pPool;
+  int w;
+  
+  pPool = (struct ThreadPool *) malloc(sizeof(struct ThreadPool));
+  if (!pPool || posix_memalign((void **) &pPool->pWorkers, 64, 
+                 pParam->threadNum * sizeof(struct ParallelWorker)))
+  {
+    log_msg(MALLOC_ERR_6025, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  pPool->workerNum = pParam->threadNum;
+  pPool->generation = 0;
+  pPool->busyNum = 0;
+  pPool->bExit = 0;
+  pthread_mutex_init(&pPool->mutex, 0);
+  pthread_cond_init(&pPool->wake, 0);
+  pthread_cond_init(&pPool->done, 0);
+  
+  for (w = 0; w < pPool->workerNum; w++)
+  {
+    pPool->pWorkers[w].range = RANGE_PACK(0, 0);
+    pPool->pWorkers[w].pPool = pPool;
+    pPool->pWorkers[w].id = w;
+  }
+  
+  for (w = 1; w < pPool->workerNum; w++)
+  {
+    if (pthread_create(&pPool->pWorkers[w].thread, 0, pool_thread, 
+               &pPool->pWorkers[w]))
+    {
+      log_msg("pthread_create() failed. Function: parallel_for().", LOG_ERR,
+          pParam);
+      exit(1);
+    }
+  }
+  
+  return pPool;
+}
+
+/* A thread of the pool sleeps until a new job is announced, and takes part in
+ it if the job has enough items for it. */
+static void *pool_thread(void *pArg)
+{
+  struct ParallelWorker *pWorker;
+  struct ThreadPool *pPool;
+  unsigned long generation;
+  
+  pWorker = (struct ParallelWorker *) pArg;
+  pPool = pWorker->pPool;
+  generation = 0;
+  
+  pthread_mutex_lock(&pPool->mutex);
+  for (;;)
+  {
+    while (!pPool->bExit && pPool->generation == generation)
+    {
+      pthread_cond_wait(&pPool->wake, &pPool->mutex);
+    }
+    if (pPool->bExit)
+    {
+      break;
+    }
+    generation = pPool->generation;
+    if (pWorker->id >= pPool->job.workerNum)
+    {
+      continue;
+    }
+    pthread_mutex_unlock(&pPool->mutex);
+    
+    parallel_worker(pWorker);
+    
+    pthread_mutex_lock(&pPool->mutex);
+    if (--pPool->busyNum == 0)
+    {
+      pthread_cond_signal(&pPool->done);
+    }
+  }
+  pthread_mutex_unlock(&pPool->mutex);
+  
+  return 0;
+}
+
+static void parallel_worker(struct ParallelWorker *pWorker)
+{
+  struct ThreadPool *pPool;
+  struct ParallelJob *pJob;
+  unsigned long index;
+  int w, bStolen;
+  
+  pPool = pWorker->pPool;
+  pJob = &pPool->job;
+  
+  do
+  {
+    while (take_item(pWorker, &index))
+    {
+      pJob->pBody(index, pWorker->id, pJob->pArg);
+    }
+    
+    /* Out of items. Visit the other workers, starting from the next one, and
+     steal from the first one who still has items left. */
+    bStolen = 0;
+    for (w = 1; w < pJob->workerNum && !bStolen; w++)
+    {
+      bStolen = steal_items(pWorker, 
+                  &pPool->pWorkers[(pWorker->id + w) % pJob->workerNum]);
+    }
+  } while (bStolen);
+}
+
+/* The owner takes items from the front of its own range. */
+static int take_item(struct ParallelWorker *pWorker, unsigned long *pIndex)
+{
+  unsigned long long range;
+  unsigned long begin, end;
+  
+  range = __atomic_load_n(&pWorker->range, __ATOMIC_ACQUIRE);
+  do
+  {
+    begin = RANGE_BEGIN(range);
+    end = RANGE_END(range);
+    if (begin >= end)
+    {
+      return 0;
+    }
+  } while (!__atomic_compare_exchange_n(&pWorker->range, &range, 
+                       RANGE_PACK(begin + 1, end), 0,
+                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  
+  *pIndex = begin;
+  return 1;
+}
+
+/* A thief takes the back half of the victim's range. The thief's own range is
+ empty at this point, so nobody else can take items from it until it is
+ replaced by the stolen items. */
+static int steal_items(struct ParallelWorker *pThief, 
+        struct ParallelWorker *pVictim)
+{
+  unsigned long long range;
+  unsigned long begin, end, middle;
+  
+  range = __atomic_load_n(&pVictim->range, __ATOMIC_ACQUIRE);
+  do
+  {
+    begin = RANGE_BEGIN(range);
+    end = RANGE_END(range);
+    if (begin >= end)
+    {
+      return 0;
+    }
+    middle = begin + (end - begin) / 2;
+  } while (!__atomic_compare_exchange_n(&pVictim->range, &range, 
+                       RANGE_PACK(begin, middle), 0,
+                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  
+  __atomic_store_n(&pThief->range, RANGE_PACK(middle, end), __ATOMIC_RELEASE);
+  return 1;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2016 Zhuge Chen, Risto Vaarandi and Mauno Pihelgas
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* 
+ * File:   thread_pool.h
+ * 
+ * Content: Declarations of global functions in thread_pool.c .
+ *
+ * Created on October 19, 2026, 6:40 PM
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Body of a parallel loop. index is the item to process, worker is the number
+ of the calling worker (0...threadNum - 1), which can be used to select
+ per-thread scratch storage. */
+typedef void (*parallel_body_t)(unsigned long index, int worker, void *pArg);
+
+void parallel_for(unsigned long itemNum, parallel_body_t pBody, void *pArg,
+        struct Parameters *pParam);
+void thread_pool_free(struct Parameters *pParam);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* THREAD_POOL_H */
+
@@ -28,6 +28,14 @@
 
 #include <ctype.h>     /* for tolower() */
 
+#include "output.h"
+
+static void selection_sort_passes(struct Elem **ppArray, wordnumber_t size,
+        wordnumber_t passes);
+static int is_worse_element(struct Elem **ppArray, wordnumber_t x,
+        wordnumber_t y);
+static int compare_positions(const void *pA, const void *pB);
+
 
 
 /* String lower case convertion, by by J.F. Sebastian. */
@@ -84,10 +92,110 @@ tableindex_t str2hash(char *string, tableindex_t modulo, tableindex_t h)
 void sort_elements(struct Elem **ppArray, wordnumber_t size,
            struct Parameters *pParam)
 {
-  int i, j, imax;
+  if (size > 1)
+  {
+    selection_sort_passes(ppArray, size, size - 1);
+  }
+}
+
+/* Puts into ppArray[0...topNum - 1] the same elements, in the same order, as
+ sort_elements() would, and returns their number ('--top' option).
+ 
+ The first topNum passes of the selection sort only rearrange
+ ppArray[0...topNum - 1] and the elements they select from the rest of the
+ array. Every pass takes the best remaining element (higher support, then
+ lower position), so only the topNum best elements of the rest can ever be
+ selected. They are found with a bounded heap, and the selection sort runs on
+ at most 2 * topNum elements, kept in their original order. This costs
+ O(n log K + K^2) instead of O(n^2). */
+wordnumber_t sort_top_elements(struct Elem **ppArray, wordnumber_t size,
+        wordnumber_t topNum, struct Parameters *pParam)
+{
+  wordnumber_t *pHeap;
+  wordnumber_t heapNum, i, j, child;
+  struct Elem **ppCandidates;
+  
+  if (topNum >= size)
+  {
+    sort_elements(ppArray, size, pParam);
+    return size;
+  }
+  
+  pHeap = (wordnumber_t *) malloc(topNum * sizeof(wordnumber_t));
+  ppCandidates = (struct Elem **) malloc(2 * topNum * sizeof(struct Elem *));
+  if (!pHeap || !ppCandidates)
+  {
+    log_msg(MALLOC_ERR_6032, LOG_ERR, pParam);
+    exit(1);
+  }
+  
+  /* Min-heap of positions, its root is the worst of the best elements found
+   so far. */
+  heapNum = 0;
+  
+  for (i = topNum; i < size; i++)
+  {
+    if (heapNum < topNum)
+    {
+      for (j = heapNum++; j && is_worse_element(ppArray, i, pHeap[(j - 1) / 2]);
+          j = (j - 1) / 2)
+      {
+        pHeap[j] = pHeap[(j - 1) / 2];
+      }
+      pHeap[j] = i;
+    }
+    else if (is_worse_element(ppArray, pHeap[0], i))
+    {
+      for (j = 0; (child = 2 * j + 1) < heapNum; j = child)
+      {
+        if (child + 1 < heapNum &&
+            is_worse_element(ppArray, pHeap[child + 1], pHeap[child]))
+        {
+          child++;
+        }
+        if (!is_worse_element(ppArray, pHeap[child], i))
+        {
+          break;
+        }
+        pHeap[j] = pHeap[child];
+      }
+      pHeap[j] = i;
+    }
+  }
+  
+  qsort(pHeap, heapNum, sizeof(wordnumber_t), compare_positions);
+  
+  for (i = 0; i < topNum; i++)
+  {
+    ppCandidates[i] = ppArray[i];
+  }
+  for (i = 0; i < heapNum; i++)
+  {
+    ppCandidates[topNum + i] = ppArray[pHeap[i]];
+  }
+  
+  selection_sort_passes(ppCandidates, topNum + heapNum, topNum);
+  
+  for (i = 0; i < topNum; i++)
+  {
+    ppArray[i] = ppCandidates[i];
+  }
+  
+  free((void *) pHeap);
+  free((void *) ppCandidates);
+  
+  return topNum;
+}
+
+/* The first passes steps of a selection sort by support value. Of the
+ elements with the same support, the one at the lowest position is taken. */
+static void selection_sort_passes(struct Elem **ppArray, wordnumber_t size,
+        wordnumber_t passes)
+{
+  wordnumber_t i, j, imax;
   struct Elem *tmp;
   
-  for (j = 0; j < size - 1; j++)
+  for (j = 0; j < passes && j < size - 1; j++)
   {
     imax = j;
     
@@ -104,6 +212,25 @@ void sort_elements(struct Elem **ppArray, wordnumber_t size,
   }
 }
 
+/* Whether the element at position x comes after the one at position y, in
+ the order of selection. */
+static int is_worse_element(struct Elem **ppArray, wordnumber_t x,
+        wordnumber_t y)
+{
+  return ppArray[x]->count < ppArray[y]->count ||
+      (ppArray[x]->count == ppArray[y]->count && x > y);
+}
+
+static int compare_positions(const void *pA, const void *pB)
+{
+  wordnumber_t a, b;
+  
+  a = *(const wordnumber_t *) pA;
+  b = *(const wordnumber_t *) pB;
+  
+  return (a > b) - (a < b);
+}
+
 /* Ates Goral's solution for generating random string. Used for token
  generation. */
 /* http://stackoverflow.com/questions/440133/how-do-i-create-a-random-alpha-numeric-string-in-c */
@@ -39,6 +39,8 @@ size_t str_format_int_grouped(char dst[MAXDIGITBIT], unsigned long num);
 tableindex_t str2hash(char *string, tableindex_t modulo, tableindex_t h);
 void sort_elements(struct Elem **ppArray, wordnumber_t size,
            struct Parameters *pParam);
+wordnumber_t sort_top_elements(struct Elem **ppArray, wordnumber_t size,
+        wordnumber_t topNum, struct Parameters *pParam);
 void gen_random_string(char *s, const int len);
 
 #ifdef __cplusplus
@@ -27,11 +27,14 @@
 #include "common_header.h"
 #include "word_filter_search_replace.h"
 
-#include <regex.h>     /* for regcomp() and regexec() */
 #include <string.h>
 
+#include "regex_backend.h"
+#include "output.h"
+#include "utility.h"
+
 static int check_endless_loop(long long start, long long end, 
-        struct Parameters *pParm);
+        struct LineParser *pParser, struct Parameters *pParm);
 static void replace_string_for_word_search(long long start, long long end,
                   char *pOriginStr, char *pStr);
 
@@ -40,10 +43,11 @@ static void replace_string_for_word_search(long long start, long long end,
  the regex in '--wsearch' option. Otherwise, if it only satisfies '--wfilter',
  it will be counted twice when build the vocabulary. Then it will cause other
  sequentially problems. */
-int is_word_filtered(char *pStr, struct Parameters *pParam)
+int is_word_filtered(char *pStr, struct LineParser *pParser,
+        struct Parameters *pParam)
 {
-  if (!regexec(&pParam->wfilter_regex, pStr, 0, 0, 0) &&
-    !regexec(&pParam->wsearch_regex, pStr, 0, 0, 0))
+  if (!regex_exec(&pParam->wfilter_regex, pStr, 0, 0, pParser) &&
+    !regex_exec(&pParam->wsearch_regex, pStr, 0, 0, pParser))
   {
     return 1;
   }
@@ -53,25 +57,27 @@ int is_word_filtered(char *pStr, struct Parameters *pParam)
   }
 }
 
-char *word_search_replace(char *pOriginStr, struct Parameters *pParam)
+char *word_search_replace(char *pOriginStr, struct LineParser *pParser,
+        struct Parameters *pParam)
 {
   regmatch_t match[MAXPARANEXPR];
   int cnt;
   
-  strcpy(pParam->tmpStr, pOriginStr);
+  strcpy(pParser->tmpStr, pOriginStr);
   cnt = 0;
   
   while (1)
   {
-    if (!regexec(&pParam->wsearch_regex, pParam->tmpStr, 1, match, 0))
+    if (!regex_exec(&pParam->wsearch_regex, pParser->tmpStr, 1, match,
+                    pParser))
     {
       if (cnt && !check_endless_loop(match[0].rm_so, match[0].rm_eo,
-                       pParam))
+                       pParser, pParam))
       {
         break;
       }
       replace_string_for_word_search(match[0].rm_so, match[0].rm_eo,
-                       pParam->tmpStr, pParam->pWordReplace);
+                       pParser->tmpStr, pParam->pWordReplace);
       cnt++;
     }
     else
@@ -80,7 +86,79 @@ char *word_search_replace(char *pOriginStr, struct Parameters *pParam)
     }
   }
   
-  return pParam->tmpStr;
+  return pParser->tmpStr;
+}
+
+/* Combination of is_word_filtered() and word_search_replace(), memoized.
+ Return the rewritten word if the word is filtered, otherwise return null(0).
+ The returned string belongs to the cache and stays valid only until the next
+ call of this function.
+ 
+ The same words recur in every line and in every pass over the data set, thus
+ the results are remembered in a direct-mapped cache of DEF_WFILTER_CACHE_SIZE
+ slots. On a cache miss the regular expressions are evaluated, and the result
+ replaces whatever word was stored in the slot before. */
+char *word_filter_search_replace(char *pStr, struct LineParser *pParser,
+        struct Parameters *pParam)
+{
+  struct WordFilterCacheSlot *pSlot;
+  char *pRewritten;
+  tableindex_t i;
+  int len, lenRewritten;
+  
+  if (!pParser->pWordFilterCache)
+  {
+    pParser->pWordFilterCache = (struct WordFilterCacheSlot *) 
+        malloc(sizeof(struct WordFilterCacheSlot) * DEF_WFILTER_CACHE_SIZE);
+    if (!pParser->pWordFilterCache)
+    {
+      log_msg(MALLOC_ERR_6022, LOG_ERR, pParam);
+      exit(1);
+    }
+    for (i = 0; i < DEF_WFILTER_CACHE_SIZE; i++)
+    {
+      pParser->pWordFilterCache[i].pKey = 0;
+      pParser->pWordFilterCache[i].pRewritten = 0;
+    }
+  }
+  
+  pSlot = &pParser->pWordFilterCache[str2hash(pStr, DEF_WFILTER_CACHE_SIZE,
+                         pParam->wordFilterCacheSeed)];
+  
+  if (pSlot->pKey && !strcmp(pSlot->pKey, pStr))
+  {
+    return pSlot->pRewritten;
+  }
+  
+  pRewritten = 0;
+  lenRewritten = 0;
+  if (is_word_filtered(pStr, pParser, pParam))
+  {
+    pRewritten = word_search_replace(pStr, pParser, pParam);
+    lenRewritten = (int) strlen(pRewritten);
+  }
+  
+  len = (int) strlen(pStr);
+  free((void *) pSlot->pKey);
+  pSlot->pKey = (char *) malloc(len + lenRewritten + 2);
+  if (!pSlot->pKey)
+  {
+    log_msg(MALLOC_ERR_6022, LOG_ERR, pParam);
+    exit(1);
+  }
+  strcpy(pSlot->pKey, pStr);
+  
+  if (pRewritten)
+  {
+    pSlot->pRewritten = pSlot->pKey + len + 1;
+    strcpy(pSlot->pRewritten, pRewritten);
+  }
+  else
+  {
+    pSlot->pRewritten = 0;
+  }
+  
+  return pSlot->pRewritten;
 }
 
 /* Avoid endless loop. There will be endless loop if this function is not
@@ -90,7 +168,7 @@ char *word_search_replace(char *pOriginStr, struct Parameters *pParam)
  is still true, thus it causes endless loop, keeping replacing '=VALUE' with
  '=VALUE'. */
 static int check_endless_loop(long long start, long long end, 
-        struct Parameters *pParm)
+        struct LineParser *pParser, struct Parameters *pParm)
 {
   long long i;
   int j;
@@ -98,7 +176,7 @@ static int check_endless_loop(long long start, long long end,
   j = 0;
   for (i = start; i < end; i++)
   {
-    if (pParm->tmpStr[i] != pParm->pWordReplace[j])
+    if (pParser->tmpStr[i] != pParm->pWordReplace[j])
     {
       return 1;
     }
@@ -30,8 +30,12 @@
 extern "C" {
 #endif
 
-int is_word_filtered(char *pStr, struct Parameters *pParam);
-char *word_search_replace(char *pOriginStr, struct Parameters *pParam);
+int is_word_filtered(char *pStr, struct LineParser *pParser,
+        struct Parameters *pParam);
+char *word_search_replace(char *pOriginStr, struct LineParser *pParser,
+        struct Parameters *pParam);
+char *word_filter_search_replace(char *pStr, struct LineParser *pParser,
+        struct Parameters *pParam);
 
 #ifdef __cplusplus
 }